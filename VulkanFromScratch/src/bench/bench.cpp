@@ -0,0 +1,116 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// One of `cpu` / `gpu` is set.
+struct Benchmark {
+    const char* name;
+    const char* description;
+    void (*cpu)();
+    void (*gpu)(BenchScene&);
+};
+static const Benchmark BENCHMARKS[] = {
+    { "recording", "10k objects, per object uniform buffers + sets vs uniform ring slices", nullptr, bench_recording },
+    { "import", "OBJ / glTF import throughput on a 1024x1024 grid", bench_import, nullptr },
+    { "startup", "~1 GB OBJ scene startup, text parsing vs mesh cache", bench_startup, nullptr },
+    { "instancing", "10k draws vs one instanced draw of 10k copies", nullptr, bench_instancing },
+    { "culling", "CPU frustum culling of 100k / 1M spheres, scalar vs SIMD kernels", bench_culling, nullptr },
+};
+
+bool run_cpu_benchmark(const std::string& name)
+{
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        if (benchmark.cpu == nullptr || name != benchmark.name) continue;
+        benchmark.cpu();
+        return true;
+    }
+    return false;
+}
+
+bool run_gpu_benchmark(const std::string& name, BenchScene& scene)
+{
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        if (benchmark.gpu == nullptr || name != benchmark.name) continue;
+        benchmark.gpu(scene);
+        // Nothing recorded by the benchmark may still be in flight when its objects go.
+        vkDeviceWaitIdle(scene.core.get_device());
+        return true;
+    }
+    return false;
+}
+
+void print_benchmarks()
+{
+    printf("[Bench] available benchmarks : \n");
+    for (const Benchmark& benchmark : BENCHMARKS) {
+        printf("[Bench]   %-12s %s (%s) \n", benchmark.name, benchmark.description, benchmark.cpu ? "CPU" : "GPU");
+    }
+}
+
+double bench_milliseconds_since(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+BenchTiming run_bench_frames(BenchScene& scene, uint32_t frames, const std::function<void(FrameUpdateData&)>& record,
+    const std::function<void(FrameUpdateData&)>& before_pass)
+{
+    BenchTiming timing;
+    for (uint32_t i = 0; i < BENCH_WARMUP_FRAMES + frames && scene.window.is_window_alive(); i++) {
+        auto frame_start = std::chrono::high_resolution_clock::now();
+        glfwPollEvents();
+        scene.renderer.reset_renderpass();
+        scene.renderer.begin_commandBuffer();
+
+        FrameUpdateData update_data{
+            scene.swapchain.current_frame(),
+            scene.renderer.get_current_cmdbuffer(),
+            scene.pipeline.get_layout()
+        };
+        scene.objects.execute_before_frame(update_data);
+        if (before_pass) before_pass(update_data);
+        scene.renderer.begin_renderPass();
+        scene.objects.execute(update_data);
+
+        auto record_start = std::chrono::high_resolution_clock::now();
+        record(update_data);
+        double record_ms = bench_milliseconds_since(record_start);
+
+        scene.renderer.end_render();
+        scene.renderer.draw_frame();
+        if (i < BENCH_WARMUP_FRAMES) continue;
+        timing.record_ms += record_ms;
+        timing.frame_ms += bench_milliseconds_since(frame_start);
+    }
+    timing.record_ms /= frames;
+    timing.frame_ms /= frames;
+    return timing;
+}
+
+void write_grid_obj(const std::string& path, uint32_t grid)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open benchmark obj file!");
+    }
+    const float step = 1.0f / (grid - 1);
+    for (uint32_t y = 0; y < grid; y++) {
+        for (uint32_t x = 0; x < grid; x++) {
+            fprintf(file, "v %.6f %.6f %.6f\n", x * step, y * step, 0.0f);
+        }
+    }
+    for (uint32_t y = 0; y < grid; y++) {
+        for (uint32_t x = 0; x < grid; x++) {
+            fprintf(file, "vt %.6f %.6f\n", x * step, y * step);
+        }
+    }
+    // OBJ indices are 1 based, the texture coordinates share the position's index.
+    for (uint32_t y = 0; y + 1 < grid; y++) {
+        for (uint32_t x = 0; x + 1 < grid; x++) {
+            uint32_t a = y * grid + x + 1, b = a + 1, c = a + grid, d = c + 1;
+            fprintf(file, "f %u/%u %u/%u %u/%u\nf %u/%u %u/%u %u/%u\n", a, a, b, b, d, d, d, d, c, c, a, a);
+        }
+    }
+    fclose(file);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "core/core_fwd.h"
+#include <string>
+#include <functional>
+#include <chrono>
+
+// What main() sets up for a GPU benchmark : the usual renderer, and a GameObject holding
+// the TransformObject and the Renderer (set 0 / set 1 bound, no model drawn).
+struct BenchScene {
+	DisplayWindow&		window;
+	CoreInstance&		core;
+	SwapChain&			swapchain;
+	GraphicsPipeline&	pipeline;
+	Renderer&			renderer;
+	GameObject&			objects;
+	Model&				model;
+};
+
+// Averages of BenchScene frames, after BENCH_WARMUP_FRAMES not counted.
+struct BenchTiming {
+	double		record_ms = 0.0;	// CPU time of the benchmark's own recording
+	double		frame_ms = 0.0;		// whole frame, fence wait and present included
+};
+
+//----------------------------
+// `--bench <name>`
+//----------------------------
+// Each benchmark prints its results with a [Bench] tag and returns, main() exits afterwards.
+// CPU benchmarks run before anything Vulkan is created. False when `name` is none of them.
+bool			run_cpu_benchmark(const std::string& name);
+bool			run_gpu_benchmark(const std::string& name, BenchScene& scene);
+void			print_benchmarks();
+
+//----------------------------
+// Helper
+//----------------------------
+static const uint32_t BENCH_WARMUP_FRAMES = 30;
+// Runs `frames` frames of `scene`, `record` is called inside the render pass once the
+// objects have bound their sets. `before_pass` (may be empty) runs outside of it, first.
+BenchTiming		run_bench_frames(BenchScene& scene, uint32_t frames, const std::function<void(FrameUpdateData&)>& record,
+					const std::function<void(FrameUpdateData&)>& before_pass = {});
+double			bench_milliseconds_since(std::chrono::high_resolution_clock::time_point start);
+// Flat grid of `grid` x `grid` vertices with texture coordinates, two triangles per cell (~137 MB at 1024).
+void			write_grid_obj(const std::string& path, uint32_t grid);
+
+//----------------------------
+// Benchmarks
+//----------------------------
+// user-002 : 10k objects recorded with a buffer and set each vs one UniformRing slice each.
+void			bench_recording(BenchScene& scene);
+// user-011 : OBJ / glTF import throughput (MB/s, vertices/s) on a large synthetic grid.
+void			bench_import();
+// user-012 : startup of a ~1 GB OBJ scene, text parsing vs mapped mesh caches.
+void			bench_startup();
+// user-018 : 10k copies of the model as 10k draws vs one instanced draw.
+void			bench_instancing(BenchScene& scene);
+// user-021 : SimdCuller scalar vs SSE vs AVX2 kernels on 100k and 1M spheres.
+void			bench_culling();
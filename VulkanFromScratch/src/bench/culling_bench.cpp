@@ -0,0 +1,49 @@
+#include "bench.hpp"
+#include "core/simd_culler.hpp"
+#include <cstdio>
+#include <random>
+#include <gtc/matrix_transform.hpp>
+
+static const uint32_t CULLING_COUNTS[] = { 100000, 1000000 };
+static const uint32_t CULLING_REPEATS = 50;
+
+// SimdCuller kernels over spheres scattered in a cube twice the size of the frustum's
+// depth range, so roughly one in ten is visible. Each kernel culls the same set
+// CULLING_REPEATS times, the best run is kept.
+void bench_culling()
+{
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    proj[1][1] *= -1;
+    const glm::mat4 view_projection = proj * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (uint32_t count : CULLING_COUNTS) {
+        SimdCuller culler;
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+        for (uint32_t i = 0; i < count; i++) {
+            culler.add(glm::vec4(position(random), position(random), position(random), radius(random)));
+        }
+
+        double scalar_us = 0.0;
+        const SimdCuller::Kernel kernels[] = { SimdCuller::Kernel::SCALAR, SimdCuller::Kernel::SSE, SimdCuller::Kernel::AVX2 };
+        for (SimdCuller::Kernel kernel : kernels) {
+            if (!SimdCuller::is_supported(kernel)) {
+                printf("[Bench] culling %u : %s not supported \n", count, SimdCuller::kernel_name(kernel));
+                continue;
+            }
+            culler.set_kernel(kernel);
+            double best_us = 0.0;
+            uint32_t visible = 0;
+            for (uint32_t repeat = 0; repeat < CULLING_REPEATS; repeat++) {
+                visible = culler.cull(view_projection);
+                double us = culler.last_stats().microseconds;
+                if (repeat == 0 || us < best_us) best_us = us;
+            }
+            if (kernel == SimdCuller::Kernel::SCALAR) scalar_us = best_us;
+            printf("[Bench] culling %u : %-6s %8.1f us, %6.2f ns per sphere, %u visible, %.1fx the scalar kernel \n",
+                count, SimdCuller::kernel_name(kernel), best_us, best_us * 1000.0 / count, visible,
+                best_us > 0.0 ? scalar_us / best_us : 0.0);
+        }
+    }
+}
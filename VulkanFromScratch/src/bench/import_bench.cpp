@@ -0,0 +1,104 @@
+#include "bench.hpp"
+#include "helper/mesh_importer.hpp"
+#include <cstdio>
+#include <vector>
+#include <stdexcept>
+
+// Synthetic grid of IMPORT_GRID x IMPORT_GRID vertices, two triangles per cell.
+static const uint32_t IMPORT_GRID = 1024;
+static const char* IMPORT_OBJ_PATH = "./bench_import.obj";
+static const char* IMPORT_GLTF_PATH = "./bench_import.gltf";
+static const char* IMPORT_BIN_PATH = "./bench_import.bin";
+static const char* IMPORT_BIN_URI = "bench_import.bin";
+
+static void write_grid_gltf()
+{
+    // [ positions (float3) | texture coordinates (float2) | indices (uint32) ]
+    const uint32_t vertex_count = IMPORT_GRID * IMPORT_GRID;
+    const uint32_t index_count = (IMPORT_GRID - 1) * (IMPORT_GRID - 1) * 6;
+    std::vector<float> positions, texcoords;
+    std::vector<uint32_t> indices;
+    positions.reserve(vertex_count * 3);
+    texcoords.reserve(vertex_count * 2);
+    indices.reserve(index_count);
+    const float step = 1.0f / (IMPORT_GRID - 1);
+    for (uint32_t y = 0; y < IMPORT_GRID; y++) {
+        for (uint32_t x = 0; x < IMPORT_GRID; x++) {
+            positions.insert(positions.end(), { x * step, y * step, 0.0f });
+            texcoords.insert(texcoords.end(), { x * step, y * step });
+        }
+    }
+    for (uint32_t y = 0; y + 1 < IMPORT_GRID; y++) {
+        for (uint32_t x = 0; x + 1 < IMPORT_GRID; x++) {
+            uint32_t a = y * IMPORT_GRID + x, b = a + 1, c = a + IMPORT_GRID, d = c + 1;
+            indices.insert(indices.end(), { a, b, d, d, c, a });
+        }
+    }
+    const size_t position_bytes = positions.size() * sizeof(float);
+    const size_t texcoord_bytes = texcoords.size() * sizeof(float);
+    const size_t index_bytes = indices.size() * sizeof(uint32_t);
+
+    FILE* bin = fopen(IMPORT_BIN_PATH, "wb");
+    if (bin == nullptr) {
+        throw std::runtime_error("failed to open benchmark gltf buffer!");
+    }
+    fwrite(positions.data(), 1, position_bytes, bin);
+    fwrite(texcoords.data(), 1, texcoord_bytes, bin);
+    fwrite(indices.data(), 1, index_bytes, bin);
+    fclose(bin);
+
+    FILE* file = fopen(IMPORT_GLTF_PATH, "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("failed to open benchmark gltf file!");
+    }
+    fprintf(file,
+        "{\n"
+        "  \"asset\": { \"version\": \"2.0\" },\n"
+        "  \"scene\": 0,\n"
+        "  \"scenes\": [ { \"nodes\": [ 0 ] } ],\n"
+        "  \"nodes\": [ { \"mesh\": 0 } ],\n"
+        "  \"meshes\": [ { \"primitives\": [ { \"attributes\": { \"POSITION\": 0, \"TEXCOORD_0\": 1 }, \"indices\": 2 } ] } ],\n"
+        "  \"buffers\": [ { \"uri\": \"%s\", \"byteLength\": %zu } ],\n"
+        "  \"bufferViews\": [\n"
+        "    { \"buffer\": 0, \"byteOffset\": 0, \"byteLength\": %zu },\n"
+        "    { \"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu },\n"
+        "    { \"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu }\n"
+        "  ],\n"
+        "  \"accessors\": [\n"
+        "    { \"bufferView\": 0, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC3\", \"min\": [ 0, 0, 0 ], \"max\": [ 1, 1, 0 ] },\n"
+        "    { \"bufferView\": 1, \"componentType\": 5126, \"count\": %u, \"type\": \"VEC2\" },\n"
+        "    { \"bufferView\": 2, \"componentType\": 5125, \"count\": %u, \"type\": \"SCALAR\" }\n"
+        "  ]\n"
+        "}\n",
+        IMPORT_BIN_URI, position_bytes + texcoord_bytes + index_bytes,
+        position_bytes, position_bytes, texcoord_bytes, position_bytes + texcoord_bytes, index_bytes,
+        vertex_count, vertex_count, index_count);
+    fclose(file);
+}
+
+static void print_import(const char* format, const MeshData& mesh, const MeshImportStats& stats)
+{
+    printf("[Bench] import %s : %.1f MB, %llu source vertices -> %zu, %llu triangles in %.1f ms : %.1f MB/s, %.2f M vertices/s \n",
+        format, stats.file_bytes / (1024.0 * 1024.0), static_cast<unsigned long long>(stats.source_vertices), mesh.vertices.size(),
+        static_cast<unsigned long long>(stats.triangles), stats.seconds * 1000.0, stats.mb_per_second(), stats.vertices_per_second() / 1e6);
+}
+
+// Import throughput of the streaming parsers on a large synthetic mesh, the same grid
+// written as OBJ text and as glTF with an external buffer. The files are removed afterwards.
+void bench_import()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    write_grid_obj(IMPORT_OBJ_PATH, IMPORT_GRID);
+    write_grid_gltf();
+    printf("[Bench] import : %ux%u grid written in %.1f ms \n", IMPORT_GRID, IMPORT_GRID, bench_milliseconds_since(start));
+
+    MeshImportStats stats;
+    MeshData mesh = MeshImporter::load_obj(IMPORT_OBJ_PATH, &stats);
+    print_import("obj", mesh, stats);
+    mesh = MeshImporter::load_gltf(IMPORT_GLTF_PATH, &stats);
+    print_import("gltf", mesh, stats);
+
+    remove(IMPORT_OBJ_PATH);
+    remove(IMPORT_GLTF_PATH);
+    remove(IMPORT_BIN_PATH);
+}
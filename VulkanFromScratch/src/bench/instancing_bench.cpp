@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <vector>
+#include <gtc/matrix_transform.hpp>
+
+static const uint32_t INSTANCING_OBJECTS = 10000;
+static const uint32_t INSTANCING_FRAMES = 300;
+
+// The same 10k copies of the model, drawn with one vkCmdDrawIndexed each (their transform
+// still comes from the instance stream) and then by one InstancedModel.
+void bench_instancing(BenchScene& scene)
+{
+    const uint32_t side = 100;
+    std::vector<glm::mat4> transforms(INSTANCING_OBJECTS);
+    for (uint32_t i = 0; i < INSTANCING_OBJECTS; i++) {
+        glm::vec3 position((i % side) / float(side) * 2.0f - 1.0f, (i / side) / float(side) * 2.0f - 1.0f, 0.0f);
+        transforms[i] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.0f / side));
+    }
+
+    InstanceRing& ring = scene.core.instance_ring();
+    BenchTiming draws = run_bench_frames(scene, INSTANCING_FRAMES, [&](FrameUpdateData& frame) {
+        scene.model.bind(frame.m_cmdbuffer, frame.m_pipeline_layout);
+        for (uint32_t i = 0; i < INSTANCING_OBJECTS; i++) {
+            auto slice = ring.allocate(1);
+            *slice.data = InstanceData::from_matrix(transforms[i]);
+            scene.model.draw_instanced(frame.m_cmdbuffer, slice.first_instance, 1);
+        }
+    });
+
+    InstancedModel instanced{ scene.core, scene.model };
+    for (const glm::mat4& transform : transforms) instanced.add_instance(transform);
+    BenchTiming instancing = run_bench_frames(scene, INSTANCING_FRAMES, [&](FrameUpdateData& frame) {
+        instanced.update(frame);
+    });
+
+    printf("[Bench] instancing : %u draws %.3f ms recorded, %.3f ms per frame \n",
+        INSTANCING_OBJECTS, draws.record_ms, draws.frame_ms);
+    printf("[Bench] instancing : 1 draw of %u instances %.3f ms recorded, %.3f ms per frame (%.1fx less recording), avg of %u frames \n",
+        INSTANCING_OBJECTS, instancing.record_ms, instancing.frame_ms,
+        instancing.record_ms > 0.0 ? draws.record_ms / instancing.record_ms : 0.0, INSTANCING_FRAMES);
+}
@@ -0,0 +1,133 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <gtc/matrix_transform.hpp>
+
+static const uint32_t RECORDING_OBJECTS = 10000;
+static const uint32_t RECORDING_FRAMES = 300;
+
+// What every object owned before the UniformRing : one uniform buffer (persistently mapped)
+// and one descriptor set per frame in flight. The sets use the ring's layout, the pipeline
+// layout expects a dynamic uniform buffer at set 0, and are bound at dynamic offset 0.
+struct PerObjectUniforms {
+    std::vector<VkBuffer>			buffers;		// [object * MAX_FRAMES_IN_FLIGHT + frame]
+    std::vector<MemoryAllocation>	allocations;
+    std::vector<VkDescriptorSet>	sets;
+    VkDescriptorPool				pool = VK_NULL_HANDLE;
+};
+
+static void create_per_object_uniforms(CoreInstance& core, PerObjectUniforms& objects)
+{
+    const uint32_t count = RECORDING_OBJECTS * SwapChain::MAX_FRAMES_IN_FLIGHT;
+    objects.buffers.resize(count);
+    objects.allocations.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        createBuffer(core, sizeof(TransformObject::UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            MemoryUsage::DYNAMIC, objects.buffers[i], objects.allocations[i]);
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = count;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = count;
+    if (vkCreateDescriptorPool(core.get_device(), &poolInfo, core.allocation_callbacks(), &objects.pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+    std::vector<VkDescriptorSetLayout> layouts(count, core.uniform_ring().get_descriptorset_layout());
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = objects.pool;
+    allocInfo.descriptorSetCount = count;
+    allocInfo.pSetLayouts = layouts.data();
+    objects.sets.resize(count);
+    if (vkAllocateDescriptorSets(core.get_device(), &allocInfo, objects.sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = objects.buffers[i];
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(TransformObject::UniformBufferObject);
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = objects.sets[i];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrite.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(core.get_device(), 1, &descriptorWrite, 0, nullptr);
+    }
+}
+
+static void destroy_per_object_uniforms(CoreInstance& core, PerObjectUniforms& objects)
+{
+    // Sets are freed with the pool.
+    vkDestroyDescriptorPool(core.get_device(), objects.pool, core.allocation_callbacks());
+    for (size_t i = 0; i < objects.buffers.size(); i++) destroyBuffer(core, objects.buffers[i], objects.allocations[i]);
+    objects = PerObjectUniforms();
+}
+
+// The cost of recording 10k objects before and after the UniformRing.
+// Before : every object writes its own mapped buffer and binds its own set.
+// After : every object writes its slice of the frame's ring and binds the shared dynamic
+// set at that offset, no buffer, memory or descriptor set per object.
+// The draws share the pipeline and the geometry buffers in both cases.
+void bench_recording(BenchScene& scene)
+{
+    const uint32_t side = 100;
+    std::vector<TransformObject::UniformBufferObject> uniforms(RECORDING_OBJECTS);
+    for (uint32_t i = 0; i < RECORDING_OBJECTS; i++) {
+        TransformObject::UniformBufferObject& ubo = uniforms[i];
+        glm::vec3 position((i % side) / float(side) * 2.0f - 1.0f, (i / side) / float(side) * 2.0f - 1.0f, 0.0f);
+        ubo.model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(1.0f / side));
+        ubo.view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        ubo.proj = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f);
+        ubo.proj[1][1] *= -1;
+    }
+
+    PerObjectUniforms objects;
+    create_per_object_uniforms(scene.core, objects);
+    BenchTiming before = run_bench_frames(scene, RECORDING_FRAMES, [&](FrameUpdateData& frame) {
+        const uint32_t dynamic_offset = 0;
+        for (uint32_t i = 0; i < RECORDING_OBJECTS; i++) {
+            uint32_t slot = i * SwapChain::MAX_FRAMES_IN_FLIGHT + frame.m_image_idx;
+            memcpy(objects.allocations[slot].mapped, &uniforms[i], sizeof(TransformObject::UniformBufferObject));
+            vkCmdBindDescriptorSets(frame.m_cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frame.m_pipeline_layout,
+                TRANSFORM_UNIFORM_SET, 1, &objects.sets[slot], 1, &dynamic_offset);
+            scene.model.bind(frame.m_cmdbuffer, frame.m_pipeline_layout);
+            scene.model.draw(frame.m_cmdbuffer);
+        }
+    });
+    vkDeviceWaitIdle(scene.core.get_device());
+    destroy_per_object_uniforms(scene.core, objects);
+
+    UniformRing& ring = scene.core.uniform_ring();
+    VkDeviceSize peak_bytes = 0;
+    BenchTiming after = run_bench_frames(scene, RECORDING_FRAMES, [&](FrameUpdateData& frame) {
+        VkDescriptorSet set = ring.get_descriptor_set(sizeof(TransformObject::UniformBufferObject));
+        for (uint32_t i = 0; i < RECORDING_OBJECTS; i++) {
+            auto slice = ring.allocate(sizeof(TransformObject::UniformBufferObject));
+            memcpy(slice.data, &uniforms[i], sizeof(TransformObject::UniformBufferObject));
+            vkCmdBindDescriptorSets(frame.m_cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, frame.m_pipeline_layout,
+                TRANSFORM_UNIFORM_SET, 1, &set, 1, &slice.offset);
+            scene.model.bind(frame.m_cmdbuffer, frame.m_pipeline_layout);
+            scene.model.draw(frame.m_cmdbuffer);
+        }
+        peak_bytes = std::max(peak_bytes, ring.bytes_used());
+    });
+
+    printf("[Bench] recording : %u objects, avg of %u frames \n", RECORDING_OBJECTS, RECORDING_FRAMES);
+    printf("[Bench] recording : per object buffers + sets %.3f ms recorded (%.1f ns per object), %.3f ms per frame \n",
+        before.record_ms, before.record_ms * 1e6 / RECORDING_OBJECTS, before.frame_ms);
+    printf("[Bench] recording : uniform ring %.3f ms recorded (%.1f ns per object), %.3f ms per frame, %.2fx faster recording \n",
+        after.record_ms, after.record_ms * 1e6 / RECORDING_OBJECTS, after.frame_ms,
+        after.record_ms > 0.0 ? before.record_ms / after.record_ms : 0.0);
+    printf("[Bench] recording : %.2f MB of the uniform ring per frame \n", peak_bytes / (1024.0 * 1024.0));
+}
@@ -0,0 +1,73 @@
+#include "bench.hpp"
+#include "helper/mesh_importer.hpp"
+#include "helper/mesh_cache.hpp"
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <cstring>
+
+// STARTUP_FILES grids of STARTUP_GRID x STARTUP_GRID vertices, ~1.1 GB of OBJ text.
+static const uint32_t STARTUP_FILES = 8;
+static const uint32_t STARTUP_GRID = 1024;
+
+// Startup cost of a large scene with and without the mesh cache:
+// - text : every OBJ parsed and welded (MeshImporter), the least a start without cache does
+// - first run : MeshCache::load on a missing cache, import + optimization + meshlets + LODs + write
+// - cache : MeshCache::load on an up to date cache, mapped and read once
+// The cache files were just written, they come from the OS file cache : the cold disk read is not measured.
+void bench_startup()
+{
+    std::vector<std::string> paths;
+    uint64_t text_bytes = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < STARTUP_FILES; i++) {
+        paths.push_back("./bench_startup_" + std::to_string(i) + ".obj");
+        write_grid_obj(paths.back(), STARTUP_GRID);
+        remove(MeshCache::cache_path(paths.back(), VertexFormat::FULL).c_str());
+    }
+    printf("[Bench] startup : %u obj files written in %.1f ms \n", STARTUP_FILES, bench_milliseconds_since(start));
+
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string& path : paths) {
+        MeshImportStats stats;
+        MeshImporter::load(path, &stats);
+        text_bytes += stats.file_bytes;
+    }
+    double text_ms = bench_milliseconds_since(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string& path : paths) {
+        MappedMesh mesh;
+        MeshCache::load(path, mesh);
+    }
+    double first_run_ms = bench_milliseconds_since(start);
+
+    uint64_t cache_bytes = 0;
+    uint64_t checksum = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (const std::string& path : paths) {
+        MappedMesh mesh;
+        if (MeshCache::load(path, mesh)) {
+            printf("[Bench] startup : %s was imported again, the cache is not used! \n", path.c_str());
+        }
+        // Model copies the sections into the staging ring, every byte is read once here too.
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(&mesh.header());
+        for (size_t offset = 0; offset + sizeof(uint64_t) <= mesh.size(); offset += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, data + offset, sizeof(word));
+            checksum += word;
+        }
+        cache_bytes += mesh.size();
+    }
+    double cache_ms = bench_milliseconds_since(start);
+
+    printf("[Bench] startup : text %.1f MB parsed in %.1f ms \n", text_bytes / (1024.0 * 1024.0), text_ms);
+    printf("[Bench] startup : first run (import + build + write) %.1f ms \n", first_run_ms);
+    printf("[Bench] startup : cache %.1f MB mapped in %.1f ms, %.1fx faster than the text (checksum %llu) \n",
+        cache_bytes / (1024.0 * 1024.0), cache_ms, cache_ms > 0.0 ? text_ms / cache_ms : 0.0, static_cast<unsigned long long>(checksum));
+
+    for (const std::string& path : paths) {
+        remove(MeshCache::cache_path(path, VertexFormat::FULL).c_str());
+        remove(path.c_str());
+    }
+}
@@ -7,6 +7,8 @@ class Component
 public:
 	virtual VkDescriptorSetLayout get_descriptorset_layout() { return NULL; };
 	virtual void update(FrameUpdateData& updateData ) {  };
+	// Recorded before the render pass begins (compute, copies, barriers).
+	virtual void update_before_frame(FrameUpdateData& updateData) {  };
 	//virtual void bind(const VkCommandBuffer& cmdBuf) {};
 	
 private:
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <vulkan/vulkan.h>
 #include "./core/sturcture_h.h"
+#include "./core/vertex_format.hpp"
 
 #include "./core/component.hpp"
 #include "./core/gameobject.hpp"
@@ -11,6 +12,8 @@
 #include "./core/pipeline.hpp"
 #include "./core/renderer.hpp"
 #include "./core/model.hpp"
+#include "./core/instanced_model.hpp"
+#include "./core/indirect_draw_list.hpp"
 #include "./core/image.hpp"
 #include "./core/transformObject.hpp" 
 
@@ -23,19 +26,25 @@ class CoreInstance;
 class Component;
 class Image;
 class TransformObject;
+class InstancedModel;
+class IndirectDrawList;
 class GameObject;
 
 //----------------------------
 // Helper
 //----------------------------
-uint32_t findMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool cmd_pool);
-void endSingleTimeCommands(CoreInstance& core_instance, VkCommandBuffer commandBuffer);
 void createBuffer(
-    VkDevice device,
-    VkPhysicalDevice physical_device,
+    CoreInstance& core_instance,
     VkDeviceSize size,
     VkBufferUsageFlags usage,
-    VkMemoryPropertyFlags properties,
+    const MemoryPolicy& memory_policy,
     VkBuffer& buffer,
-    VkDeviceMemory& bufferMemory);
+    MemoryAllocation& allocation);
+void destroyBuffer(CoreInstance& core_instance, VkBuffer& buffer, MemoryAllocation& allocation);
+void createImage(
+    CoreInstance& core_instance,
+    const VkImageCreateInfo& imageInfo,
+    const MemoryPolicy& memory_policy,
+    VkImage& image,
+    MemoryAllocation& allocation);
+void destroyImage(CoreInstance& core_instance, VkImage& image, MemoryAllocation& allocation);
\ No newline at end of file
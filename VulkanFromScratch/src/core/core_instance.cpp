@@ -1,9 +1,13 @@
 #include "core_instance.hpp"
+#include "swapchain.hpp"
 #include <GLFW/glfw3.h>
 #include <stdexcept>
 #include <set>
 #include <iostream>
 #include <unordered_set>
+#include <cstring>
+#include <climits>
+#include <algorithm>
 
 
 //----------------------
@@ -68,8 +72,20 @@ CoreInstance::CoreInstance(GLFWwindow& window)
     setupDebugMessenger();
     create_surface(window);
     setup_physical_device();
+    setup_memory_properties();
+    setup_optional_features();
     create_device_and_queuefamily();
     create_command_pool();
+    create_allocator();
+    create_instance_ring();
+    // The staging ring records into the immediate context (and acquires through it).
+    create_immediate_context();
+    create_staging_ring();
+    create_defragmenter();
+    create_deletion_queue();
+    create_resource_registry();
+    create_uniform_ring();
+    create_geometry_pool();
 }
 
 CoreInstance::~CoreInstance()
@@ -119,7 +135,7 @@ void CoreInstance::create_instance()
     }
 
 
-    if (vkCreateInstance(&createInfo, nullptr, &m_instance) != VK_SUCCESS) {
+    if (vkCreateInstance(&createInfo, allocation_callbacks(), &m_instance) != VK_SUCCESS) {
         throw std::runtime_error("failed to create instance!");
     }
 
@@ -169,6 +185,12 @@ std::vector<const char*> CoreInstance::query_instance_extensions()
 
     std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
+    // Needed to query VK_EXT_memory_budget on a Vulkan 1.0 instance.
+    m_properties2_supported = is_instance_extension_supported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    if (m_properties2_supported) {
+        extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    }
+
     if (enableValidationLayers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);        
         //extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);  // this is device extension
@@ -209,6 +231,64 @@ void CoreInstance::setup_physical_features()
     vkGetPhysicalDeviceFeatures(m_physicalDevice , &m_physical_device_features);
 }
 
+void CoreInstance::setup_memory_properties()
+{
+    // The memory properties never change for a physical device, query them once.
+    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &m_memory_properties);
+    m_heap_budgets.resize(m_memory_properties.memoryHeapCount);
+
+    m_memory_budget_supported =
+        m_properties2_supported &&
+        is_device_extension_supported(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (m_memory_budget_supported) {
+        // Resolved once, update_memory_budget() runs every frame.
+        m_get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            m_instance,
+            "vkGetPhysicalDeviceMemoryProperties2KHR");
+        m_memory_budget_supported = m_get_memory_properties2 != nullptr;
+    }
+    if (!m_memory_budget_supported) {
+        printf("VK_EXT_memory_budget not supported, using %.0f%% of each heap as budget \n", fallbackHeapBudgetRatio * 100.0f);
+    }
+}
+
+void CoreInstance::setup_optional_features()
+{
+    // Only queried, the device is created with the features it needs (see create_device_and_queuefamily).
+    m_index_type_uint8_supported = false;
+    if (m_properties2_supported &&
+        is_device_extension_supported(m_physicalDevice, VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME)) {
+        VkPhysicalDeviceIndexTypeUint8FeaturesEXT uint8_features{};
+        uint8_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &uint8_features;
+
+        auto func = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+            m_instance,
+            "vkGetPhysicalDeviceFeatures2KHR");
+        if (func != nullptr) {
+            func(m_physicalDevice, &features2);
+            m_index_type_uint8_supported = uint8_features.indexTypeUint8 == VK_TRUE;
+        }
+    }
+    if (!m_index_type_uint8_supported) {
+        printf("VK_EXT_index_type_uint8 not supported, small meshes use 16 bit indices \n");
+    }
+
+    // Indirect drawing (IndirectDrawList), each one has a fallback.
+    VkPhysicalDeviceFeatures supported{};
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supported);
+    m_physical_device_features.multiDrawIndirect = supported.multiDrawIndirect;
+    m_physical_device_features.drawIndirectFirstInstance = supported.drawIndirectFirstInstance;
+    m_draw_indirect_count_supported =
+        is_device_extension_supported(m_physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    printf("multiDrawIndirect %s, drawIndirectFirstInstance %s, VK_KHR_draw_indirect_count %s \n",
+        supported.multiDrawIndirect ? "on" : "off", supported.drawIndirectFirstInstance ? "on" : "off",
+        m_draw_indirect_count_supported ? "on" : "off");
+}
+
 void CoreInstance::setup_queuefamily_properties()
 {
     uint32_t queueFamilyCount = 0;
@@ -251,12 +331,54 @@ void CoreInstance::get_suitable_queuefamily(VkPhysicalDevice device ,QueueFamily
         }
         i++;
     }
+
+    get_transfer_queuefamily(physical_queuefamily_properties, queue_index);
+}
+
+void CoreInstance::get_transfer_queuefamily(const std::vector<VkQueueFamilyProperties>& families, QueueFamilyIndex& queue_index)
+{
+    // Uploads should not compete with rendering. Prefer a transfer only family
+    // (usually the DMA engine), then any other non graphic family that can copy.
+    // Every graphic family supports transfers implicitly, so that is the fallback.
+    queue_index.transfer_queuefamily_index.reset();
+    for (uint32_t i = 0; i < families.size(); i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            queue_index.transfer_queuefamily_index = i;
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < families.size(); i++) {
+        VkQueueFlags flags = families[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            queue_index.transfer_queuefamily_index = i;
+            return;
+        }
+    }
+    queue_index.transfer_queuefamily_index = queue_index.graphic_queuefamily_index;
 }
 
 void CoreInstance::cleanup()
 {
-    vkDestroyDevice(m_device, nullptr);
-    vkDestroyInstance(this->m_instance, nullptr);    
+    // Everything retired by the last frames can go once the GPU is done.
+    vkDeviceWaitIdle(m_device);
+    m_geometry_pool.cleanup();
+    m_uniform_ring.cleanup();
+    m_deletion_queue.flush_all();
+    m_resources.print_stats();
+    m_resources.cleanup();
+    m_defragmenter.print_stats();
+    m_defragmenter.cleanup();
+    m_staging_ring.cleanup();
+    m_immediate.cleanup();
+    m_instance_ring.cleanup();
+    m_allocator.print_stats();
+    m_allocator.cleanup();
+    vkDestroyDevice(m_device, allocation_callbacks());
+    vkDestroyInstance(this->m_instance, allocation_callbacks());    
+    if (enableHostAllocationTracking) {
+        m_host_allocator.print_stats();
+    }
 }
 
 void CoreInstance::add_validation_layer(VkDeviceCreateInfo& createInfo)
@@ -279,7 +401,8 @@ void CoreInstance::add_validation_layer(VkDeviceCreateInfo& createInfo)
 
 void CoreInstance::create_surface(GLFWwindow& window)
 {
-    if (glfwCreateWindowSurface(m_instance, &window, nullptr, &m_surface) != VK_SUCCESS) {
+    m_window = &window;
+    if (glfwCreateWindowSurface(m_instance, &window, allocation_callbacks(), &m_surface) != VK_SUCCESS) {
         throw std::runtime_error("failed to create window surface!");
     }
 }
@@ -291,27 +414,51 @@ void CoreInstance::create_device_and_queuefamily()
     // That's because you can create all of the command buffers on multiple threads 
     // and then submit them all at once on the main thread with a single low-overhead call.
 
-    VkDeviceQueueCreateInfo queueCreateInfo{};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = m_queueFamilyIndex.graphic_queuefamily_index.value();
-    queueCreateInfo.queueCount = 1;
+    // One queue per distinct family: graphic, present and transfer may all share one family.
+    std::set<uint32_t> unique_families = {
+        m_queueFamilyIndex.graphic_queuefamily_index.value(),
+        m_queueFamilyIndex.present_queuefamily_index.value(),
+        m_queueFamilyIndex.transfer_queuefamily_index.value() };
 
     // Vulkan lets you assign priorities to queues to influence the scheduling of command 
     // buffer execution using floating point numbers between 0.0 and 1.0. This is required 
     // even if there is only a single queue:
     float queuePriority = 1.0f;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    for (uint32_t family : unique_families) {
+        VkDeviceQueueCreateInfo queueCreateInfo{};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = family;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
 
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    createInfo.pQueueCreateInfos = &queueCreateInfo;
-    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 
     createInfo.pEnabledFeatures = &m_physical_device_features;
     createInfo.enabledExtensionCount = 0; //todo: add swap-chain extension
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    m_device_extension_list = deviceExtensions;
+    if (m_memory_budget_supported) {
+        m_device_extension_list.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    if (m_draw_indirect_count_supported) {
+        m_device_extension_list.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+    // 8 bit index buffers, see GeometryPool::allocate().
+    VkPhysicalDeviceIndexTypeUint8FeaturesEXT uint8_features{};
+    uint8_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INDEX_TYPE_UINT8_FEATURES_EXT;
+    if (m_index_type_uint8_supported) {
+        m_device_extension_list.push_back(VK_EXT_INDEX_TYPE_UINT8_EXTENSION_NAME);
+        uint8_features.indexTypeUint8 = VK_TRUE;
+        createInfo.pNext = &uint8_features;
+    }
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(m_device_extension_list.size());
+    createInfo.ppEnabledExtensionNames = m_device_extension_list.data();
 
     add_validation_layer(createInfo);
     // the enabledLayerCount and ppEnabledLayerNames fields of VkDeviceCreateInfo 
@@ -326,13 +473,23 @@ void CoreInstance::create_device_and_queuefamily()
     }
     */
   
-    if (vkCreateDevice(m_physicalDevice, &createInfo, nullptr, &m_device) != VK_SUCCESS) {
+    if (vkCreateDevice(m_physicalDevice, &createInfo, allocation_callbacks(), &m_device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
 
     // Get the first queue from m_graphic_queuefamily and fill into vkQueue object.
     vkGetDeviceQueue(m_device, m_queueFamilyIndex.graphic_queuefamily_index.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, m_queueFamilyIndex.present_queuefamily_index.value(), 0, &m_presentQueue);
+    vkGetDeviceQueue(m_device, m_queueFamilyIndex.transfer_queuefamily_index.value(), 0, &m_transferQueue);
+    if (has_dedicated_transfer_queue()) {
+        printf("Uploads use transfer queue family %u \n", m_queueFamilyIndex.transfer_queuefamily_index.value());
+    }
+    if (m_draw_indirect_count_supported) {
+        m_cmd_draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+            m_device,
+            "vkCmdDrawIndexedIndirectCountKHR");
+        m_draw_indirect_count_supported = m_cmd_draw_indexed_indirect_count != nullptr;
+    }
     
 
 }
@@ -400,7 +557,7 @@ void CoreInstance::setupDebugMessenger()
     if (!enableValidationLayers) return;
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
     populateDebugMessengerCreateInfo(createInfo);
-    if (CreateDebugUtilsMessengerEXT(m_instance, &createInfo, nullptr, &m_debugMessenger) != VK_SUCCESS) {
+    if (CreateDebugUtilsMessengerEXT(m_instance, &createInfo, allocation_callbacks(), &m_debugMessenger) != VK_SUCCESS) {
         throw std::runtime_error("failed to set up debug messenger!");
     }
 }
@@ -426,9 +583,166 @@ void CoreInstance::create_command_pool()
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = m_queueFamilyIndex.graphic_queuefamily_index.value();
 
-    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(m_device, &poolInfo, allocation_callbacks(), &m_commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
 
 }
 
+bool CoreInstance::is_instance_extension_supported(const char* name)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, extensions.data());
+
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+bool CoreInstance::is_device_extension_supported(VkPhysicalDevice device, const char* name)
+{
+    uint32_t extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+
+    for (const auto& extension : extensions) {
+        if (strcmp(extension.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+static uint32_t count_bits(VkMemoryPropertyFlags flags) {
+    uint32_t count = 0;
+    for (; flags; flags &= flags - 1) count++;
+    return count;
+}
+
+uint32_t CoreInstance::find_memory_type(uint32_t typeFilter, const MemoryPolicy& policy, VkDeviceSize size)
+{
+    /*
+    The VkPhysicalDeviceMemoryProperties structure has two arrays memoryTypes and memoryHeaps. 
+    Memory heaps are distinct memory resources like dedicated VRAM and swap space in RAM for when
+    VRAM runs out. The different types of memory exist within these heaps. 
+    Instead of taking the first type that matches, every candidate is scored against the policy
+    and the heap it comes from is checked against the budget.
+    */
+    int best_score = INT_MIN;
+    uint32_t best_type = UINT32_MAX;
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; i++) {
+        VkMemoryPropertyFlags flags = m_memory_properties.memoryTypes[i].propertyFlags;
+        if (!(typeFilter & (1 << i)) || (flags & policy.required) != policy.required) {
+            continue;
+        }
+
+        int score = 0;
+        score += 4 * count_bits(flags & policy.preferred);
+        score -= 4 * count_bits(flags & policy.avoid);
+        score -= count_bits(flags & ~(policy.required | policy.preferred)); // fewer unrelated flags is better
+        if (is_heap_over_budget(m_memory_properties.memoryTypes[i].heapIndex, size)) {
+            score -= 100; // last resort only
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_type = i;
+        }
+    }
+
+    if (best_type == UINT32_MAX) {
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+    return best_type;
+}
+
+void CoreInstance::update_memory_budget()
+{
+    if (m_memory_budget_supported) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+        budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budget_properties;
+
+        m_get_memory_properties2(m_physicalDevice, &properties2);
+        for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++) {
+            m_heap_budgets[i].usage = budget_properties.heapUsage[i];
+            m_heap_budgets[i].budget = budget_properties.heapBudget[i];
+        }
+        return;
+    }
+
+    // Fallback: only our own allocations are known.
+    for (uint32_t i = 0; i < m_memory_properties.memoryHeapCount; i++) {
+        m_heap_budgets[i].usage = m_allocator.get_heap_stats(i).block_bytes;
+        m_heap_budgets[i].budget = static_cast<VkDeviceSize>(m_memory_properties.memoryHeaps[i].size * fallbackHeapBudgetRatio);
+    }
+}
+
+CoreInstance::HeapBudget CoreInstance::get_heap_budget(uint32_t heap_index) const
+{
+    return m_heap_budgets[heap_index];
+}
+
+bool CoreInstance::is_heap_over_budget(uint32_t heap_index, VkDeviceSize extra_bytes) const
+{
+    const auto& heap = m_heap_budgets[heap_index];
+    return heap.budget != 0 && heap.usage + extra_bytes > heap.budget;
+}
+
+void CoreInstance::track_heap_usage(uint32_t heap_index, int64_t delta_bytes)
+{
+    auto& heap = m_heap_budgets[heap_index];
+    heap.usage = static_cast<VkDeviceSize>(std::max<int64_t>(0, static_cast<int64_t>(heap.usage) + delta_bytes));
+}
+
+void CoreInstance::create_allocator()
+{
+    // All buffers and images are sub-allocated from a few big VkDeviceMemory blocks.
+    m_allocator.init(*this);
+    update_memory_budget();
+}
+
+void CoreInstance::create_uniform_ring()
+{
+    m_uniform_ring.init(*this, SwapChain::MAX_FRAMES_IN_FLIGHT, uniformRingFrameSize);
+}
+
+void CoreInstance::create_instance_ring()
+{
+    m_instance_ring.init(*this, SwapChain::MAX_FRAMES_IN_FLIGHT, instanceRingFrameCapacity);
+}
+
+void CoreInstance::create_staging_ring()
+{
+    m_staging_ring.init(*this, stagingRingSize);
+}
+
+void CoreInstance::create_immediate_context()
+{
+    m_immediate.init(*this);
+}
+
+void CoreInstance::create_defragmenter()
+{
+    m_defragmenter.init(*this, defragBytesPerFrame);
+}
+
+void CoreInstance::create_deletion_queue()
+{
+    m_deletion_queue.init(SwapChain::MAX_FRAMES_IN_FLIGHT);
+}
+
+void CoreInstance::create_resource_registry()
+{
+    m_resources.init(*this);
+}
+
+void CoreInstance::create_geometry_pool()
+{
+    m_geometry_pool.init(*this, geometryPoolVertexBytes, geometryPoolIndexBytes);
+}
\ No newline at end of file
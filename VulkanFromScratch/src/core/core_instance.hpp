@@ -2,6 +2,16 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include "./core/window.hpp"
+#include "./core/host_allocator.hpp"
+#include "./core/memory_allocator.hpp"
+#include "./core/uniform_ring.hpp"
+#include "./core/instance_ring.hpp"
+#include "./core/staging_ring.hpp"
+#include "./core/immediate_context.hpp"
+#include "./core/defragmenter.hpp"
+#include "./core/deletion_queue.hpp"
+#include "./core/resource_registry.hpp"
+#include "./core/geometry_pool.hpp"
 #include <optional>  // std:c++17 up
 
 //#include <iostream>
@@ -24,6 +34,8 @@ public:
 	void setup_physical_property();
 	void setup_physical_features();
 	void setup_queuefamily_properties();
+	void setup_memory_properties();
+	void setup_optional_features();
 	bool is_physical_device_suitable(VkPhysicalDevice device);
 	void cleanup();
 
@@ -32,17 +44,63 @@ public:
 	//--------------------
 	VkInstance get_instance() { return m_instance; }
 	VkSurfaceKHR get_surface(){ return m_surface; }
+	// The window of the surface, SwapChain reads its framebuffer size.
+	inline GLFWwindow& window() const { return *m_window; }
 	VkDevice get_device() { return m_device; }
 	VkPhysicalDevice get_physical_device() { return m_physicalDevice; }
 	inline const auto get_queuefailmy_indexs () const { return &m_queueFamilyIndex; }
 	inline const VkQueue graphic_queue() const { return m_graphicsQueue;  }
 	inline const VkQueue present_queue() const { return m_presentQueue; }
+	// Same queue as graphic_queue() when the device has no separate transfer family.
+	inline const VkQueue transfer_queue() const { return m_transferQueue; }
+	inline bool has_dedicated_transfer_queue() const {
+		return m_queueFamilyIndex.transfer_queuefamily_index != m_queueFamilyIndex.graphic_queuefamily_index;
+	}
 	inline const VkCommandPool& cmd_pool() const { return m_commandPool; }
+	// Pass to every vkCreate* / vkDestroy* call, objects have to be destroyed with the callbacks they were created with.
+	inline const VkAllocationCallbacks* allocation_callbacks() const {
+		return enableHostAllocationTracking ? m_host_allocator.callbacks() : nullptr;
+	}
+	inline HostAllocator& host_allocator() { return m_host_allocator; }
+	inline MemoryAllocator& allocator() { return m_allocator; }
+	inline UniformRing& uniform_ring() { return m_uniform_ring; }
+	inline InstanceRing& instance_ring() { return m_instance_ring; }
+	inline StagingRing& staging_ring() { return m_staging_ring; }
+	inline ImmediateContext& immediate() { return m_immediate; }
+	inline Defragmenter& defragmenter() { return m_defragmenter; }
+	inline DeletionQueue& deletion_queue() { return m_deletion_queue; }
+	inline ResourceRegistry& resources() { return m_resources; }
+	inline GeometryPool& geometry_pool() { return m_geometry_pool; }
+
+	//--------------------
+	//  Memory
+	//--------------------
+	struct HeapBudget {
+		VkDeviceSize usage = 0;		// bytes currently used on the heap (by the whole process)
+		VkDeviceSize budget = 0;	// bytes the process can use before the driver starts paging
+	};
+	inline const VkPhysicalDeviceMemoryProperties& get_memory_properties() const { return m_memory_properties; }
+	// Picks the best memory type for the policy. Types on a heap that cannot take `size` more
+	// bytes without going over budget are only used when nothing else fits.
+	uint32_t	find_memory_type(uint32_t typeFilter, const MemoryPolicy& policy, VkDeviceSize size = 0);
+	void		update_memory_budget();  // call once per frame
+	HeapBudget	get_heap_budget(uint32_t heap_index) const;
+	bool		is_heap_over_budget(uint32_t heap_index, VkDeviceSize extra_bytes) const;
+	// Keeps the usage up to date between two update_memory_budget() calls.
+	void		track_heap_usage(uint32_t heap_index, int64_t delta_bytes);
+	inline bool has_memory_budget() const { return m_memory_budget_supported; }
+	// VK_INDEX_TYPE_UINT8_EXT can be used in vkCmdBindIndexBuffer.
+	inline bool has_index_type_uint8() const { return m_index_type_uint8_supported; }
+	// Features the device was created with (only the ones the renderer asks for are on).
+	inline const VkPhysicalDeviceFeatures& enabled_features() const { return m_physical_device_features; }
+	// nullptr without VK_KHR_draw_indirect_count.
+	inline PFN_vkCmdDrawIndexedIndirectCountKHR cmd_draw_indexed_indirect_count() const { return m_cmd_draw_indexed_indirect_count; }
 private:
 	struct QueueFamilyIndex
 	{
 		std::optional<uint32_t>                 graphic_queuefamily_index; // graphic command process queue family
 		std::optional<uint32_t>                 present_queuefamily_index; // present surface queue family
+		std::optional<uint32_t>                 transfer_queuefamily_index; // upload queue family (falls back to graphic)
 		bool is_complete() {
 			return
 				graphic_queuefamily_index.has_value() && present_queuefamily_index.has_value();
@@ -55,6 +113,7 @@ private:
 	// Instance level
 	VkInstance m_instance{};
 	VkSurfaceKHR m_surface{};
+	GLFWwindow* m_window = nullptr;
 	std::vector<VkExtensionProperties> m_extensions;
 	std::vector<const char*> query_instance_extensions();
 
@@ -62,8 +121,28 @@ private:
 	VkDevice m_device{};
 	VkQueue m_graphicsQueue;
 	VkQueue m_presentQueue;
+	VkQueue m_transferQueue;
 	std::vector<const char*> m_extension_list;
+	std::vector<const char*> m_device_extension_list;
+	bool m_properties2_supported = false;	// VK_KHR_get_physical_device_properties2 (instance)
+	bool m_memory_budget_supported = false;	// VK_EXT_memory_budget (device)
+	PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_get_memory_properties2 = nullptr;	// set with m_memory_budget_supported
+	bool m_index_type_uint8_supported = false;	// VK_EXT_index_type_uint8 (device)
+	bool m_draw_indirect_count_supported = false;	// VK_KHR_draw_indirect_count (device)
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_cmd_draw_indexed_indirect_count = nullptr;
+	bool is_instance_extension_supported(const char* name);
+	bool is_device_extension_supported(VkPhysicalDevice device, const char* name);
 	VkCommandPool m_commandPool;
+	HostAllocator m_host_allocator;
+	MemoryAllocator m_allocator;
+	UniformRing m_uniform_ring;
+	InstanceRing m_instance_ring;
+	StagingRing m_staging_ring;
+	ImmediateContext m_immediate;
+	Defragmenter m_defragmenter;
+	DeletionQueue m_deletion_queue;
+	ResourceRegistry m_resources;
+	GeometryPool m_geometry_pool;
 
 	void add_validation_layer(VkDeviceCreateInfo& createInfo);
 	bool check_validation_layer_valid();
@@ -71,6 +150,15 @@ private:
 	void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 	void setupDebugMessenger();
 	void create_command_pool();
+	void create_allocator();
+	void create_uniform_ring();
+	void create_instance_ring();
+	void create_staging_ring();
+	void create_immediate_context();
+	void create_defragmenter();
+	void create_deletion_queue();
+	void create_resource_registry();
+	void create_geometry_pool();
 	//--------------------
 	// Physical device:
 	//--------------------
@@ -81,7 +169,10 @@ private:
 	VkPhysicalDeviceProperties		m_physical_device_properties{};
 	VkPhysicalDeviceFeatures		m_physical_device_features{}; //init by vk_false
 	std::vector <VkQueueFamilyProperties> m_physical_queuefamily_properties;
+	VkPhysicalDeviceMemoryProperties m_memory_properties{};
+	std::vector<HeapBudget>		m_heap_budgets;
 	void get_suitable_queuefamily(VkPhysicalDevice device, QueueFamilyIndex& queue_index);
+	void get_transfer_queuefamily(const std::vector<VkQueueFamilyProperties>& families, QueueFamilyIndex& queue_index);
 
 
 	//--------------------
@@ -90,6 +181,26 @@ private:
 	const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
 	const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 	VkDebugUtilsMessengerEXT m_debugMessenger;
+	// Without VK_EXT_memory_budget we assume the process can use this fraction of a heap.
+	const float fallbackHeapBudgetRatio = 0.8f;
+	// Bytes of transient uniform data per frame in flight (~16k objects of 256 bytes).
+	const VkDeviceSize uniformRingFrameSize = 4 * 1024 * 1024;
+	// Per instance transforms per frame in flight (48 bytes each).
+	const uint32_t instanceRingFrameCapacity = 64 * 1024;
+	// Shared staging memory for uploads, bigger uploads get a transient buffer.
+	const VkDeviceSize stagingRingSize = 32 * 1024 * 1024;
+	// Upper bound of the bytes the defragmenter copies per frame.
+	const VkDeviceSize defragBytesPerFrame = 8 * 1024 * 1024;
+	// Initial size of the shared mesh buffers (all vertices, and the indices of each width),
+	// they double whenever an allocation does not fit.
+	const VkDeviceSize geometryPoolVertexBytes = 32 * 1024 * 1024;
+	const VkDeviceSize geometryPoolIndexBytes = 16 * 1024 * 1024;
+	// Route the driver's host allocations through m_host_allocator (counted per scope).
+#ifdef NDEBUG
+	const bool enableHostAllocationTracking = false;
+#else
+	const bool enableHostAllocationTracking = true;
+#endif
 
 #ifdef NDEBUG
 	const bool enableValidationLayers = false;
@@ -0,0 +1,81 @@
+#include "culling_pass.hpp"
+#include "core/core_fwd.h"
+#include <algorithm>
+
+CullingPass::CullingPass(CoreInstance& core, uint32_t max_objects, VkBuffer input, VkDeviceSize input_frame_size,
+    VkDeviceSize objects_offset, Renderer* renderer)
+    : m_renderer{ renderer }
+{
+    if (m_renderer) {
+        m_pyramid = std::make_unique<DepthPyramid>(core, *m_renderer);
+    }
+    m_culler = std::make_unique<FrustumCuller>(core, max_objects, input, input_frame_size, objects_offset, 0, m_pyramid.get());
+}
+
+CullingPass::~CullingPass()
+{
+    // The culler points at the pyramid.
+    m_culler.reset();
+    m_pyramid.reset();
+}
+
+FrustumCuller::Object CullingPass::object(const IndirectDraw& draw, const Meshlet* meshlet, bool cone,
+    uint32_t command, uint32_t batch, uint32_t batch_first)
+{
+    // Bounds are in decoded space, the dequantization is already part of the vertex positions there.
+    glm::vec4 sphere = meshlet ? glm::vec4(meshlet->center, meshlet->radius) : draw.model->bounding_sphere();
+    glm::vec3 axes[3] = { glm::vec3(draw.transform[0]), glm::vec3(draw.transform[1]), glm::vec3(draw.transform[2]) };
+    float scales[3] = { glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]) };
+    float scale = max_scale(draw.transform);
+
+    FrustumCuller::Object object;
+    object.sphere = world_sphere(draw, sphere);
+    object.command = command;
+    object.batch = batch;
+    object.batch_first = batch_first;
+
+    // The cone angles only survive rotations and uniform scales, a mirror turns the triangles around.
+    float min_scale = std::min({ scales[0], scales[1], scales[2] });
+    bool conformal = min_scale > 0.0f && scale - min_scale <= scale * 1e-3f && glm::dot(glm::cross(axes[0], axes[1]), axes[2]) > 0.0f;
+    if (meshlet && cone && meshlet->has_cone() && conformal) {
+        glm::vec3 axis = glm::normalize(glm::vec3(draw.transform * glm::vec4(meshlet->cone_axis, 0.0f)));
+        object.cone = glm::vec4(axis, meshlet->cone_cutoff);
+        object.cone_apex = glm::vec4(glm::vec3(draw.transform * glm::vec4(meshlet->cone_apex, 1.0f)), 1.0f);
+    }
+    return object;
+}
+
+void CullingPass::dispatch(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+    uint32_t object_count, uint32_t batch_count, bool compact, uint64_t layout_version)
+{
+    FrustumCuller::Phase phase = FrustumCuller::Phase::FRUSTUM;
+    if (m_pyramid) {
+        // Resized with the swap chain, before anything binds the culling sets.
+        if (m_pyramid->update_extent()) m_culler->update_pyramid();
+        // The visibility is per command, a new layout reorders them.
+        if (m_culled_layout != layout_version) {
+            m_culler->reset_visibility();
+            m_culled_layout = layout_version;
+        }
+        phase = FrustumCuller::Phase::EARLY;
+    }
+    m_culler->dispatch(cmdBuf, frame, view_projection, object_count, batch_count, compact, phase);
+    m_dispatched = true;
+}
+
+void CullingPass::dispatch_late(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+    uint32_t object_count, uint32_t batch_count, bool compact)
+{
+    // The pyramid is built from what the early phase (and everything before the list) drew.
+    m_renderer->end_renderPass();
+    m_pyramid->build(cmdBuf, frame);
+    m_culler->dispatch(cmdBuf, frame, view_projection, object_count, batch_count, compact, FrustumCuller::Phase::LATE);
+    m_renderer->resume_renderPass();
+}
+
+bool CullingPass::take_dispatched()
+{
+    bool dispatched = m_dispatched;
+    m_dispatched = false;
+    return dispatched;
+}
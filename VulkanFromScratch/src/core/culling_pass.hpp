@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <glm.hpp>
+#include "core/frustum_culler.hpp"
+#include "core/depth_pyramid.hpp"
+#include "core/indirect_draw.hpp"
+#include "helper/meshlet_builder.hpp"
+
+class CoreInstance;
+class Renderer;
+
+// Culling of IndirectDrawList : the FrustumCuller dispatch before the render pass and,
+// with occlusion culling, the DepthPyramid and the render pass split of the late phase.
+// The list owns the objects and commands (`input`), the pass only points the culler at them.
+class CullingPass {
+public:
+	// Objects at `objects_offset` and source commands at 0 of `input`, plus `input_frame_size`
+	// per frame. With a `renderer` (which has to outlive the pass) the culling is two phase.
+	CullingPass(CoreInstance& core, uint32_t max_objects, VkBuffer input, VkDeviceSize input_frame_size,
+		VkDeviceSize objects_offset, Renderer* renderer = nullptr);
+	~CullingPass();
+
+	// Bounds of a draw (`meshlet` nullptr for the whole model) as the culler reads them.
+	// `cone` adds the meshlet's normal cone when the transform keeps its angles.
+	static FrustumCuller::Object	object(const IndirectDraw& draw, const Meshlet* meshlet, bool cone,
+										uint32_t command, uint32_t batch, uint32_t batch_first);
+
+	// Outside the render pass : the frustum phase, or the early one with occlusion culling.
+	// `layout_version` changes when the commands were reordered, the visibility is reset then.
+	void			dispatch(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+						uint32_t object_count, uint32_t batch_count, bool compact, uint64_t layout_version);
+	// Inside the render pass, after the early draws : ends it, builds the pyramid, culls the
+	// rest against it and resumes the pass. Bound pipelines and buffers survive the split.
+	void			dispatch_late(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+						uint32_t object_count, uint32_t batch_count, bool compact);
+	// True once per dispatch(), the frame being recorded draws the culled output then.
+	bool			take_dispatched();
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	inline bool					has_occlusion() const { return m_pyramid != nullptr; }
+	inline FrustumCuller&		culler() { return *m_culler; }
+	inline const FrustumCuller&	culler() const { return *m_culler; }
+	// nullptr without occlusion culling.
+	inline const DepthPyramid*	pyramid() const { return m_pyramid.get(); }
+
+private:
+	Renderer*						m_renderer = nullptr;
+	std::unique_ptr<DepthPyramid>	m_pyramid;			// before the culler, which points at it
+	std::unique_ptr<FrustumCuller>	m_culler;
+	uint64_t						m_culled_layout = 0;	// layout version the visibility belongs to
+	bool							m_dispatched = false;	// for the frame being recorded
+};
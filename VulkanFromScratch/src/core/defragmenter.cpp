@@ -0,0 +1,326 @@
+#include "defragmenter.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <cstdio>
+#include <algorithm>
+
+Defragmenter::~Defragmenter()
+{
+    cleanup();
+}
+
+void Defragmenter::init(CoreInstance& core_instance, VkDeviceSize max_bytes_per_frame)
+{
+    m_core_instance = &core_instance;
+    m_max_bytes_per_frame = max_bytes_per_frame;
+}
+
+void Defragmenter::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    // Old resources still waiting in the deletion queue have been flushed by CoreInstance.
+    m_entries.clear();
+    m_free_ids.clear();
+    m_core_instance = nullptr;
+}
+
+//----------------------
+//  Registration
+//----------------------
+uint32_t Defragmenter::add_entry(Entry&& entry)
+{
+    if (!m_free_ids.empty()) {
+        uint32_t id = m_free_ids.back();
+        m_free_ids.pop_back();
+        m_entries[id] = std::move(entry);
+        return id;
+    }
+    m_entries.push_back(std::move(entry));
+    return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+uint32_t Defragmenter::register_buffer(VkBuffer buffer, const MemoryAllocation& allocation,
+    VkDeviceSize size, VkBufferUsageFlags usage, uint64_t ready_ticket, MoveCallback on_moved)
+{
+    const VkBufferUsageFlags copy_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if ((usage & copy_usage) != copy_usage) {
+        throw std::runtime_error("failed to register buffer, movable buffers need the transfer src/dst usage!");
+    }
+
+    Entry entry{};
+    entry.kind = Kind::Buffer;
+    entry.buffer = buffer;
+    entry.allocation = allocation;
+    // Same create info as createBuffer()
+    entry.buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    entry.buffer_info.size = size;
+    entry.buffer_info.usage = usage;
+    entry.buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    entry.ready_ticket = ready_ticket;
+    entry.on_moved = std::move(on_moved);
+    // Resources created from the same create info have the same requirements,
+    // so candidates can be checked before creating anything.
+    vkGetBufferMemoryRequirements(m_core_instance->get_device(), buffer, &entry.requirements);
+    return add_entry(std::move(entry));
+}
+
+uint32_t Defragmenter::register_image(VkImage image, const MemoryAllocation& allocation,
+    const VkImageCreateInfo& create_info, VkImageLayout layout, uint64_t ready_ticket, MoveCallback on_moved)
+{
+    const VkImageUsageFlags copy_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if ((create_info.usage & copy_usage) != copy_usage) {
+        throw std::runtime_error("failed to register image, movable images need the transfer src/dst usage!");
+    }
+
+    Entry entry{};
+    entry.kind = Kind::Image;
+    entry.image = image;
+    entry.allocation = allocation;
+    entry.image_info = create_info;
+    entry.image_info.pNext = nullptr;
+    entry.image_info.pQueueFamilyIndices = nullptr;
+    entry.image_info.queueFamilyIndexCount = 0;
+    entry.image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    entry.layout = layout;
+    entry.ready_ticket = ready_ticket;
+    entry.on_moved = std::move(on_moved);
+    vkGetImageMemoryRequirements(m_core_instance->get_device(), image, &entry.requirements);
+    return add_entry(std::move(entry));
+}
+
+void Defragmenter::unregister(uint32_t id)
+{
+    if (id >= m_entries.size() || m_entries[id].kind == Kind::None) return;
+    m_entries[id] = Entry{};
+    m_free_ids.push_back(id);
+}
+
+void Defragmenter::set_ready_ticket(uint32_t id, uint64_t ready_ticket)
+{
+    if (id >= m_entries.size() || m_entries[id].kind == Kind::None) return;
+    m_entries[id].ready_ticket = std::max(m_entries[id].ready_ticket, ready_ticket);
+}
+
+//----------------------
+//  Per frame
+//----------------------
+void Defragmenter::step()
+{
+    m_frame++;
+    if (!m_enabled || m_entries.empty()) return;
+
+    auto& staging = m_core_instance->staging_ring();
+    auto& allocator = m_core_instance->allocator();
+    VkDeviceSize budget = m_max_bytes_per_frame;
+
+    // One pass over the entries at most, starting where the last frame stopped.
+    uint32_t count = static_cast<uint32_t>(m_entries.size());
+    for (uint32_t i = 0; i < count && budget > 0; i++) {
+        m_cursor = (m_cursor + 1) % count;
+        Entry& entry = m_entries[m_cursor];
+
+        if (entry.kind == Kind::None) continue;
+        if (entry.busy_until > m_frame) continue;
+        if (!staging.is_complete(entry.ready_ticket)) continue;
+        if (entry.allocation.size > budget) continue;
+        if (!allocator.is_move_candidate(entry.allocation)) continue;
+
+        if (!m_has_started) {
+            m_stats.fragmentation_at_start = allocator.get_fragmentation_stats().fragmentation();
+            m_has_started = true;
+        }
+
+        MemoryAllocation moved;
+        if (!move(entry, moved)) continue;
+
+        budget -= moved.size;
+        m_stats.move_count++;
+        m_stats.bytes_moved += moved.size;
+    }
+}
+
+bool Defragmenter::move(Entry& entry, MemoryAllocation& moved)
+{
+    VkDevice device = m_core_instance->get_device();
+    auto& allocator = m_core_instance->allocator();
+    if (!allocator.allocate_for_move(entry.requirements, entry.allocation, moved)) {
+        return false;
+    }
+
+    // If the new resource can't be bound the move is skipped, the entry stays where it is.
+    // Nothing was recorded yet, so the new handle and allocation are released right away.
+    MovedResource result{};
+    result.allocation = moved;
+    if (entry.kind == Kind::Buffer) {
+        if (vkCreateBuffer(device, &entry.buffer_info, m_core_instance->allocation_callbacks(), &result.buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+        if (vkBindBufferMemory(device, result.buffer, moved.memory, moved.offset) != VK_SUCCESS) {
+            vkDestroyBuffer(device, result.buffer, m_core_instance->allocation_callbacks());
+            allocator.free(moved);
+            return false;
+        }
+        record_buffer_copy(entry, result.buffer);
+    }
+    else {
+        if (vkCreateImage(device, &entry.image_info, m_core_instance->allocation_callbacks(), &result.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image!");
+        }
+        if (vkBindImageMemory(device, result.image, moved.memory, moved.offset) != VK_SUCCESS) {
+            vkDestroyImage(device, result.image, m_core_instance->allocation_callbacks());
+            allocator.free(moved);
+            return false;
+        }
+        record_image_copy(entry, result.image);
+    }
+
+    VkBuffer old_buffer = entry.buffer;
+    VkImage old_image = entry.image;
+    MemoryAllocation old_allocation = entry.allocation;
+    entry.buffer = result.buffer;
+    entry.image = result.image;
+    entry.allocation = moved;
+    entry.busy_until = m_frame + SwapChain::MAX_FRAMES_IN_FLIGHT;
+    // The owner retires what points to the old resource (views...) first.
+    entry.on_moved(result);
+
+    // Frames still in flight may use the old resource, it is destroyed once they are done.
+    // The copy is submitted ahead of this frame, so its fence covers the copy too.
+    m_core_instance->deletion_queue().push([this, old_buffer, old_image, old_allocation]() {
+        destroy_old(old_buffer, old_image, old_allocation);
+    });
+    return true;
+}
+
+void Defragmenter::record_buffer_copy(const Entry& entry, VkBuffer dst)
+{
+    VkCommandBuffer cmd = m_core_instance->immediate().record();
+
+    // Previous frames may still be writing the source (e.g. compute output).
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.size = entry.buffer_info.size;
+    vkCmdCopyBuffer(cmd, entry.buffer, dst, 1, &region);
+    // The batch ends with a barrier, draws submitted afterwards see the copy.
+}
+
+// Copies and barriers have to name every aspect of depth / stencil formats.
+static VkImageAspectFlags aspect_of(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+void Defragmenter::record_image_copy(const Entry& entry, VkImage dst)
+{
+    VkCommandBuffer cmd = m_core_instance->immediate().record();
+    const VkImageCreateInfo& info = entry.image_info;
+    const VkImageAspectFlags aspect = aspect_of(info.format);
+
+    VkImageMemoryBarrier barriers[2]{};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange.aspectMask = aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = info.mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = info.arrayLayers;
+    }
+    // Old image : its layout → transfer source (it is destroyed afterwards, no need to go back)
+    barriers[0].image = entry.image;
+    barriers[0].oldLayout = entry.layout;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    // New image : content is discarded → transfer destination
+    barriers[1].image = dst;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 2, barriers);
+
+    std::vector<VkImageCopy> regions(info.mipLevels);
+    for (uint32_t mip = 0; mip < info.mipLevels; mip++) {
+        VkImageCopy& region = regions[mip];
+        region.srcSubresource.aspectMask = aspect;
+        region.srcSubresource.mipLevel = mip;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = info.arrayLayers;
+        region.dstSubresource = region.srcSubresource;
+        region.extent.width = std::max(1u, info.extent.width >> mip);
+        region.extent.height = std::max(1u, info.extent.height >> mip);
+        region.extent.depth = std::max(1u, info.extent.depth >> mip);
+    }
+    vkCmdCopyImage(cmd,
+        entry.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    // New image : back to the layout the owner expects.
+    VkImageMemoryBarrier& barrier = barriers[1];
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = entry.layout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void Defragmenter::destroy_old(VkBuffer buffer, VkImage image, MemoryAllocation allocation)
+{
+    auto& allocator = m_core_instance->allocator();
+    auto count_blocks = [&allocator](uint32_t& blocks, VkDeviceSize& bytes) {
+        blocks = 0;
+        bytes = 0;
+        for (uint32_t i = 0; i < allocator.heap_count(); i++) {
+            auto stats = allocator.get_heap_stats(i);
+            blocks += stats.block_count;
+            bytes += stats.block_bytes;
+        }
+    };
+    uint32_t blocks_before, blocks_after;
+    VkDeviceSize bytes_before, bytes_after;
+    count_blocks(blocks_before, bytes_before);
+
+    if (buffer != VK_NULL_HANDLE) destroyBuffer(*m_core_instance, buffer, allocation);
+    if (image != VK_NULL_HANDLE) destroyImage(*m_core_instance, image, allocation);
+
+    // Emptied blocks are released by the allocator as soon as their last allocation is freed.
+    count_blocks(blocks_after, bytes_after);
+    if (blocks_after < blocks_before) {
+        m_stats.blocks_released += blocks_before - blocks_after;
+        m_stats.bytes_released += bytes_before - bytes_after;
+    }
+}
+
+void Defragmenter::print_stats() const
+{
+    printf("[Defrag] %u move(s) %.2f MB copied, %u block(s) %.2f MB released, fragmentation %.2f -> %.2f \n",
+        m_stats.move_count, m_stats.bytes_moved / (1024.0 * 1024.0),
+        m_stats.blocks_released, m_stats.bytes_released / (1024.0 * 1024.0),
+        m_stats.fragmentation_at_start,
+        m_core_instance ? m_core_instance->allocator().get_fragmentation_stats().fragmentation() : 0.0f);
+}
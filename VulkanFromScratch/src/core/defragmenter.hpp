@@ -0,0 +1,102 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <functional>
+#include "./core/memory_allocator.hpp"
+
+class CoreInstance;
+
+// Incremental compaction of the device memory blocks.
+// Owners register the buffers / images they are willing to see moved. Every frame step()
+// picks a few registered resources living in the emptiest block of their pool, creates a
+// copy in a fuller block, records the GPU copy into CoreInstance::immediate() and hands the
+// new handle to the owner's callback (which swaps its handle and rewrites its descriptors).
+// The old resource goes through CoreInstance::deletion_queue(); when it was the last
+// allocation of its block, the allocator releases that VkDeviceMemory.
+class Defragmenter {
+public:
+	Defragmenter() = default;
+	~Defragmenter();
+
+	// Passed to the owner once the copy has been recorded. Only the handle of
+	// the registered kind (buffer or image) is set.
+	struct MovedResource {
+		VkBuffer			buffer = VK_NULL_HANDLE;
+		VkImage				image = VK_NULL_HANDLE;
+		MemoryAllocation	allocation;
+	};
+	using MoveCallback = std::function<void(const MovedResource&)>;
+
+	struct Stats {
+		uint32_t		move_count = 0;
+		VkDeviceSize	bytes_moved = 0;
+		uint32_t		blocks_released = 0;	// VkDeviceMemory blocks emptied by the moves
+		VkDeviceSize	bytes_released = 0;
+		float			fragmentation_at_start = 0.0f;	// see MemoryAllocator::FragmentationStats
+	};
+
+	void init(CoreInstance& core_instance, VkDeviceSize max_bytes_per_frame);
+	void cleanup();
+
+	//--------------------
+	//  Registration
+	//--------------------
+	// The resource must be created with the transfer src + dst usages. `ready_ticket` is the
+	// StagingRing ticket of its upload, it is never moved before that upload has completed.
+	// Returns an id for unregister(), call it before destroying the resource.
+	// Buffers are expected to come from createBuffer() (exclusive sharing).
+	uint32_t register_buffer(VkBuffer buffer, const MemoryAllocation& allocation,
+		VkDeviceSize size, VkBufferUsageFlags usage, uint64_t ready_ticket, MoveCallback on_moved);
+	// The image has to stay in `layout` (between frames) while it is registered.
+	uint32_t register_image(VkImage image, const MemoryAllocation& allocation,
+		const VkImageCreateInfo& create_info, VkImageLayout layout, uint64_t ready_ticket, MoveCallback on_moved);
+	void unregister(uint32_t id);
+	// For resources written again after registration : the resource is not moved before
+	// the upload of `ready_ticket` has completed either.
+	void set_ready_ticket(uint32_t id, uint64_t ready_ticket);
+
+	//--------------------
+	//  Per frame
+	//--------------------
+	// Call once per frame after the frame fence wait, before the command buffer is recorded.
+	void step();
+	inline void set_enabled(bool enabled) { m_enabled = enabled; }
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	inline const Stats& stats() const { return m_stats; }
+	void print_stats() const;
+
+private:
+	enum class Kind { None, Buffer, Image };
+	struct Entry {
+		Kind				kind = Kind::None;
+		VkBuffer			buffer = VK_NULL_HANDLE;
+		VkImage				image = VK_NULL_HANDLE;
+		MemoryAllocation	allocation;
+		VkMemoryRequirements requirements{};
+		VkBufferCreateInfo	buffer_info{};
+		VkImageCreateInfo	image_info{};
+		VkImageLayout		layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint64_t			ready_ticket = 0;
+		uint64_t			busy_until = 0;	// frame index until which the previous copy may still be in use
+		MoveCallback		on_moved;
+	};
+
+	CoreInstance*		m_core_instance = nullptr;
+	VkDeviceSize		m_max_bytes_per_frame = 0;
+	bool				m_enabled = true;
+	std::vector<Entry>	m_entries;
+	std::vector<uint32_t> m_free_ids;
+	uint32_t			m_cursor = 0;		// round robin over the entries
+	uint64_t			m_frame = 0;
+	Stats				m_stats;
+	bool				m_has_started = false;
+
+	bool	move(Entry& entry, MemoryAllocation& moved);
+	void	record_buffer_copy(const Entry& entry, VkBuffer dst);
+	void	record_image_copy(const Entry& entry, VkImage dst);
+	void	destroy_old(VkBuffer buffer, VkImage image, MemoryAllocation allocation);
+	uint32_t add_entry(Entry&& entry);
+};
@@ -0,0 +1,56 @@
+#include "deletion_queue.hpp"
+
+DeletionQueue::~DeletionQueue()
+{
+    flush_all();
+}
+
+void DeletionQueue::init(uint32_t frames_in_flight)
+{
+    m_frames.resize(frames_in_flight);
+}
+
+void DeletionQueue::flush_all()
+{
+    // Oldest first, the objects may depend on each other (view → image).
+    for (auto& destroy : m_before_first_frame) destroy();
+    m_before_first_frame.clear();
+
+    for (uint32_t i = 1; i <= m_frames.size(); i++) {
+        auto& frame = m_frames[(m_current + i) % m_frames.size()];
+        for (auto& destroy : frame) destroy();
+        frame.clear();
+    }
+}
+
+void DeletionQueue::push(std::function<void()>&& destroy)
+{
+    if (m_current == UINT32_MAX) {
+        m_before_first_frame.push_back(std::move(destroy));
+        return;
+    }
+    m_frames[m_current].push_back(std::move(destroy));
+}
+
+void DeletionQueue::begin_frame(uint32_t frame_index)
+{
+    // The fence of this slot has signaled: everything retired the last time it was
+    // the current slot (and, with queue ordering, during all frames before it) is free.
+    auto& frame = m_frames[frame_index];
+    for (auto& destroy : frame) destroy();
+    frame.clear();
+
+    if (m_current == UINT32_MAX) {
+        // Work recorded while loading is submitted with the first frame.
+        frame = std::move(m_before_first_frame);
+        m_before_first_frame.clear();
+    }
+    m_current = frame_index;
+}
+
+size_t DeletionQueue::pending_count() const
+{
+    size_t count = m_before_first_frame.size();
+    for (const auto& frame : m_frames) count += frame.size();
+    return count;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+// Deferred destruction keyed by the frame in flight.
+// Objects retired while frame N is being prepared are destroyed the next time the fence of
+// N's frame slot has been waited on, i.e. once the GPU cannot use them anymore. Removing
+// an object at runtime then never needs vkDeviceWaitIdle.
+class DeletionQueue {
+public:
+	DeletionQueue() = default;
+	~DeletionQueue();
+
+	void init(uint32_t frames_in_flight);
+	// Runs everything left, the device has to be idle.
+	void flush_all();
+
+	// Everything the function destroys must not be used by commands recorded later on.
+	void push(std::function<void()>&& destroy);
+	// Call right after the fence of `frame_index` has been waited on, before recording the frame.
+	void begin_frame(uint32_t frame_index);
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	size_t pending_count() const;
+
+private:
+	// m_frames[slot] : retired while that frame slot was the current one
+	std::vector<std::vector<std::function<void()>>> m_frames;
+	// Retired before the first frame (loading), they wait for the first frame's fence.
+	std::vector<std::function<void()>> m_before_first_frame;
+	uint32_t m_current = UINT32_MAX;
+};
@@ -0,0 +1,375 @@
+#include "depth_pyramid.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <algorithm>
+
+static const uint32_t PYRAMID_GROUP_SIZE = 8;   // local_size_x / y of depth_pyramid.comp
+
+static inline uint32_t previous_pow2(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value) result *= 2;
+    return result;
+}
+
+DepthPyramid::DepthPyramid(CoreInstance& core, Renderer& renderer) : m_core_instance{ core }, m_renderer{ renderer }
+{
+    size_to(m_renderer.extent());
+    m_extent_generation = m_renderer.extent_generation();
+    create_image();
+    create_pipeline();
+    create_descriptors();
+    create_queries();
+}
+
+DepthPyramid::~DepthPyramid()
+{
+    if (m_builds_timed > 0) {
+        printf("[DepthPyramid] %ux%u %u mips, build %.3f ms on average over %llu frame(s) \n",
+            m_width, m_height, m_mip_count, m_total_build_ms / m_builds_timed, static_cast<unsigned long long>(m_builds_timed));
+    }
+    // Frames in flight may still build or sample the pyramid.
+    release_sized_resources();
+    CoreInstance* core = &m_core_instance;
+    VkShaderModule shader = m_shader;
+    VkDescriptorSetLayout set_layout = m_set_layout;
+    VkPipelineLayout pipeline_layout = m_pipeline_layout;
+    VkPipeline pipeline = m_pipeline;
+    VkQueryPool query_pool = m_query_pool;
+    m_core_instance.deletion_queue().push([core, shader, set_layout, pipeline_layout, pipeline, query_pool]() {
+        VkDevice device = core->get_device();
+        vkDestroyPipeline(device, pipeline, core->allocation_callbacks());
+        vkDestroyPipelineLayout(device, pipeline_layout, core->allocation_callbacks());
+        vkDestroyDescriptorSetLayout(device, set_layout, core->allocation_callbacks());
+        vkDestroyShaderModule(device, shader, core->allocation_callbacks());
+        if (query_pool != VK_NULL_HANDLE) vkDestroyQueryPool(device, query_pool, core->allocation_callbacks());
+    });
+}
+
+void DepthPyramid::release_sized_resources()
+{
+    m_core_instance.resources().destroy(m_image);
+    CoreInstance* core = &m_core_instance;
+    std::vector<VkImageView> mip_views = m_mip_views;
+    VkSampler sampler = m_sampler;
+    VkDescriptorPool descriptor_pool = m_descriptor_pool;
+    m_core_instance.deletion_queue().push([core, mip_views, sampler, descriptor_pool]() {
+        VkDevice device = core->get_device();
+        for (VkImageView view : mip_views) vkDestroyImageView(device, view, core->allocation_callbacks());
+        vkDestroySampler(device, sampler, core->allocation_callbacks());
+        vkDestroyDescriptorPool(device, descriptor_pool, core->allocation_callbacks());
+    });
+    m_mip_views.clear();
+    m_sets.clear();
+}
+
+bool DepthPyramid::update_extent()
+{
+    if (m_extent_generation == m_renderer.extent_generation()) return false;
+    m_extent_generation = m_renderer.extent_generation();
+
+    // Mip 0 reads the new depth buffer, the whole chain follows its size.
+    release_sized_resources();
+    size_to(m_renderer.extent());
+    create_image();
+    create_descriptors();
+    m_initialized = false;
+    printf("[DepthPyramid] resized to %ux%u, %u mips \n", m_width, m_height, m_mip_count);
+    return true;
+}
+
+//----------------------
+//  Creation
+//----------------------
+void DepthPyramid::size_to(VkExtent2D extent)
+{
+    m_width = previous_pow2(extent.width);
+    m_height = previous_pow2(extent.height);
+    m_mip_count = 1;
+    while ((std::max(m_width, m_height) >> m_mip_count) > 0) m_mip_count++;
+}
+
+void DepthPyramid::create_image()
+{
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = VkExtent3D{ m_width, m_height, 1 };
+    imageInfo.mipLevels = m_mip_count;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    m_image = m_core_instance.resources().create_image(imageInfo, MemoryUsage::GPU_ONLY);
+
+    // One view per mip, the storage image written by each step.
+    m_mip_views.resize(m_mip_count);
+    for (uint32_t mip = 0; mip < m_mip_count; mip++) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_core_instance.resources().image(m_image);
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = mip;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_core_instance.get_device(), &viewInfo, m_core_instance.allocation_callbacks(), &m_mip_views[mip]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image view!");
+        }
+    }
+
+    // texelFetch ignores the filter, nearest keeps the sampler valid for any format.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(m_mip_count);
+    if (vkCreateSampler(m_core_instance.get_device(), &samplerInfo, m_core_instance.allocation_callbacks(), &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+}
+
+void DepthPyramid::create_pipeline()
+{
+    auto code = readFile("./src/shaders/depth_pyramid.comp.spv");
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    if (vkCreateShaderModule(m_core_instance.get_device(), &moduleInfo, m_core_instance.allocation_callbacks(), &m_shader) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    VkDescriptorSetLayoutBinding bindings[2]{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(m_core_instance.get_device(), &layoutInfo, m_core_instance.allocation_callbacks(), &m_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstant{};
+    pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstant.offset = 0;
+    pushConstant.size = sizeof(PushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_set_layout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+    if (vkCreatePipelineLayout(m_core_instance.get_device(), &pipelineLayoutInfo, m_core_instance.allocation_callbacks(), &m_pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = m_shader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipeline_layout;
+    if (vkCreateComputePipelines(m_core_instance.get_device(), VK_NULL_HANDLE, 1, &pipelineInfo, m_core_instance.allocation_callbacks(), &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+}
+
+void DepthPyramid::create_descriptors()
+{
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = m_mip_count;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = m_mip_count;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = m_mip_count;
+    if (vkCreateDescriptorPool(m_core_instance.get_device(), &poolInfo, m_core_instance.allocation_callbacks(), &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(m_mip_count, m_set_layout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptor_pool;
+    allocInfo.descriptorSetCount = m_mip_count;
+    allocInfo.pSetLayouts = layouts.data();
+    m_sets.resize(m_mip_count);
+    if (vkAllocateDescriptorSets(m_core_instance.get_device(), &allocInfo, m_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    // Neither the depth nor the pyramid are movable, the sets are written once per extent.
+    for (uint32_t mip = 0; mip < m_mip_count; mip++) {
+        VkDescriptorImageInfo source{};
+        source.sampler = m_sampler;
+        if (mip == 0) {
+            source.imageView = m_core_instance.resources().view(m_renderer.depth_image());
+            source.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        }
+        else {
+            source.imageView = m_mip_views[mip - 1];
+            source.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+        VkDescriptorImageInfo destination{};
+        destination.imageView = m_mip_views[mip];
+        destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = m_sets[mip];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[0].pImageInfo = &source;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = m_sets[mip];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[1].pImageInfo = &destination;
+        vkUpdateDescriptorSets(m_core_instance.get_device(), 2, writes, 0, nullptr);
+    }
+}
+
+void DepthPyramid::create_queries()
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_core_instance.get_physical_device(), &properties);
+    m_frame_timed.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, false);
+    if (!properties.limits.timestampComputeAndGraphics) return;
+    m_timestamp_period = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryInfo{};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+    if (vkCreateQueryPool(m_core_instance.get_device(), &queryInfo, m_core_instance.allocation_callbacks(), &m_query_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create query pool!");
+    }
+}
+
+//----------------------
+//  Build
+//----------------------
+VkImageView DepthPyramid::view() const
+{
+    return m_core_instance.resources().view(m_image);
+}
+
+void DepthPyramid::read_timing(uint32_t frame)
+{
+    // The fence of `frame` has been waited on, its timestamps are written.
+    if (!m_frame_timed[frame]) return;
+    uint64_t timestamps[2] = {};
+    if (vkGetQueryPoolResults(m_core_instance.get_device(), m_query_pool, frame * 2, 2,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        m_last_build_ms = (timestamps[1] - timestamps[0]) * m_timestamp_period / 1.0e6;
+        m_total_build_ms += m_last_build_ms;
+        m_builds_timed++;
+    }
+    m_frame_timed[frame] = false;
+}
+
+void DepthPyramid::build(VkCommandBuffer cmdBuf, uint32_t frame)
+{
+    const bool timed = m_query_pool != VK_NULL_HANDLE;
+    if (timed) {
+        read_timing(frame);
+        vkCmdResetQueryPool(cmdBuf, m_query_pool, frame * 2, 2);
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_query_pool, frame * 2);
+    }
+
+    // Depth writes → sampled, the last culling's reads of the pyramid → writes.
+    VkImageMemoryBarrier barriers[2]{};
+    barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[0].image = m_core_instance.resources().image(m_renderer.depth_image());
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+    barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[1].oldLayout = m_initialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[1].image = m_core_instance.resources().image(m_image);
+    barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mip_count, 0, 1 };
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+    m_initialized = true;
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    VkExtent2D extent = m_renderer.extent();
+    int32_t source_width = static_cast<int32_t>(extent.width);
+    int32_t source_height = static_cast<int32_t>(extent.height);
+    for (uint32_t mip = 0; mip < m_mip_count; mip++) {
+        PushConstants constants{};
+        constants.source_size[0] = source_width;
+        constants.source_size[1] = source_height;
+        constants.destination_size[0] = std::max(static_cast<int32_t>(m_width >> mip), 1);
+        constants.destination_size[1] = std::max(static_cast<int32_t>(m_height >> mip), 1);
+        vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_sets[mip], 0, nullptr);
+        vkCmdPushConstants(cmdBuf, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+        vkCmdDispatch(cmdBuf, (constants.destination_size[0] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+            (constants.destination_size[1] + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+        // The next mip (or the culling) reads this one.
+        VkImageMemoryBarrier mipBarrier{};
+        mipBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        mipBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        mipBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        mipBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        mipBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        mipBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        mipBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        mipBarrier.image = barriers[1].image;
+        mipBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &mipBarrier);
+
+        source_width = constants.destination_size[0];
+        source_height = constants.destination_size[1];
+    }
+
+    // Back to the attachment layout for the next render pass.
+    VkImageMemoryBarrier depthBarrier = barriers[0];
+    depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+    if (timed) {
+        vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pool, frame * 2 + 1);
+        m_frame_timed[frame] = true;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "./core/resource_registry.hpp"
+
+class CoreInstance;
+class Renderer;
+
+// Hierarchical depth (Hi-Z) of the renderer's depth buffer, built in compute
+// (src/shaders/depth_pyramid.comp) for the occlusion culling of FrustumCuller.
+// Mip 0 is the depth extent rounded down to powers of two, every texel holds the farthest
+// depth of its footprint, so a box whose nearest depth is farther than the texels it covers
+// is hidden. The image stays in VK_IMAGE_LAYOUT_GENERAL. The build is timed with timestamp
+// queries, read back once the frame's fence has signaled.
+class DepthPyramid {
+public:
+	DepthPyramid(CoreInstance& core, Renderer& renderer);
+	~DepthPyramid();
+
+	// Outside a render pass, the depth is in the attachment layout before and after.
+	void			build(VkCommandBuffer cmdBuf, uint32_t frame);
+	// After a swap chain recreation (Renderer::extent_generation) : a new image, views and sets
+	// at the new depth extent, the old ones go through the deletion queue. True when rebuilt,
+	// the culling sets sampling view() have to be rewritten then.
+	bool			update_extent();
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	// Whole mip chain, sampled with texelFetch.
+	VkImageView		view() const;
+	inline VkSampler	sampler() const { return m_sampler; }
+	inline uint32_t	width() const { return m_width; }
+	inline uint32_t	height() const { return m_height; }
+	inline uint32_t	mip_count() const { return m_mip_count; }
+	// GPU time of the last build read back, 0 without timestamp support.
+	inline double	last_build_ms() const { return m_last_build_ms; }
+
+private:
+	struct PushConstants {
+		int32_t		source_size[2];
+		int32_t		destination_size[2];
+	};
+
+	CoreInstance&			m_core_instance;
+	Renderer&				m_renderer;
+	uint32_t				m_width = 0;
+	uint32_t				m_height = 0;
+	uint32_t				m_mip_count = 0;
+	uint32_t				m_extent_generation = 0;
+
+	ImageHandle				m_image;
+	std::vector<VkImageView>	m_mip_views;
+	VkSampler				m_sampler = VK_NULL_HANDLE;
+	bool					m_initialized = false;	// out of VK_IMAGE_LAYOUT_UNDEFINED
+
+	VkShaderModule			m_shader = VK_NULL_HANDLE;
+	VkDescriptorSetLayout	m_set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout		m_pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline				m_pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool		m_descriptor_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet>	m_sets;		// per mip : previous mip (or the depth) → mip
+
+	// Two timestamps per frame in flight.
+	VkQueryPool				m_query_pool = VK_NULL_HANDLE;
+	float					m_timestamp_period = 0.0f;	// ns per tick, 0 : not supported
+	std::vector<bool>		m_frame_timed;
+	double					m_last_build_ms = 0.0;
+	double					m_total_build_ms = 0.0;
+	uint64_t				m_builds_timed = 0;
+
+	void			size_to(VkExtent2D extent);
+	void			create_image();
+	// Image, views, sampler and descriptor pool, everything sized after the depth.
+	void			release_sized_resources();
+	void			create_pipeline();
+	void			create_descriptors();
+	void			create_queries();
+	void			read_timing(uint32_t frame);
+};
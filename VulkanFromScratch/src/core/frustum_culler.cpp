@@ -0,0 +1,366 @@
+#include "frustum_culler.hpp"
+#include "core/core_fwd.h"
+#include "core/depth_pyramid.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+static const uint32_t CULL_GROUP_SIZE = 64;     // local_size_x of frustum_cull.comp / occlusion_cull.comp
+static const uint32_t CULL_BINDING_COUNT = 4;   // objects, commands, culled commands, counters
+static const uint32_t OCCLUSION_BINDING_COUNT = 6;  // + visibility, pyramid
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void extract_frustum_planes(const glm::mat4& view_projection, glm::vec4 planes[6])
+{
+    // Gribb / Hartmann : the planes are sums of the rows of the matrix (glm is column major).
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+    }
+    planes[0] = rows[3] + rows[0];
+    planes[1] = rows[3] - rows[0];
+    planes[2] = rows[3] + rows[1];
+    planes[3] = rows[3] - rows[1];
+    planes[4] = rows[2];            // z >= 0
+    planes[5] = rows[3] - rows[2];
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+bool extract_eye_position(const glm::mat4& view_projection, glm::vec3& eye)
+{
+    // The eye is the only point with clip x = y = w = 0.
+    glm::vec4 h = glm::inverse(view_projection) * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+    if (std::fabs(h.w) < 1e-12f) return false;
+    eye = glm::vec3(h) / h.w;
+    return true;
+}
+
+FrustumCuller::FrustumCuller(CoreInstance& core, uint32_t max_objects, VkBuffer input, VkDeviceSize input_frame_size,
+    VkDeviceSize objects_offset, VkDeviceSize commands_offset, DepthPyramid* pyramid)
+    : m_core_instance{ core }, m_max_objects{ max_objects }, m_pyramid{ pyramid }
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_core_instance.get_physical_device(), &properties);
+    if ((static_cast<uint64_t>(max_objects) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE > properties.limits.maxComputeWorkGroupCount[0]) {
+        throw std::runtime_error("failed to create frustum culler, too many objects for one dispatch!");
+    }
+
+    // One counter per batch (a batch per object at worst) after the totals, the late phase
+    // of the occlusion culling has its own commands and counters after the early ones.
+    const VkDeviceSize phases = m_pyramid ? 2 : 1;
+    m_command_frame_size = align_up(sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(max_objects) * phases, 256);
+    m_counter_frame_size = align_up(sizeof(uint32_t) * (COUNTER_HEADER + static_cast<VkDeviceSize>(max_objects) * phases), 256);
+    auto& resources = m_core_instance.resources();
+    m_commands = resources.create_buffer(m_command_frame_size * SwapChain::MAX_FRAMES_IN_FLIGHT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MemoryUsage::GPU_ONLY);
+    m_counters = resources.create_buffer(m_counter_frame_size * SwapChain::MAX_FRAMES_IN_FLIGHT,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GPU_ONLY);
+    m_readback = resources.create_buffer(sizeof(uint32_t) * COUNTER_HEADER * SwapChain::MAX_FRAMES_IN_FLIGHT,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::READBACK);
+    if (m_pyramid) {
+        // Shared by the frames in flight, they run in order on the queue.
+        m_visibility = resources.create_buffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(max_objects),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GPU_ONLY);
+    }
+    m_frame_tested.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+
+    create_pipeline();
+    create_descriptors(input, input_frame_size, objects_offset, commands_offset);
+}
+
+FrustumCuller::~FrustumCuller()
+{
+    if (m_frames > 0) {
+        printf("[Cull] %llu frame(s), %.1f%% of the objects culled on average \n", static_cast<unsigned long long>(m_frames),
+            m_total_tested > 0 ? 100.0 * (m_total_tested - m_total_visible) / m_total_tested : 0.0);
+        if (m_pyramid) {
+            printf("[Cull] %.1f%% of the objects occluded on average \n",
+                m_total_tested > 0 ? 100.0 * m_total_occluded / m_total_tested : 0.0);
+        }
+    }
+    // Frames in flight may still run the dispatch or draw from the output.
+    auto& resources = m_core_instance.resources();
+    resources.destroy(m_commands);
+    resources.destroy(m_counters);
+    resources.destroy(m_readback);
+    if (m_pyramid) resources.destroy(m_visibility);
+    CoreInstance* core = &m_core_instance;
+    VkShaderModule shader = m_shader;
+    VkDescriptorSetLayout set_layout = m_set_layout;
+    VkPipelineLayout pipeline_layout = m_pipeline_layout;
+    VkPipeline pipeline = m_pipeline;
+    VkDescriptorPool descriptor_pool = m_descriptor_pool;
+    m_core_instance.deletion_queue().push([core, shader, set_layout, pipeline_layout, pipeline, descriptor_pool]() {
+        VkDevice device = core->get_device();
+        vkDestroyPipeline(device, pipeline, core->allocation_callbacks());
+        vkDestroyPipelineLayout(device, pipeline_layout, core->allocation_callbacks());
+        vkDestroyDescriptorPool(device, descriptor_pool, core->allocation_callbacks());
+        vkDestroyDescriptorSetLayout(device, set_layout, core->allocation_callbacks());
+        vkDestroyShaderModule(device, shader, core->allocation_callbacks());
+    });
+}
+
+//----------------------
+//  Creation
+//----------------------
+void FrustumCuller::create_pipeline()
+{
+    auto code = readFile(m_pyramid ? "./src/shaders/occlusion_cull.comp.spv" : "./src/shaders/frustum_cull.comp.spv");
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    if (vkCreateShaderModule(m_core_instance.get_device(), &moduleInfo, m_core_instance.allocation_callbacks(), &m_shader) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    const uint32_t binding_count = m_pyramid ? OCCLUSION_BINDING_COUNT : CULL_BINDING_COUNT;
+    VkDescriptorSetLayoutBinding bindings[OCCLUSION_BINDING_COUNT]{};
+    for (uint32_t i = 0; i < binding_count; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    if (m_pyramid) bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = binding_count;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(m_core_instance.get_device(), &layoutInfo, m_core_instance.allocation_callbacks(), &m_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    VkPushConstantRange pushConstant{};
+    pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstant.offset = 0;
+    pushConstant.size = m_pyramid ? sizeof(OcclusionPushConstants) : sizeof(PushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_set_layout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+    if (vkCreatePipelineLayout(m_core_instance.get_device(), &pipelineLayoutInfo, m_core_instance.allocation_callbacks(), &m_pipeline_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = m_shader;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = m_pipeline_layout;
+    if (vkCreateComputePipelines(m_core_instance.get_device(), VK_NULL_HANDLE, 1, &pipelineInfo, m_core_instance.allocation_callbacks(), &m_pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+}
+
+void FrustumCuller::create_descriptors(VkBuffer input, VkDeviceSize input_frame_size, VkDeviceSize objects_offset, VkDeviceSize commands_offset)
+{
+    const uint32_t frame_count = SwapChain::MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSizes[2]{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = (m_pyramid ? CULL_BINDING_COUNT + 1 : CULL_BINDING_COUNT) * frame_count;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = frame_count;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = m_pyramid ? 2 : 1;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frame_count;
+    if (vkCreateDescriptorPool(m_core_instance.get_device(), &poolInfo, m_core_instance.allocation_callbacks(), &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    std::vector<VkDescriptorSetLayout> layouts(frame_count, m_set_layout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptor_pool;
+    allocInfo.descriptorSetCount = frame_count;
+    allocInfo.pSetLayouts = layouts.data();
+    m_sets.resize(frame_count);
+    if (vkAllocateDescriptorSets(m_core_instance.get_device(), &allocInfo, m_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    // The buffers are never moved, the sets are written once. The pyramid is rewritten on resize.
+    auto& resources = m_core_instance.resources();
+    const VkDeviceSize objects_size = sizeof(Object) * static_cast<VkDeviceSize>(m_max_objects);
+    const VkDeviceSize commands_size = sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(m_max_objects);
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        VkDescriptorBufferInfo bufferInfos[CULL_BINDING_COUNT + 1]{};
+        bufferInfos[0] = { input, input_frame_size * frame + objects_offset, objects_size };
+        bufferInfos[1] = { input, input_frame_size * frame + commands_offset, commands_size };
+        bufferInfos[2] = { resources.buffer(m_commands), command_offset(frame), m_command_frame_size };
+        bufferInfos[3] = { resources.buffer(m_counters), m_counter_frame_size * frame, m_counter_frame_size };
+        const uint32_t buffer_count = m_pyramid ? CULL_BINDING_COUNT + 1 : CULL_BINDING_COUNT;
+        if (m_pyramid) {
+            bufferInfos[4] = { resources.buffer(m_visibility), 0, VK_WHOLE_SIZE };
+        }
+
+        VkWriteDescriptorSet writes[CULL_BINDING_COUNT + 1]{};
+        for (uint32_t i = 0; i < buffer_count; i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = m_sets[frame];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(m_core_instance.get_device(), buffer_count, writes, 0, nullptr);
+    }
+    if (m_pyramid) update_pyramid();
+}
+
+void FrustumCuller::update_pyramid()
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = m_pyramid->sampler();
+    imageInfo.imageView = m_pyramid->view();
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    for (VkDescriptorSet set : m_sets) {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = 5;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(m_core_instance.get_device(), 1, &write, 0, nullptr);
+    }
+    // Last frame's visibility was tested against the old depth.
+    m_reset_visibility = true;
+}
+
+//----------------------
+//  Frame
+//----------------------
+VkBuffer FrustumCuller::command_buffer() const
+{
+    return m_core_instance.resources().buffer(m_commands);
+}
+
+VkBuffer FrustumCuller::count_buffer() const
+{
+    return m_core_instance.resources().buffer(m_counters);
+}
+
+void FrustumCuller::read_stats(uint32_t frame)
+{
+    // The fence of `frame` has been waited on, its last dispatch is complete.
+    if (m_frame_tested[frame] == 0) return;
+    const uint32_t* totals = static_cast<const uint32_t*>(m_core_instance.resources().get(m_readback)->allocation.mapped) + COUNTER_HEADER * frame;
+    m_last_stats.tested = m_frame_tested[frame];
+    m_last_stats.visible = totals[0];
+    m_last_stats.occluded = totals[1];
+    m_last_stats.late = totals[2];
+    m_frames++;
+    m_total_tested += m_last_stats.tested;
+    m_total_visible += m_last_stats.visible;
+    m_total_occluded += m_last_stats.occluded;
+    m_frame_tested[frame] = 0;
+}
+
+void FrustumCuller::dispatch(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+    uint32_t object_count, uint32_t batch_count, bool compact, Phase phase)
+{
+    if ((phase == Phase::FRUSTUM) != (m_pyramid == nullptr)) {
+        throw std::runtime_error("failed to cull, the phase does not match the culler!");
+    }
+    VkBuffer counters = count_buffer();
+    const VkDeviceSize counter_offset = m_counter_frame_size * frame;
+    if (phase != Phase::LATE) {
+        read_stats(frame);
+        if (object_count == 0) return;
+
+        // The late phase is recorded after the early one, both are cleared here.
+        const VkDeviceSize counter_size = sizeof(uint32_t) * (COUNTER_HEADER + static_cast<VkDeviceSize>(batch_count));
+        vkCmdFillBuffer(cmdBuf, counters, counter_offset, counter_size, 0);
+        if (phase == Phase::EARLY) {
+            vkCmdFillBuffer(cmdBuf, counters, count_offset(frame, 0, true), sizeof(uint32_t) * static_cast<VkDeviceSize>(batch_count), 0);
+            if (m_reset_visibility) {
+                vkCmdFillBuffer(cmdBuf, m_core_instance.resources().buffer(m_visibility), 0, VK_WHOLE_SIZE, 1);
+                m_reset_visibility = false;
+            }
+        }
+
+        // Also orders the visibility written by the late phase of the previous frame.
+        VkMemoryBarrier clearBarrier{};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+    }
+    else {
+        if (object_count == 0) return;
+        // Visibility and counters of the early phase, the pyramid is synchronized by its build.
+        VkMemoryBarrier earlyBarrier{};
+        earlyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        earlyBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        earlyBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 1, &earlyBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    glm::vec3 eye_position;
+    glm::vec4 eye = extract_eye_position(view_projection, eye_position) ? glm::vec4(eye_position, 1.0f) : glm::vec4(0.0f);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_sets[frame], 0, nullptr);
+    if (phase == Phase::FRUSTUM) {
+        PushConstants constants{};
+        extract_frustum_planes(view_projection, constants.planes);
+        constants.object_count = object_count;
+        constants.eye = eye;
+        constants.compact = compact ? 1 : 0;
+        vkCmdPushConstants(cmdBuf, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+    }
+    else {
+        OcclusionPushConstants constants{};
+        constants.view_projection = view_projection;
+        constants.object_count = object_count;
+        constants.late = phase == Phase::LATE ? 1 : 0;
+        constants.compact = compact ? 1 : 0;
+        constants.late_base = m_max_objects;
+        constants.pyramid_size[0] = static_cast<float>(m_pyramid->width());
+        constants.pyramid_size[1] = static_cast<float>(m_pyramid->height());
+        constants.mip_count = m_pyramid->mip_count();
+        constants.eye = eye;
+        vkCmdPushConstants(cmdBuf, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionPushConstants), &constants);
+    }
+    vkCmdDispatch(cmdBuf, (object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+    // Commands and counts are read by the draws, the totals by the readback copy.
+    VkMemoryBarrier cullBarrier{};
+    cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+    if (phase == Phase::EARLY) return;      // the totals are complete after the late phase
+
+    VkBufferCopy copy{};
+    copy.srcOffset = counter_offset;
+    copy.dstOffset = sizeof(uint32_t) * COUNTER_HEADER * frame;
+    copy.size = sizeof(uint32_t) * COUNTER_HEADER;
+    vkCmdCopyBuffer(cmdBuf, counters, m_core_instance.resources().buffer(m_readback), 1, &copy);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+    m_frame_tested[frame] = object_count;
+}
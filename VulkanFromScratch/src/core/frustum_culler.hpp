@@ -0,0 +1,144 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "./core/resource_registry.hpp"
+
+class CoreInstance;
+class DepthPyramid;
+
+// Planes of the frustum of `view_projection` (Vulkan clip space, depth in [0, 1]):
+// xyz the normal pointing inside, w the distance. left, right, bottom, top, near, far.
+void extract_frustum_planes(const glm::mat4& view_projection, glm::vec4 planes[6]);
+// Camera position of a perspective `view_projection`, false for an orthographic one.
+bool extract_eye_position(const glm::mat4& view_projection, glm::vec3& eye);
+
+// Frustum culling of indirect draws in a compute pass (src/shaders/frustum_cull.comp).
+// Every object is a bounding sphere, an optional normal cone (see Meshlet) and the source
+// command it draws. Visible commands are
+// appended to their batch's range of the output buffer with an atomic counter per batch,
+// the counters being the count buffer of vkCmdDrawIndexedIndirectCount: the CPU never
+// touches a command, whatever the number of objects. Without the count extension the
+// commands stay in place and the culled ones get instanceCount 0.
+// Buffers are per frame in flight, the counts are read back once the frame's fence has
+// signaled (a frame in flight late).
+// With a DepthPyramid the culling is two phase (src/shaders/occlusion_cull.comp): the early
+// phase draws what was visible last frame, the late one tests everything against the pyramid
+// built from those draws and draws what just became visible. The per object visibility
+// lives on the GPU, shared by the frames in flight.
+class FrustumCuller {
+public:
+	// Matches CullObject of cull_common.glsl.
+	struct Object {
+		glm::vec4	sphere{ 0.0f };		// xyz center, w radius
+		glm::vec4	cone{ 0.0f, 0.0f, 1.0f, NO_CONE };	// xyz axis, w cutoff
+		glm::vec4	cone_apex{ 0.0f };	// xyz
+		uint32_t	command = 0;
+		uint32_t	batch = 0;
+		uint32_t	batch_first = 0;
+		uint32_t	pad = 0;
+	};
+	// Cutoff of the objects without a cone, they are never back facing.
+	static constexpr float NO_CONE = 2.0f;
+	// The objects and the source commands are read from `input`, at the given offsets
+	// plus `input_frame_size` per frame. `pyramid` enables the occlusion culling.
+	FrustumCuller(CoreInstance& core, uint32_t max_objects, VkBuffer input, VkDeviceSize input_frame_size,
+		VkDeviceSize objects_offset, VkDeviceSize commands_offset, DepthPyramid* pyramid = nullptr);
+	~FrustumCuller();
+
+	enum class Phase {
+		FRUSTUM,	// without pyramid
+		EARLY,		// with pyramid, before the pyramid is built
+		LATE,		// with pyramid, after
+	};
+	// Outside a render pass. The output is ready for the draws recorded after it.
+	void			dispatch(VkCommandBuffer cmdBuf, uint32_t frame, const glm::mat4& view_projection,
+						uint32_t object_count, uint32_t batch_count, bool compact, Phase phase = Phase::FRUSTUM);
+	// Everything is drawn by the next early phase, e.g. when the objects were reordered.
+	inline void		reset_visibility() { m_reset_visibility = true; }
+	inline bool		has_occlusion() const { return m_pyramid != nullptr; }
+	// Points the sets at the pyramid's current view, after DepthPyramid::update_extent.
+	// Not while a frame in flight uses them (the swap chain recreation waits for the device).
+	void			update_pyramid();
+
+	//--------------------
+	//  Output
+	//--------------------
+	// The late phase has its own commands and counts.
+	VkBuffer		command_buffer() const;
+	VkDeviceSize	command_offset(uint32_t frame, bool late = false) const {
+		return m_command_frame_size * frame + (late ? sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(m_max_objects) : 0);
+	}
+	VkBuffer		count_buffer() const;
+	// Count of batch `batch`, after the totals.
+	VkDeviceSize	count_offset(uint32_t frame, uint32_t batch, bool late = false) const {
+		return m_counter_frame_size * frame + sizeof(uint32_t) *
+			(COUNTER_HEADER + static_cast<VkDeviceSize>(batch) + (late ? m_max_objects : 0));
+	}
+
+	//--------------------
+	//  Statistics
+	//--------------------
+	struct Stats {
+		uint32_t	tested = 0;
+		uint32_t	visible = 0;
+		uint32_t	occluded = 0;	// in the frustum but hidden by the pyramid
+		uint32_t	late = 0;		// drawn by the late phase
+	};
+	// Last frame read back, MAX_FRAMES_IN_FLIGHT behind the one recorded.
+	inline const Stats& last_stats() const { return m_last_stats; }
+
+private:
+	struct PushConstants {
+		glm::vec4	planes[6];
+		glm::vec4	eye;				// xyz camera position, w 0 : no cone test
+		uint32_t	object_count;
+		uint32_t	compact;
+		uint32_t	pad[2];
+	};
+	struct OcclusionPushConstants {
+		glm::mat4	view_projection;
+		uint32_t	object_count;
+		uint32_t	late;
+		uint32_t	compact;
+		uint32_t	late_base;
+		float		pyramid_size[2];
+		uint32_t	mip_count;
+		uint32_t	pad;
+		glm::vec4	eye;
+	};
+	// visible, occluded, late, pad : the Counters block of cull_common.glsl.
+	static const uint32_t COUNTER_HEADER = 4;
+
+	CoreInstance&			m_core_instance;
+	uint32_t				m_max_objects = 0;
+	DepthPyramid*			m_pyramid = nullptr;
+
+	VkShaderModule			m_shader = VK_NULL_HANDLE;
+	VkDescriptorSetLayout	m_set_layout = VK_NULL_HANDLE;
+	VkPipelineLayout		m_pipeline_layout = VK_NULL_HANDLE;
+	VkPipeline				m_pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool		m_descriptor_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet>	m_sets;		// per frame
+
+	BufferHandle			m_commands;			// GPU_ONLY, culled commands
+	BufferHandle			m_counters;			// GPU_ONLY, [ totals | batch counts | late batch counts ]
+	BufferHandle			m_readback;			// READBACK, totals copied after the dispatch
+	BufferHandle			m_visibility;		// GPU_ONLY, one uint per object, occlusion only
+	bool					m_reset_visibility = true;
+	VkDeviceSize			m_command_frame_size = 0;
+	VkDeviceSize			m_counter_frame_size = 0;
+
+	// Tested count of the dispatch recorded in each frame, matched with its readback.
+	std::vector<uint32_t>	m_frame_tested;
+	Stats					m_last_stats;
+	uint64_t				m_frames = 0;
+	uint64_t				m_total_tested = 0;
+	uint64_t				m_total_visible = 0;
+	uint64_t				m_total_occluded = 0;
+
+	void			create_pipeline();
+	void			create_descriptors(VkBuffer input, VkDeviceSize input_frame_size, VkDeviceSize objects_offset, VkDeviceSize commands_offset);
+	void			read_stats(uint32_t frame);
+};
@@ -7,19 +7,66 @@ void GameObject::add_component(Component* comp)
 
 std::vector<VkDescriptorSetLayout>* GameObject::get_all_descriptorLayouts()
 {	
-	for (int i = 0; i < m_components.size();++i) {
+	for (size_t i = 0; i < m_components.size();++i) {
 		auto descrip = m_components[i]->get_descriptorset_layout();
 		if (descrip != NULL) {
 			m_descriptorSetLayouts.push_back(descrip);
 		}
 	}
+	// The culled components bind their sets with the same pipeline layout.
+	for (size_t i = 0; i < m_culled_components.size(); ++i) {
+		auto descrip = m_culled_components[i]->get_descriptorset_layout();
+		if (descrip != NULL) {
+			m_descriptorSetLayouts.push_back(descrip);
+		}
+	}
 
 	return &m_descriptorSetLayouts;
 }
 
+void GameObject::execute_before_frame(FrameUpdateData& frame_data)
+{
+	for (size_t i = 0; i < m_components.size(); ++i) {
+		m_components[i]->update_before_frame(frame_data);
+	}
+	// Culling only skips the draws recorded by update().
+	for (size_t i = 0; i < m_culled_components.size(); ++i) {
+		m_culled_components[i]->update_before_frame(frame_data);
+	}
+}
+
+uint32_t GameObject::add_culled_component(Component* comp, const glm::vec4& bounding_sphere)
+{
+	m_culled_components.emplace_back(comp);
+	return m_culler.add(bounding_sphere);
+}
+
+void GameObject::set_bounds(uint32_t id, const glm::vec4& bounding_sphere)
+{
+	m_culler.set_sphere(id, bounding_sphere);
+}
+
+void GameObject::set_view_projection(const glm::mat4& view_projection)
+{
+	m_view_projection = view_projection;
+	m_culling = true;
+}
+
 void GameObject::execute(FrameUpdateData& frame_data)
 {
-	for (int i = 0; i < m_components.size(); ++i) {
+	for (size_t i = 0; i < m_components.size(); ++i) {
 		m_components[i]->update(frame_data);
 	}
+	if (!m_culling) {
+		for (size_t i = 0; i < m_culled_components.size(); ++i) {
+			m_culled_components[i]->update(frame_data);
+		}
+		return;
+	}
+	// Only the visible ones are visited, the list is compact.
+	uint32_t visible_count = m_culler.cull(m_view_projection);
+	const uint32_t* visible = m_culler.visible();
+	for (uint32_t i = 0; i < visible_count; ++i) {
+		m_culled_components[visible[i]]->update(frame_data);
+	}
 }
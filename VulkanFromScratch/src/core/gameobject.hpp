@@ -3,11 +3,21 @@
 //#include "core/component.hpp"
 #include <vector>
 #include <vulkan/vulkan.h>
+#include <glm.hpp>
+#include "core/simd_culler.hpp"
 class GameObject
 {
 public:
 	std::vector<Component*> m_components;
 	void add_component(Component* comp);
+	// Updated after the other components and only while its sphere (xyz center, w radius,
+	// in the space of the view projection) is inside the frustum. Returns the id for set_bounds().
+	uint32_t add_culled_component(Component* comp, const glm::vec4& bounding_sphere);
+	void set_bounds(uint32_t id, const glm::vec4& bounding_sphere);
+	// Culling starts with the first call, every culled component is updated before that.
+	void set_view_projection(const glm::mat4& view_projection);
+	inline SimdCuller& culler() { return m_culler; }
+	// Set layouts of the components, then of the culled components.
 	std::vector<VkDescriptorSetLayout>* get_all_descriptorLayouts();
 	std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
 
@@ -17,5 +27,8 @@ public:
 	void execute_before_frame(FrameUpdateData& frame_data);
 	void execute_after_frame(FrameUpdateData& frame_data);
 private:
-
+	std::vector<Component*> m_culled_components;	// indexed by SimdCuller id
+	SimdCuller m_culler;
+	glm::mat4 m_view_projection{ 1.0f };
+	bool m_culling = false;
 };
@@ -0,0 +1,289 @@
+#include "geometry_pool.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+
+static const VkBufferUsageFlags VERTEX_POOL_USAGE =
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+static const VkBufferUsageFlags INDEX_POOL_USAGE =
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+//----------------------
+//  RangeAllocator
+//----------------------
+void GeometryPool::RangeAllocator::init(VkDeviceSize capacity)
+{
+    m_free.clear();
+    m_free[0] = capacity;
+    m_capacity = capacity;
+    m_used = 0;
+}
+
+bool GeometryPool::RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        VkDeviceSize aligned = (it->first + alignment - 1) / alignment * alignment;
+        VkDeviceSize end = it->first + it->second;
+        if (aligned + size > end) continue;
+
+        // Keep the head lost to the alignment and the tail as free ranges.
+        VkDeviceSize begin = it->first;
+        m_free.erase(it);
+        if (aligned > begin) m_free[begin] = aligned - begin;
+        if (aligned + size < end) m_free[aligned + size] = end - (aligned + size);
+        m_used += size;
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void GeometryPool::RangeAllocator::release(VkDeviceSize offset, VkDeviceSize size)
+{
+    m_used -= size;
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    m_free[offset] = size;
+}
+
+void GeometryPool::RangeAllocator::grow(VkDeviceSize capacity)
+{
+    if (capacity <= m_capacity) return;
+    VkDeviceSize added = capacity - m_capacity;
+    VkDeviceSize end = m_capacity;
+    m_capacity = capacity;
+    // Counted as used first, release() merges it with a free tail.
+    m_used += added;
+    release(end, added);
+}
+
+VkDeviceSize GeometryPool::RangeAllocator::largest_free() const
+{
+    VkDeviceSize largest = 0;
+    for (const auto& range : m_free) largest = std::max(largest, range.second);
+    return largest;
+}
+
+//----------------------
+//  GeometryPool
+//----------------------
+GeometryPool::~GeometryPool()
+{
+    cleanup();
+}
+
+void GeometryPool::init(CoreInstance& core_instance, VkDeviceSize vertex_capacity, VkDeviceSize index_capacity)
+{
+    m_core_instance = &core_instance;
+    m_vertices.ranges.init(vertex_capacity);
+    for (auto& arena : m_indices) arena.ranges.init(index_capacity);
+}
+
+void GeometryPool::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    print_stats();
+    // Ranges still freed after this (deletion queue) find no pool and are dropped.
+    auto& resources = m_core_instance->resources();
+    resources.destroy(m_vertices.buffer);
+    m_vertices = {};
+    for (auto& arena : m_indices) {
+        resources.destroy(arena.buffer);
+        arena = {};
+    }
+    m_bound_cmd = VK_NULL_HANDLE;
+    m_core_instance = nullptr;
+}
+
+GeometryPool::Arena& GeometryPool::index_arena(uint32_t index_size)
+{
+    switch (index_size) {
+    case 1: return m_indices[0];
+    case 2: return m_indices[1];
+    case 4: return m_indices[2];
+    }
+    throw std::runtime_error("failed to find index arena, invalid index size!");
+}
+
+VkDeviceSize GeometryPool::upload(Arena& arena, VkBufferUsageFlags usage, const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = 0;
+    if (!arena.ranges.allocate(size, alignment, offset)) {
+        grow(arena, usage, size + alignment, &arena == &m_vertices ? "vertices" : "indices");
+        if (!arena.ranges.allocate(size, alignment, offset)) {
+            throw std::runtime_error("failed to allocate geometry, pool is full!");
+        }
+    }
+    // Draws look the buffer up when they are recorded, the defragmenter is free to move it.
+    // It is held back while one of its uploads is still pending.
+    auto& resources = m_core_instance->resources();
+    if (arena.buffer.is_null()) {
+        arena.buffer = resources.create_buffer(arena.ranges.capacity(), usage, MemoryUsage::GPU_ONLY);
+        resources.make_movable(arena.buffer, 0);
+    }
+    uint64_t ticket = m_core_instance->staging_ring().upload_buffer(resources.buffer(arena.buffer), offset, data, size);
+    resources.set_ready_ticket(arena.buffer, ticket);
+    arena.last_ticket = ticket;
+    arena.range_count++;
+    return offset;
+}
+
+void GeometryPool::grow(Arena& arena, VkBufferUsageFlags usage, VkDeviceSize size, const char* name)
+{
+    VkDeviceSize capacity = std::max(arena.ranges.capacity(), static_cast<VkDeviceSize>(1));
+    while (capacity < arena.ranges.capacity() + size) capacity *= 2;
+
+    // Not created yet, it is simply created at the new size.
+    if (arena.buffer.is_null()) {
+        arena.ranges.grow(capacity);
+        return;
+    }
+
+    // The copy reads what the pending uploads wrote. With a dedicated transfer queue, flush()
+    // also records the ownership acquire into CoreInstance::immediate(), ahead of the copy.
+    auto& staging = m_core_instance->staging_ring();
+    staging.flush();
+    staging.wait(arena.last_ticket);
+
+    auto& resources = m_core_instance->resources();
+    BufferHandle grown = resources.create_buffer(capacity, usage, MemoryUsage::GPU_ONLY);
+
+    ImmediateContext& immediate = m_core_instance->immediate();
+    VkCommandBuffer cmd = immediate.record();
+    // Previous frames may still be reading the source.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+    VkBufferCopy region{};
+    region.size = arena.ranges.capacity();
+    vkCmdCopyBuffer(cmd, resources.buffer(arena.buffer), resources.buffer(grown), 1, &region);
+    // Uploads into the free space may go through another queue, they must not race the copy.
+    uint64_t ticket = immediate.current_ticket();
+    immediate.wait(ticket);
+
+    // Frames in flight still draw from the old buffer, the registry destroys it once they are done.
+    resources.destroy(arena.buffer);
+    arena.buffer = grown;
+    resources.make_movable(arena.buffer, ticket);
+    arena.ranges.grow(capacity);
+    // Command buffers recorded from now on bind the new buffer.
+    m_bound_cmd = VK_NULL_HANDLE;
+    printf("[GeometryPool] %s grown to %.2f MB \n", name, capacity / (1024.0 * 1024.0));
+}
+
+GeometryRange GeometryPool::allocate(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride,
+    const void* indices, uint32_t index_count, uint32_t index_size)
+{
+    // Same fallback as for a dedicated index buffer, meshes this small widen in no time.
+    std::vector<uint16_t> widened;
+    if (index_size == 1 && !m_core_instance->has_index_type_uint8()) {
+        widened.resize(index_count);
+        convert_indices(indices, 1, widened.data(), sizeof(uint16_t), index_count);
+        indices = widened.data();
+        index_size = sizeof(uint16_t);
+    }
+
+    GeometryRange range;
+    range.vertex_count = vertex_count;
+    range.vertex_stride = vertex_stride;
+    range.index_count = index_count;
+    range.index_size = index_size;
+    range.index_type = index_type_of(index_size);
+
+    // Aligned to the stride, vertexOffset is counted in vertices.
+    VkDeviceSize vertex_offset = upload(m_vertices, VERTEX_POOL_USAGE,
+        vertices, static_cast<VkDeviceSize>(vertex_count) * vertex_stride, vertex_stride);
+    VkDeviceSize index_offset = 0;
+    try {
+        index_offset = upload(index_arena(index_size), INDEX_POOL_USAGE,
+            indices, static_cast<VkDeviceSize>(index_count) * index_size, index_size);
+    }
+    catch (...) {
+        // The vertices are uploaded but nothing refers to them, their range goes back at once.
+        m_vertices.ranges.release(vertex_offset, static_cast<VkDeviceSize>(vertex_count) * vertex_stride);
+        m_vertices.range_count--;
+        throw;
+    }
+    range.vertex_offset = static_cast<int32_t>(vertex_offset / vertex_stride);
+    range.first_index = static_cast<uint32_t>(index_offset / index_size);
+    return range;
+}
+
+void GeometryPool::free(GeometryRange& range)
+{
+    if (!range.is_valid()) return;
+    GeometryPool* pool = this;
+    GeometryRange retired = range;
+    m_core_instance->deletion_queue().push([pool, retired]() {
+        pool->release(retired);
+    });
+    range = {};
+}
+
+void GeometryPool::release(const GeometryRange& range)
+{
+    if (m_core_instance == nullptr) return;
+    m_vertices.ranges.release(static_cast<VkDeviceSize>(range.vertex_offset) * range.vertex_stride,
+        static_cast<VkDeviceSize>(range.vertex_count) * range.vertex_stride);
+    m_vertices.range_count--;
+    Arena& indices = index_arena(range.index_size);
+    indices.ranges.release(static_cast<VkDeviceSize>(range.first_index) * range.index_size,
+        static_cast<VkDeviceSize>(range.index_count) * range.index_size);
+    indices.range_count--;
+}
+
+//----------------------
+//  Binding
+//----------------------
+void GeometryPool::bind_vertex_buffer(VkCommandBuffer cmdBuf)
+{
+    // A new recording starts without any bound buffer.
+    m_bound_cmd = cmdBuf;
+    m_bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+    if (m_vertices.buffer.is_null()) return;
+
+    VkBuffer vertexBuffers[] = { m_core_instance->resources().buffer(m_vertices.buffer) };
+    VkDeviceSize offsets[] = { 0 };
+    vkCmdBindVertexBuffers(cmdBuf, 0, 1, vertexBuffers, offsets);
+}
+
+void GeometryPool::bind_index_buffer(VkCommandBuffer cmdBuf, VkIndexType index_type)
+{
+    if (cmdBuf != m_bound_cmd) {
+        bind_vertex_buffer(cmdBuf);
+    }
+    if (index_type == m_bound_index_type) return;
+
+    uint32_t index_size = index_type == VK_INDEX_TYPE_UINT8_EXT ? 1 : index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4;
+    vkCmdBindIndexBuffer(cmdBuf, m_core_instance->resources().buffer(index_arena(index_size).buffer), 0, index_type);
+    m_bound_index_type = index_type;
+}
+
+void GeometryPool::print_stats() const
+{
+    const char* names[INDEX_ARENA_COUNT] = { "u8", "u16", "u32" };
+    printf("[GeometryPool] vertices : %u range(s) %.2f / %.2f MB (largest free %.2f MB) \n",
+        m_vertices.range_count, m_vertices.ranges.used_bytes() / (1024.0 * 1024.0),
+        m_vertices.ranges.capacity() / (1024.0 * 1024.0), m_vertices.ranges.largest_free() / (1024.0 * 1024.0));
+    for (uint32_t i = 0; i < INDEX_ARENA_COUNT; i++) {
+        if (m_indices[i].buffer.is_null()) continue;
+        printf("[GeometryPool] %s indices : %u range(s) %.2f / %.2f MB \n", names[i],
+            m_indices[i].range_count, m_indices[i].ranges.used_bytes() / (1024.0 * 1024.0),
+            m_indices[i].ranges.capacity() / (1024.0 * 1024.0));
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <map>
+#include <cstdint>
+#include "./core/resource_registry.hpp"
+
+class CoreInstance;
+
+// Where a mesh lives inside the GeometryPool buffers, ready for vkCmdDrawIndexed.
+struct GeometryRange {
+	int32_t			vertex_offset = 0;		// in vertices of `vertex_stride`
+	uint32_t		vertex_count = 0;
+	uint32_t		first_index = 0;		// in indices of `index_type`
+	uint32_t		index_count = 0;
+	VkIndexType		index_type = VK_INDEX_TYPE_UINT32;
+	uint32_t		vertex_stride = 0;
+	uint32_t		index_size = 0;
+
+	inline bool is_valid() const { return index_count != 0; }
+};
+
+// Shared device local vertex / index buffers, sub allocated per mesh.
+// Every mesh is an (offset, count) range of the same buffers, so they are bound once per
+// command buffer and draws only differ by vertexOffset / firstIndex. Vertices of any
+// stride share one buffer (ranges are aligned to their stride), indices get one buffer
+// per width since vkCmdBindIndexBuffer fixes the type. A buffer that runs out of space is
+// replaced by one twice as large, the ranges keep their offsets.
+class GeometryPool {
+public:
+	GeometryPool() = default;
+	~GeometryPool();
+
+	// Initial capacities, in bytes.
+	void init(CoreInstance& core_instance, VkDeviceSize vertex_capacity, VkDeviceSize index_capacity);
+	void cleanup();
+
+	//--------------------
+	//  Allocation
+	//--------------------
+	// Copies the data into the pool through the staging ring. `index_size` is 1, 2 or 4 bytes,
+	// 8 bit indices are widened when VK_EXT_index_type_uint8 is not enabled.
+	GeometryRange	allocate(const void* vertices, uint32_t vertex_count, uint32_t vertex_stride,
+						const void* indices, uint32_t index_count, uint32_t index_size);
+	// The range goes back to the pool through the deletion queue, frames in flight may still draw it.
+	void			free(GeometryRange& range);
+
+	//--------------------
+	//  Binding
+	//--------------------
+	// Binds the vertex buffer, once per command buffer (Renderer::bind).
+	void			bind_vertex_buffer(VkCommandBuffer cmdBuf);
+	// Binds the index buffer of `index_type`, skipped when it already is the bound one.
+	void			bind_index_buffer(VkCommandBuffer cmdBuf, VkIndexType index_type);
+
+	void			print_stats() const;
+
+private:
+	// First fit over the free ranges of a buffer, neighbours are merged on release.
+	class RangeAllocator {
+	public:
+		void			init(VkDeviceSize capacity);
+		bool			allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+		void			release(VkDeviceSize offset, VkDeviceSize size);
+		// The new space at the end is free.
+		void			grow(VkDeviceSize capacity);
+		VkDeviceSize	largest_free() const;
+		inline VkDeviceSize capacity() const { return m_capacity; }
+		inline VkDeviceSize used_bytes() const { return m_used; }
+	private:
+		std::map<VkDeviceSize, VkDeviceSize>	m_free;		// offset → size
+		VkDeviceSize							m_capacity = 0;
+		VkDeviceSize							m_used = 0;
+	};
+	struct Arena {
+		BufferHandle	buffer;				// created on first use
+		RangeAllocator	ranges;
+		uint32_t		range_count = 0;
+		uint64_t		last_ticket = 0;	// StagingRing ticket of the last upload
+	};
+	static const uint32_t INDEX_ARENA_COUNT = 3;	// uint8, uint16, uint32
+
+	CoreInstance*	m_core_instance = nullptr;
+	Arena			m_vertices;
+	Arena			m_indices[INDEX_ARENA_COUNT];
+
+	// What the last bind_* calls recorded into m_bound_cmd.
+	VkCommandBuffer	m_bound_cmd = VK_NULL_HANDLE;
+	VkIndexType		m_bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+
+	Arena&			index_arena(uint32_t index_size);
+	VkDeviceSize	upload(Arena& arena, VkBufferUsageFlags usage, const void* data, VkDeviceSize size, VkDeviceSize alignment);
+	// Copies the buffer into a larger one that fits `size` more bytes, blocks until the copy is done.
+	void			grow(Arena& arena, VkBufferUsageFlags usage, VkDeviceSize size, const char* name);
+	void			release(const GeometryRange& range);
+};
@@ -0,0 +1,77 @@
+#include "hlod_switcher.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <cstdio>
+#include <cfloat>
+
+HlodSwitcher::~HlodSwitcher()
+{
+    if (m_frames > 0) {
+        printf("[HLOD] %llu frame(s), %zu cluster(s), %.1f draw(s) saved by the proxies on average \n",
+            static_cast<unsigned long long>(m_frames), m_clusters.size(), static_cast<double>(m_total_saved_draws) / m_frames);
+    }
+}
+
+uint32_t HlodSwitcher::add(uint32_t proxy, const std::vector<uint32_t>& members, float distance, const std::vector<IndirectDraw>& draws)
+{
+    if (members.empty()) {
+        throw std::runtime_error("failed to add hlod cluster, no member draw!");
+    }
+    Cluster cluster;
+    cluster.proxy = proxy;
+    cluster.members = members;
+    cluster.distance = distance;
+    // Bounds of the members as they are now, static draws are not expected to move.
+    std::vector<glm::vec4> spheres;
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    for (uint32_t member : members) {
+        if (member >= draws.size() || member == proxy || draws[member].proxy) {
+            throw std::runtime_error("failed to add hlod cluster, invalid member draw!");
+        }
+        const IndirectDraw& draw = draws[member];
+        spheres.push_back(world_sphere(draw, draw.model->bounding_sphere()));
+        lo = glm::min(lo, glm::vec3(spheres.back()) - glm::vec3(spheres.back().w));
+        hi = glm::max(hi, glm::vec3(spheres.back()) + glm::vec3(spheres.back().w));
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for (const glm::vec4& sphere : spheres) radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+    cluster.sphere = glm::vec4(center, radius);
+
+    m_clusters.push_back(std::move(cluster));
+    return static_cast<uint32_t>(m_clusters.size() - 1);
+}
+
+void HlodSwitcher::clear()
+{
+    m_clusters.clear();
+    m_stats = Stats();
+}
+
+void HlodSwitcher::select(const glm::mat4& view_projection, const std::function<void(uint32_t, bool)>& set_hidden)
+{
+    glm::vec3 eye;
+    const bool has_eye = extract_eye_position(view_projection, eye);
+
+    m_stats = Stats();
+    for (Cluster& cluster : m_clusters) {
+        float distance = has_eye ? glm::length(eye - glm::vec3(cluster.sphere)) - cluster.sphere.w : 0.0f;
+        bool far = distance > cluster.distance * (cluster.far ? 1.0f - HYSTERESIS : 1.0f);
+        if (far != cluster.far) {
+            cluster.far = far;
+            set_hidden(cluster.proxy, !far);
+            for (uint32_t member : cluster.members) set_hidden(member, far);
+            m_stats.switches++;
+        }
+        if (far) {
+            m_stats.proxies++;
+            m_stats.hidden_draws += static_cast<uint32_t>(cluster.members.size());
+        }
+    }
+}
+
+void HlodSwitcher::count_frame()
+{
+    m_frames++;
+    m_total_saved_draws += m_stats.hidden_draws - m_stats.proxies;
+}
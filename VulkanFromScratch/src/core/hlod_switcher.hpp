@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <glm.hpp>
+#include "core/indirect_draw.hpp"
+
+// HLOD clusters of IndirectDrawList (see IndirectDrawList::add_hlod).
+// A cluster shows its proxy draw instead of its member draws while the camera is farther
+// than its distance from the members' bounds. Draws are only hidden / shown, the list
+// keeps their commands.
+class HlodSwitcher {
+public:
+	HlodSwitcher() = default;
+	~HlodSwitcher();
+
+	// `proxy` and `members` are ids in `draws`. A draw belongs to one cluster at most.
+	// Returns the cluster id.
+	uint32_t		add(uint32_t proxy, const std::vector<uint32_t>& members, float distance, const std::vector<IndirectDraw>& draws);
+	void			clear();
+	inline bool		empty() const { return m_clusters.empty(); }
+	inline uint32_t	cluster_count() const { return static_cast<uint32_t>(m_clusters.size()); }
+
+	// Clusters whose side of the distance changed call `set_hidden(draw, hidden)` for their
+	// proxy and members. Without a camera position (orthographic) every cluster keeps its members.
+	void			select(const glm::mat4& view_projection, const std::function<void(uint32_t, bool)>& set_hidden);
+	// Adds the last selection to the average printed at destruction, once per recorded frame.
+	void			count_frame();
+
+	struct Stats {
+		uint32_t	proxies = 0;			// clusters drawn as their proxy
+		uint32_t	hidden_draws = 0;		// members replaced by them
+		uint32_t	switches = 0;
+	};
+	// Last selection
+	inline const Stats& stats() const { return m_stats; }
+	// Back to the members under `distance * (1 - HYSTERESIS)` only.
+	static constexpr float HYSTERESIS = 0.1f;
+
+private:
+	struct Cluster {
+		uint32_t				proxy = 0;		// draw id
+		std::vector<uint32_t>	members;
+		glm::vec4				sphere{ 0.0f };	// world bounds of the members
+		float					distance = 0.0f;
+		bool					far = false;	// the proxy is drawn
+	};
+
+	std::vector<Cluster>	m_clusters;
+	Stats					m_stats;
+	uint64_t				m_frames = 0;
+	uint64_t				m_total_saved_draws = 0;
+};
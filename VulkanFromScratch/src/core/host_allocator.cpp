@@ -0,0 +1,265 @@
+#include "host_allocator.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+//----------------------
+//  Other function
+//----------------------
+namespace {
+
+struct CommandArena;
+
+// Stored right in front of every pointer handed to the driver.
+struct AllocationHeader {
+    void*           base;   // what malloc returned, nullptr for arena allocations
+    CommandArena*   arena;  // arena the allocation came from, nullptr for heap allocations
+    size_t          size;
+    uint32_t        scope;
+};
+constexpr size_t HEADER_SIZE = (sizeof(AllocationHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+inline size_t align_up(size_t v, size_t alignment) { return (v + alignment - 1) & ~(alignment - 1); }
+
+inline AllocationHeader* header_of(void* memory) {
+    return reinterpret_cast<AllocationHeader*>(static_cast<char*>(memory) - HEADER_SIZE);
+}
+
+// Bump allocator for VK_SYSTEM_ALLOCATION_SCOPE_COMMAND. Those allocations are freed before
+// the Vulkan call that made them returns, so the arena rewinds every time it becomes empty.
+// Chunks that were added while it was in use are merged into one bigger chunk at that point.
+// The free may come from another thread than the allocation (the header keeps the arena),
+// the lock is uncontended in the common case.
+struct CommandArena {
+    std::mutex  mutex;
+    std::vector<std::pair<char*, size_t>> chunks;   // back() is the current chunk
+    size_t      head = 0;
+    uint32_t    live = 0;
+
+    static constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+    ~CommandArena() {
+        for (auto& chunk : chunks) std::free(chunk.first);
+    }
+
+    void* allocate(size_t size, size_t alignment) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (chunks.empty() || offset_in_current(alignment) + size > chunks.back().second) {
+            size_t chunk_size = std::max(MIN_CHUNK_SIZE, HEADER_SIZE + size + alignment);
+            if (!chunks.empty()) chunk_size = std::max(chunk_size, chunks.back().second * 2);
+            char* chunk = static_cast<char*>(std::malloc(chunk_size));
+            if (chunk == nullptr) return nullptr;
+            chunks.emplace_back(chunk, chunk_size);
+            head = 0;
+        }
+        size_t offset = offset_in_current(alignment);
+        head = offset + size;
+        live++;
+        return chunks.back().first + offset;
+    }
+
+    // Offset of the next allocation with room for its header, the alignment is applied to the address.
+    size_t offset_in_current(size_t alignment) const {
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunks.back().first);
+        return align_up(base + head + HEADER_SIZE, alignment) - base;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--live > 0) return;
+        // Empty : keep the biggest (last) chunk only and start over.
+        for (size_t i = 0; i + 1 < chunks.size(); i++) std::free(chunks[i].first);
+        if (chunks.size() > 1) chunks.erase(chunks.begin(), chunks.end() - 1);
+        head = 0;
+    }
+};
+
+thread_local CommandArena t_command_arena;
+
+}
+
+//----------------------
+//  HostAllocator
+//----------------------
+HostAllocator::HostAllocator()
+{
+    m_callbacks.pUserData = this;
+    m_callbacks.pfnAllocation = &HostAllocator::allocation_callback;
+    m_callbacks.pfnReallocation = &HostAllocator::reallocation_callback;
+    m_callbacks.pfnFree = &HostAllocator::free_callback;
+    m_callbacks.pfnInternalAllocation = &HostAllocator::internal_allocation_callback;
+    m_callbacks.pfnInternalFree = &HostAllocator::internal_free_callback;
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (size == 0) return nullptr;
+    // The header in front of the pointer needs at least max_align_t alignment.
+    alignment = std::max(alignment, alignof(std::max_align_t));
+
+    void* base = nullptr;
+    void* memory = nullptr;
+    CommandArena* arena = nullptr;
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+        arena = &t_command_arena;
+        memory = arena->allocate(size, alignment);
+        m_arena_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        base = std::malloc(HEADER_SIZE + size + alignment);
+        if (base != nullptr) {
+            memory = reinterpret_cast<void*>(align_up(reinterpret_cast<uintptr_t>(base) + HEADER_SIZE, alignment));
+        }
+    }
+    // Returning nullptr makes the Vulkan call fail with VK_ERROR_OUT_OF_HOST_MEMORY.
+    if (memory == nullptr) return nullptr;
+
+    AllocationHeader* header = header_of(memory);
+    header->base = base;
+    header->arena = arena;
+    header->size = size;
+    header->scope = static_cast<uint32_t>(scope);
+
+    AtomicScopeStats& stats = m_scopes[scope];
+    stats.allocation_count.fetch_add(1, std::memory_order_relaxed);
+    stats.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    track(scope, static_cast<int64_t>(size));
+    return memory;
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    if (original == nullptr) return allocate(size, alignment, scope);
+    if (size == 0) {
+        free(original);
+        return nullptr;
+    }
+    m_scopes[scope].reallocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    // On failure the original allocation has to stay untouched.
+    void* memory = allocate(size, alignment, scope);
+    if (memory == nullptr) return nullptr;
+    std::memcpy(memory, original, std::min(size, header_of(original)->size));
+    free(original);
+    return memory;
+}
+
+void HostAllocator::free(void* memory)
+{
+    if (memory == nullptr) return;
+
+    AllocationHeader* header = header_of(memory);
+    VkSystemAllocationScope scope = static_cast<VkSystemAllocationScope>(header->scope);
+    m_scopes[scope].free_count.fetch_add(1, std::memory_order_relaxed);
+    track(scope, -static_cast<int64_t>(header->size));
+
+    if (header->arena != nullptr) {
+        header->arena->release();
+    }
+    else {
+        std::free(header->base);
+    }
+}
+
+void HostAllocator::track(VkSystemAllocationScope scope, int64_t delta_bytes)
+{
+    AtomicScopeStats& stats = m_scopes[scope];
+    int64_t live = stats.live_bytes.fetch_add(delta_bytes, std::memory_order_relaxed) + delta_bytes;
+    int64_t peak = stats.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !stats.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+uint64_t HostAllocator::total_allocations() const
+{
+    uint64_t total = 0;
+    for (const auto& stats : m_scopes) {
+        total += stats.allocation_count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+//----------------------
+//  Stats
+//----------------------
+HostAllocator::ScopeStats HostAllocator::get_scope_stats(VkSystemAllocationScope scope) const
+{
+    const AtomicScopeStats& stats = m_scopes[scope];
+    ScopeStats result{};
+    result.allocation_count = stats.allocation_count.load(std::memory_order_relaxed);
+    result.reallocation_count = stats.reallocation_count.load(std::memory_order_relaxed);
+    result.free_count = stats.free_count.load(std::memory_order_relaxed);
+    result.allocated_bytes = stats.allocated_bytes.load(std::memory_order_relaxed);
+    result.live_bytes = stats.live_bytes.load(std::memory_order_relaxed);
+    result.peak_bytes = stats.peak_bytes.load(std::memory_order_relaxed);
+    result.internal_count = stats.internal_count.load(std::memory_order_relaxed);
+    result.internal_bytes = stats.internal_bytes.load(std::memory_order_relaxed);
+    return result;
+}
+
+void HostAllocator::begin_frame()
+{
+    uint64_t total = total_allocations();
+    m_last_frame_allocations = total - m_frame_start_allocations;
+    m_frame_start_allocations = total;
+    // The first frame closes the setup, everything after it is allocation churn of the loop.
+    if (m_frame_count++ > 0 && m_last_frame_allocations > m_peak_frame_allocations) {
+        printf("[Host memory] frame %llu : %llu driver allocation(s), new peak \n",
+            (unsigned long long)(m_frame_count - 1), (unsigned long long)m_last_frame_allocations);
+    }
+    m_peak_frame_allocations = std::max(m_peak_frame_allocations, m_last_frame_allocations);
+}
+
+void HostAllocator::print_stats() const
+{
+    static const char* scope_names[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+    for (uint32_t i = 0; i < SCOPE_COUNT; i++) {
+        ScopeStats stats = get_scope_stats(static_cast<VkSystemAllocationScope>(i));
+        printf("[Host memory] %-8s : %llu alloc %llu realloc %llu free, %.2f MB requested, %.2f KB live (peak %.2f KB), %llu internal \n",
+            scope_names[i],
+            (unsigned long long)stats.allocation_count,
+            (unsigned long long)stats.reallocation_count,
+            (unsigned long long)stats.free_count,
+            stats.allocated_bytes / (1024.0 * 1024.0),
+            stats.live_bytes / 1024.0,
+            stats.peak_bytes / 1024.0,
+            (unsigned long long)stats.internal_count);
+    }
+    printf("[Host memory] %llu command scope allocation(s) served by the arena, at most %llu driver allocation(s) in one frame \n",
+        (unsigned long long)arena_allocations(),
+        (unsigned long long)m_peak_frame_allocations);
+}
+
+//----------------------
+//  Vulkan entry points
+//----------------------
+void* VKAPI_PTR HostAllocator::allocation_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator*>(user_data)->allocate(size, alignment, scope);
+}
+
+void* VKAPI_PTR HostAllocator::reallocation_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator*>(user_data)->reallocate(original, size, alignment, scope);
+}
+
+void VKAPI_PTR HostAllocator::free_callback(void* user_data, void* memory)
+{
+    static_cast<HostAllocator*>(user_data)->free(memory);
+}
+
+void VKAPI_PTR HostAllocator::internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    AtomicScopeStats& stats = static_cast<HostAllocator*>(user_data)->m_scopes[scope];
+    stats.internal_count.fetch_add(1, std::memory_order_relaxed);
+    stats.internal_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void VKAPI_PTR HostAllocator::internal_free_callback(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+    AtomicScopeStats& stats = static_cast<HostAllocator*>(user_data)->m_scopes[scope];
+    stats.internal_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+
+// VkAllocationCallbacks handed to every vkCreate* / vkDestroy* call (CoreInstance::allocation_callbacks()).
+// Counts the driver's host allocations per VkSystemAllocationScope so allocation churn inside the
+// frame loop shows up in the stats. Command scope allocations only live for the duration of one
+// Vulkan call, they are served from a per-thread bump arena instead of the general heap.
+// Only routed through in debug builds (CoreInstance::enableHostAllocationTracking).
+class HostAllocator {
+public:
+	HostAllocator();
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	struct ScopeStats {
+		uint64_t	allocation_count = 0;	// new blocks handed out (a reallocation counts as one allocation + one free)
+		uint64_t	reallocation_count = 0;	// pfnReallocation calls
+		uint64_t	free_count = 0;			// pfnFree calls (with a valid pointer)
+		uint64_t	allocated_bytes = 0;	// total bytes ever requested
+		int64_t		live_bytes = 0;			// bytes currently held by the driver
+		int64_t		peak_bytes = 0;
+		uint64_t	internal_count = 0;		// pfnInternalAllocation notifications
+		int64_t		internal_bytes = 0;		// driver owned (e.g. executable) memory currently reported
+	};
+	static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	inline const VkAllocationCallbacks* callbacks() const { return &m_callbacks; }
+
+	//--------------------
+	//  Stats
+	//--------------------
+	ScopeStats	get_scope_stats(VkSystemAllocationScope scope) const;
+	// Call once per frame, closes the allocation count of the previous frame.
+	// A frame allocating more than every frame before it is reported.
+	void		begin_frame();
+	inline uint64_t last_frame_allocations() const { return m_last_frame_allocations; }
+	inline uint64_t peak_frame_allocations() const { return m_peak_frame_allocations; }
+	inline uint64_t arena_allocations() const { return m_arena_allocations.load(std::memory_order_relaxed); }
+	void		print_stats() const;
+
+private:
+	struct AtomicScopeStats {
+		std::atomic<uint64_t>	allocation_count{ 0 };
+		std::atomic<uint64_t>	reallocation_count{ 0 };
+		std::atomic<uint64_t>	free_count{ 0 };
+		std::atomic<uint64_t>	allocated_bytes{ 0 };
+		std::atomic<int64_t>	live_bytes{ 0 };
+		std::atomic<int64_t>	peak_bytes{ 0 };
+		std::atomic<uint64_t>	internal_count{ 0 };
+		std::atomic<int64_t>	internal_bytes{ 0 };
+	};
+
+	VkAllocationCallbacks	m_callbacks{};
+	AtomicScopeStats		m_scopes[SCOPE_COUNT];
+	std::atomic<uint64_t>	m_arena_allocations{ 0 };
+	uint64_t				m_frame_start_allocations = 0;
+	uint64_t				m_last_frame_allocations = 0;
+	uint64_t				m_peak_frame_allocations = 0;
+	uint64_t				m_frame_count = 0;
+
+	void*	allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void*	reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void	free(void* memory);
+	void	track(VkSystemAllocationScope scope, int64_t delta_bytes);
+	uint64_t total_allocations() const;
+
+	static void* VKAPI_PTR allocation_callback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR reallocation_callback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR free_callback(void* user_data, void* memory);
+	static void VKAPI_PTR internal_allocation_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_PTR internal_free_callback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
@@ -26,22 +26,11 @@ void Image::load_texture(const char* path)
         throw std::runtime_error("failed to load texture image!");
     }
 
-    createBuffer(
-        m_core_instance.get_device(),
-        m_core_instance.get_physical_device(),
-        imageSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        m_staging_buffer,
-        m_staging_buffer_memory);
-
-    void* data;
-    vkMapMemory(m_core_instance.get_device(), m_staging_buffer_memory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(m_core_instance.get_device(), m_staging_buffer_memory);
+    // The pixels are copied into the shared staging ring, no staging buffer is kept per texture.
+    create_texture(pixels, imageSize);
     stbi_image_free(pixels);
 
-    create_texture();
-    createTextureImageView();
+    // The view is created by the resource registry together with the image.
     createTextureSampler();
 
     //----------------
@@ -52,110 +41,7 @@ void Image::load_texture(const char* path)
     create_descriptor();
 }
 
-void Image::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-    VkCommandBuffer commandBuffer =  beginSingleTimeCommands(m_core_instance.get_device() , m_core_instance.cmd_pool());
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    // One of the most common ways to perform layout transitions is using an image memory barrier.
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout; //use VK_IMAGE_LAYOUT_UNDEFINED as oldLayout if you don't care about the existing contents
-    barrier.newLayout = newLayout;
-    // If you are using the barrier to transfer queue family ownership, then 
-    // these two fields should be the indices of the queue families.They must
-    // be set to VK_QUEUE_FAMILY_IGNORED if you don't want to do this (not 
-    // the default value!).
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-    //  Our image is not an array and does not have mipmapping levels
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    // Case : Undefined → transfer destination
-    //      transfer writes that don't need to wait on anything
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;  //earliest possible pipeline stage
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT; //is not a real stage within the graphics and compute pipelines. 
-    }
-    // Case : Transfer destination → shader reading
-    //      shader reads should wait on transfer writes, specifically the shader
-    //      reads in the fragment shader, because that's where we're going to use the texture
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else {
-        throw std::invalid_argument("unsupported layout transition!");
-    }
-    // operations that involve the resource must happen before the barrier
-    barrier.srcAccessMask = 0; // TODO
-    // operations that involve the resource must wait on the barrier
-    barrier.dstAccessMask = 0; // TODO
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        // in which pipeline stage the operations occur that should happen before the barrier.
-        sourceStage,
-        // the pipeline stage in which operations will wait on the barrier.
-        destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );  // Shader stage only : https://registry.khronos.org/vulkan/specs/1.3-extensions/html/chap7.html#synchronization-access-types-supported
-
-
-    endSingleTimeCommands(m_core_instance , commandBuffer);
-}
-
-void Image::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-{
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands( m_core_instance.get_device() , m_core_instance.cmd_pool());
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    // 0 indicates that the pixels are simply tightly packed
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    // Which part of the image (crop)
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = {
-        width,
-        height,
-        1
-    };
-
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-    );
-    endSingleTimeCommands(m_core_instance,commandBuffer);
-
-}
-
-void Image::create_texture()
+void Image::create_texture(const void* pixels, VkDeviceSize imageSize)
 {
     //---------------
     //      Create Image Object
@@ -175,86 +61,68 @@ void Image::create_texture()
     //      *VK_IMAGE_TILING_OPTIMAL: Texels are laid out in an implementation defined order for optimal access
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL; // the tiling mode cannot be changed 
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // Transfer src lets the defragmenter copy the image to another memory block.
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     // Samples flag is related to multisampling. This is only relevant for images 
     // that will be used as attachments, so stick to one sample.  (Useful in stoeing 3D terrain map)
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.flags = 0; // Optional
 
-    if (vkCreateImage(m_core_instance.get_device(), &imageInfo, nullptr, &m_textureImage) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image!");
-    }
-
-
     //---------------
     //      Bind image to memory
     //---------------
-    VkMemoryRequirements memRequirements;
-    //vkGetBufferMemoryRequirements
-    vkGetImageMemoryRequirements(m_core_instance.get_device(), m_textureImage, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(m_core_instance.get_physical_device(), memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(m_core_instance.get_device(), &allocInfo, nullptr, &m_textureImage_memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-    //vkBindBufferMemory.
-    vkBindImageMemory(m_core_instance.get_device(), m_textureImage, m_textureImage_memory, 0);
+    // The image is bound to a sub allocation of the core allocator (optimal tiling pool)
+    // and owned by the resource registry, only its handle is kept here.
+    auto& resources = m_core_instance.resources();
+    m_texture = resources.create_image(imageInfo, MemoryUsage::GPU_ONLY);
 
 
    //---------------
-   //    Move from staging buffer to texture image
+   //    Move from staging ring to texture image
    //---------------
-    transitionImageLayout(
-        m_textureImage, 
-        VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(
-        m_staging_buffer, m_textureImage,
-        static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height));
-
-    // For shader to access it
-    transitionImageLayout(
-        m_textureImage, 
-        VK_FORMAT_R8G8B8A8_SRGB, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+    // Layout transitions and the copy are recorded into the staging batch,
+    // they are submitted with the next flush (before the frame is submitted).
+    uint64_t ticket = m_core_instance.staging_ring().upload_image(
+        resources.image(m_texture),
+        VkExtent3D{ static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1 },
+        pixels, imageSize,
         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    resources.make_movable(m_texture, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, ticket,
+        [this](ImageHandle) { on_texture_moved(); });
 }
 
-void Image::createTextureImageView()
+void Image::on_texture_moved()
 {
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = m_textureImage;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    if (vkCreateImageView(
-        m_core_instance.get_device(),
-        &viewInfo, nullptr, &m_texture_imageView) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create texture image view!");
-    }
+    // A descriptor set must not be updated while a pending command buffer uses it,
+    // so the new view goes into the spare set and the sets are swapped.
+    std::swap(m_descriptorSets, m_spare_descriptorSet);
+    create_descriptor();
 }
 
 void Image::cleanup()
 {
-    transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    vkDestroyBuffer(m_core_instance.get_device(), m_staging_buffer, nullptr);
-    vkFreeMemory(m_core_instance.get_device(), m_staging_buffer_memory, nullptr);
-    vkDestroyImageView(m_core_instance.get_device(), m_texture_imageView, nullptr);
-
-    vkDestroyImage(m_core_instance.get_device(), m_textureImage, nullptr);
-    vkFreeMemory(m_core_instance.get_device(), m_textureImage_memory, nullptr);
-    vkDestroySampler(m_core_instance.get_device(), m_texture_sampler, nullptr);
+    // The registry retires the image and its view.
+    m_core_instance.resources().destroy(m_texture);
+
+    // Frames in flight may still sample the texture, the rest goes once their fence has signaled.
+    CoreInstance* core_instance = &m_core_instance;
+    VkSampler sampler = m_texture_sampler;
+    VkDescriptorPool pool = m_descriptorPool;
+    VkDescriptorSetLayout layout = m_descriptorSetLayout;
+    m_core_instance.deletion_queue().push([=]() {
+        VkDevice device = core_instance->get_device();
+        const VkAllocationCallbacks* callbacks = core_instance->allocation_callbacks();
+        vkDestroySampler(device, sampler, callbacks);
+        // Also frees the descriptor sets
+        vkDestroyDescriptorPool(device, pool, callbacks);
+        vkDestroyDescriptorSetLayout(device, layout, callbacks);
+    });
+    m_texture = ImageHandle{};
+    m_texture_sampler = VK_NULL_HANDLE;
+    m_descriptorPool = VK_NULL_HANDLE;
+    m_descriptorSetLayout = VK_NULL_HANDLE;
 }
 
 void Image::createTextureSampler()
@@ -285,7 +153,7 @@ void Image::createTextureSampler()
      
     samplerInfo.anisotropyEnable = VK_FALSE;  // Temp
     samplerInfo.maxAnisotropy = 1.0f;
-    if (vkCreateSampler(m_core_instance.get_device(), &samplerInfo, nullptr, &m_texture_sampler) != VK_SUCCESS) {
+    if (vkCreateSampler(m_core_instance.get_device(), &samplerInfo, m_core_instance.allocation_callbacks(), &m_texture_sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
 
@@ -310,41 +178,46 @@ void Image::createDescriptorSetLayout()
 
     if (vkCreateDescriptorSetLayout(
         m_core_instance.get_device()
-        , &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        , &layoutInfo, m_core_instance.allocation_callbacks(), &m_descriptorSetLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
 
+    // The current set + the spare one used when the texture is moved.
+    VkDescriptorSetLayout layouts[2] = { m_descriptorSetLayout, m_descriptorSetLayout };
+    VkDescriptorSet sets[2];
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = m_descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(1);
-    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(2);
+    allocInfo.pSetLayouts = layouts;
 
     if (vkAllocateDescriptorSets(
         m_core_instance.get_device(),
         &allocInfo,
-        &m_descriptorSets) != VK_SUCCESS) {
+        sets) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
+    m_descriptorSets = sets[0];
+    m_spare_descriptorSet = sets[1];
 }
 
 void Image::create_descriptor_pool()
 {
     
     // Create pool helps to catch the VK_ERROR_POOL_OUT_OF_MEMORY error:
-    VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , 1};    
-    std::vector<VkDescriptorPoolSize > poolSizes = { poolSizes };
+    VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER , 2};    
+    std::vector<VkDescriptorPoolSize > poolSizes = { poolSize };
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
     //poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-    poolInfo.maxSets = 1;
+    poolInfo.maxSets = 2;  // current + spare set
 
     if (vkCreateDescriptorPool(
         m_core_instance.get_device(),
-        &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        &poolInfo, m_core_instance.allocation_callbacks(), &m_descriptorPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool!");
     }
 }
@@ -356,7 +229,7 @@ void Image::create_descriptor()
    
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = m_texture_imageView;
+        imageInfo.imageView = m_core_instance.resources().view(m_texture);
         imageInfo.sampler = m_texture_sampler;
 
         VkWriteDescriptorSet set{};
@@ -376,6 +249,8 @@ void Image::create_descriptor()
         m_core_instance.get_device(),
         static_cast<uint32_t>(descriptorWrites.size()),
         descriptorWrites.data(), 0, nullptr);
-  
+
+    // Whoever draws with this texture binds the set through the registry.
+    m_core_instance.resources().get(m_texture)->descriptor_set = m_descriptorSets;
 }
 
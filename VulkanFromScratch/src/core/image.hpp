@@ -12,36 +12,33 @@ public:
 	~Image() ;
 
 	void load_texture(const char* path);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 	
 	// Temp :
 	inline VkDescriptorSetLayout& get_descriptorsetLayout() 
 		{return m_descriptorSetLayout;}
+	inline ImageHandle handle() const { return m_texture; }
 
 private:
 	int m_width, m_height , m_channel;
-	VkBuffer m_staging_buffer;
-	VkDeviceMemory m_staging_buffer_memory;
 
-	VkImage m_textureImage;
-	VkDeviceMemory m_textureImage_memory;
-
-	VkImageView m_texture_imageView;
+	// Image + view, owned by CoreInstance::resources()
+	ImageHandle m_texture;
 	VkSampler m_texture_sampler;
 
 	CoreInstance& m_core_instance;
 	VkDescriptorSet m_descriptorSets;
+	// Written when the texture is moved by the defragmenter, frames in flight keep using the current one.
+	VkDescriptorSet m_spare_descriptorSet;
 	VkDescriptorPool m_descriptorPool;
 	VkDescriptorSetLayout m_descriptorSetLayout;
 
-	void create_texture();
-	void createTextureImageView();
+	void create_texture(const void* pixels, VkDeviceSize imageSize);
 	void createTextureSampler();
 
 	void createDescriptorSetLayout();
 	void create_descriptor_pool();
 	void create_descriptor();
+	void on_texture_moved();
 
 	void cleanup();
 	
@@ -0,0 +1,172 @@
+#include "immediate_context.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+
+ImmediateContext::~ImmediateContext()
+{
+    cleanup();
+}
+
+void ImmediateContext::init(CoreInstance& core_instance)
+{
+    init(core_instance, core_instance.get_queuefailmy_indexs()->graphic_queuefamily_index.value(), core_instance.graphic_queue());
+}
+
+void ImmediateContext::init(CoreInstance& core_instance, uint32_t queue_family, VkQueue queue)
+{
+    m_core_instance = &core_instance;
+    m_queue_family = queue_family;
+    m_queue = queue;
+    m_is_graphic = queue_family == core_instance.get_queuefailmy_indexs()->graphic_queuefamily_index.value();
+    create_command_pool();
+}
+
+void ImmediateContext::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    submit();
+    while (!m_in_flight.empty()) {
+        vkWaitForFences(m_core_instance->get_device(), 1, &m_in_flight.front().fence, VK_TRUE, UINT64_MAX);
+        retire_oldest();
+    }
+
+    for (auto& batch : m_free_batches) {
+        vkDestroyFence(m_core_instance->get_device(), batch.fence, m_core_instance->allocation_callbacks());
+    }
+    m_free_batches.clear();
+    // Command buffers are freed together with the pool.
+    vkDestroyCommandPool(m_core_instance->get_device(), m_commandPool, m_core_instance->allocation_callbacks());
+    m_core_instance = nullptr;
+}
+
+VkCommandBuffer ImmediateContext::record()
+{
+    if (m_is_recording) return m_recording.cmd;
+
+    if (!m_free_batches.empty()) {
+        m_recording = std::move(m_free_batches.back());
+        m_free_batches.pop_back();
+    }
+    else {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(m_core_instance->get_device(), &allocInfo, &m_recording.cmd) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(m_core_instance->get_device(), &fenceInfo, m_core_instance->allocation_callbacks(), &m_recording.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence!");
+        }
+    }
+    m_recording.ticket = m_next_ticket++;
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(m_recording.cmd, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    m_is_recording = true;
+    return m_recording.cmd;
+}
+
+void ImmediateContext::wait_semaphore(VkSemaphore semaphore, VkPipelineStageFlags stages)
+{
+    record();
+    m_recording.wait_semaphores.push_back(semaphore);
+    m_recording.wait_stages.push_back(stages);
+}
+
+void ImmediateContext::signal_semaphore(VkSemaphore semaphore)
+{
+    record();
+    m_recording.signal_semaphores.push_back(semaphore);
+}
+
+void ImmediateContext::submit()
+{
+    if (!m_is_recording) return;
+
+    // Make everything written by this batch available to whatever runs after it on the queue.
+    // A transfer only queue has no shader stage to make writes of available.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | (m_is_graphic ? VK_ACCESS_SHADER_WRITE_BIT : 0);
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(m_recording.cmd,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(m_recording.cmd) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(m_recording.wait_semaphores.size());
+    submitInfo.pWaitSemaphores = m_recording.wait_semaphores.data();
+    submitInfo.pWaitDstStageMask = m_recording.wait_stages.data();
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_recording.cmd;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(m_recording.signal_semaphores.size());
+    submitInfo.pSignalSemaphores = m_recording.signal_semaphores.data();
+    if (vkQueueSubmit(m_queue, 1, &submitInfo, m_recording.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffer!");
+    }
+    m_submit_count++;
+
+    m_recording.wait_semaphores.clear();
+    m_recording.wait_stages.clear();
+    m_recording.signal_semaphores.clear();
+    m_in_flight.push_back(std::move(m_recording));
+    m_recording = Batch{};
+    m_is_recording = false;
+}
+
+bool ImmediateContext::poll(uint64_t ticket)
+{
+    while (!m_in_flight.empty() &&
+        vkGetFenceStatus(m_core_instance->get_device(), m_in_flight.front().fence) == VK_SUCCESS) {
+        retire_oldest();
+    }
+    return ticket <= m_completed_ticket;
+}
+
+void ImmediateContext::wait(uint64_t ticket)
+{
+    if (m_is_recording && ticket >= m_recording.ticket) {
+        submit();
+    }
+    while (ticket > m_completed_ticket && !m_in_flight.empty()) {
+        vkWaitForFences(m_core_instance->get_device(), 1, &m_in_flight.front().fence, VK_TRUE, UINT64_MAX);
+        retire_oldest();
+    }
+}
+
+void ImmediateContext::create_command_pool()
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = m_queue_family;
+
+    if (vkCreateCommandPool(m_core_instance->get_device(), &poolInfo, m_core_instance->allocation_callbacks(), &m_commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create command pool!");
+    }
+}
+
+void ImmediateContext::retire_oldest()
+{
+    Batch batch = std::move(m_in_flight.front());
+    m_in_flight.pop_front();
+    m_completed_ticket = batch.ticket;
+
+    vkResetFences(m_core_instance->get_device(), 1, &batch.fence);
+    m_free_batches.push_back(std::move(batch));
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+
+class CoreInstance;
+
+// Batched replacement for the old beginSingleTimeCommands / endSingleTimeCommands pair.
+// One-shot work (layout transitions, copies...) is recorded into a shared command buffer
+// and submitted once with a fence instead of one submit + vkQueueWaitIdle per command.
+// Every recorded command belongs to a ticket that can be polled or waited on.
+// CoreInstance::immediate() runs on the graphic queue, StagingRing keeps a second one
+// on the dedicated transfer queue when there is one.
+class ImmediateContext {
+public:
+	ImmediateContext() = default;
+	~ImmediateContext();
+
+	void init(CoreInstance& core_instance);
+	void init(CoreInstance& core_instance, uint32_t queue_family, VkQueue queue);
+	void cleanup();
+
+	// Command buffer of the open batch, record as many commands as needed.
+	VkCommandBuffer	record();
+	// Ticket of the open batch, becomes complete once that batch has executed.
+	inline uint64_t	current_ticket() const { return m_is_recording ? m_recording.ticket : m_next_ticket; }
+	// Semaphores of the open batch, used for queue family ownership transfers.
+	void		wait_semaphore(VkSemaphore semaphore, VkPipelineStageFlags stages);
+	void		signal_semaphore(VkSemaphore semaphore);
+
+	// Submits the open batch (no-op when empty). The batch ends with a barrier,
+	// so later submissions on the graphic queue see its results without a CPU wait.
+	void		submit();
+	// Non blocking, also recycles every finished batch.
+	bool		poll(uint64_t ticket);
+	// Submits the ticket's batch if needed and blocks until it has finished.
+	void		wait(uint64_t ticket);
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	inline uint32_t submit_count() const { return m_submit_count; }
+
+private:
+	struct Batch {
+		VkCommandBuffer	cmd = VK_NULL_HANDLE;
+		VkFence			fence = VK_NULL_HANDLE;
+		uint64_t		ticket = 0;
+		std::vector<VkSemaphore>			wait_semaphores;
+		std::vector<VkPipelineStageFlags>	wait_stages;
+		std::vector<VkSemaphore>			signal_semaphores;
+	};
+
+	CoreInstance*		m_core_instance = nullptr;
+	uint32_t			m_queue_family = 0;
+	VkQueue				m_queue = VK_NULL_HANDLE;
+	bool				m_is_graphic = true;
+	VkCommandPool		m_commandPool = VK_NULL_HANDLE;
+	Batch				m_recording;
+	bool				m_is_recording = false;
+	std::deque<Batch>	m_in_flight;
+	std::vector<Batch>	m_free_batches;
+	uint64_t			m_next_ticket = 1;
+	uint64_t			m_completed_ticket = 0;
+	uint32_t			m_submit_count = 0;
+
+	void create_command_pool();
+	void retire_oldest();
+};
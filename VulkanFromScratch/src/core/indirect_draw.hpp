@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <algorithm>
+#include <glm.hpp>
+
+class Model;
+
+// A draw of IndirectDrawList, shared with the collaborators that pick what it draws
+// (LodSelector, HlodSwitcher).
+struct IndirectDraw {
+	Model*		model = nullptr;
+	glm::mat4	transform{ 1.0f };
+	// Set by IndirectDrawList::build_layout()
+	uint32_t	instance = 0;
+	uint32_t	first_command = 0;
+	uint32_t	command_count = 0;	// 1, or one per meshlet
+	bool		split = false;		// one command per meshlet
+	uint32_t	lod = 0;			// level of the model, 0 when split
+	bool		proxy = false;		// of an HLOD cluster
+	bool		hidden = false;		// commands with instanceCount 0 : swapped for / by a proxy
+};
+
+// Largest scale of the transform's axes.
+inline float max_scale(const glm::mat4& transform)
+{
+	return std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+}
+
+// Bounding sphere of `local` (xyz center, w radius) through the draw's transform.
+inline glm::vec4 world_sphere(const IndirectDraw& draw, const glm::vec4& local)
+{
+	return glm::vec4(glm::vec3(draw.transform * glm::vec4(glm::vec3(local), 1.0f)), local.w * max_scale(draw.transform));
+}
@@ -0,0 +1,381 @@
+#include "indirect_draw_list.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+// Indexed by IndirectDrawList::Path.
+static const char* PATH_NAMES[] = { "indirect count", "multi draw indirect", "single draw indirect", "direct" };
+
+static inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+IndirectDrawList::IndirectDrawList(CoreInstance& core, uint32_t max_draws, uint32_t max_commands)
+    : m_core_instance{ core }, m_max_draws{ max_draws }, m_max_commands{ std::max(max_commands, max_draws) }
+{
+    const VkPhysicalDeviceFeatures& features = m_core_instance.enabled_features();
+    if (!features.drawIndirectFirstInstance) {
+        m_path = Path::DIRECT;
+    }
+    else if (!features.multiDrawIndirect) {
+        m_path = Path::SINGLE_DRAW_INDIRECT;
+    }
+    else {
+        m_path = m_core_instance.cmd_draw_indexed_indirect_count() != nullptr ? Path::INDIRECT_COUNT : Path::MULTI_DRAW_INDIRECT;
+    }
+    // The path is fixed for the list's lifetime, reported once.
+    printf("[Indirect] path : %s \n", PATH_NAMES[static_cast<int>(m_path)]);
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_core_instance.get_physical_device(), &properties);
+    m_max_draw_indirect_count = std::max(properties.limits.maxDrawIndirectCount, 1u);
+
+    // One batch per draw at worst.
+    m_instance_offset = align_up(sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(m_max_commands), 16);
+    m_count_offset = align_up(m_instance_offset + sizeof(InstanceData) * static_cast<VkDeviceSize>(max_draws), 16);
+    // The culler reads the objects and the commands as storage buffers, 256 covers minStorageBufferOffsetAlignment.
+    m_object_offset = align_up(m_count_offset + sizeof(uint32_t) * static_cast<VkDeviceSize>(max_draws), 256);
+    m_frame_size = align_up(m_object_offset + sizeof(FrustumCuller::Object) * static_cast<VkDeviceSize>(m_max_commands), 256);
+    m_buffer = m_core_instance.resources().create_buffer(m_frame_size * SwapChain::MAX_FRAMES_IN_FLIGHT,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::DYNAMIC);
+    if (m_core_instance.resources().get(m_buffer)->allocation.mapped == nullptr) {
+        throw std::runtime_error("failed to map indirect draw buffer!");
+    }
+    m_frame_versions.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, 0);
+}
+
+IndirectDrawList::~IndirectDrawList()
+{
+    // Retired through the deletion queue, frames in flight may still read the commands.
+    m_core_instance.resources().destroy(m_buffer);
+}
+
+//----------------------
+//  Draws
+//----------------------
+uint32_t IndirectDrawList::add(Model& model, const glm::mat4& transform)
+{
+    if (m_draws.size() >= m_max_draws) {
+        throw std::runtime_error("failed to add draw, indirect draw list is full!");
+    }
+    IndirectDraw draw;
+    draw.model = &model;
+    draw.transform = transform;
+    m_draws.push_back(draw);
+    m_layout_dirty = true;
+    return draw_count() - 1;
+}
+
+void IndirectDrawList::set_transform(uint32_t draw, const glm::mat4& transform)
+{
+    m_draws[draw].transform = transform;
+    if (m_layout_dirty) return;     // the next layout rebuild writes everything
+    const IndirectDraw& d = m_draws[draw];
+    m_instances[d.instance] = InstanceData::from_matrix(d.transform * dequantization_matrix(d.model->dequantization()));
+    write_objects(d, m_objects[d.first_command].batch);
+    m_changes.emplace_back(++m_version, draw);
+}
+
+void IndirectDrawList::clear()
+{
+    m_draws.clear();
+    m_hlod.clear();
+    m_layout_dirty = true;
+}
+
+void IndirectDrawList::write_objects(const IndirectDraw& draw, uint32_t batch)
+{
+    for (uint32_t i = 0; i < draw.command_count; i++) {
+        const Meshlet* meshlet = draw.split ? &draw.model->meshlets()[i] : nullptr;
+        m_objects[draw.first_command + i] = CullingPass::object(draw, meshlet, m_cone_culling,
+            draw.first_command + i, batch, m_batches[batch].first_command);
+    }
+}
+
+void IndirectDrawList::build_layout()
+{
+    // Sorted by batch key, each batch then is one contiguous range of commands.
+    std::vector<uint32_t> order(m_draws.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        const Model& ma = *m_draws[a].model;
+        const Model& mb = *m_draws[b].model;
+        if (ma.pipeline() != mb.pipeline()) return ma.pipeline() < mb.pipeline();
+        return ma.geometry().index_type < mb.geometry().index_type;
+    });
+
+    m_instances.resize(order.size());
+    m_commands.clear();
+    m_batches.clear();
+    uint32_t meshlet_commands = 0;
+    for (uint32_t instance = 0; instance < order.size(); instance++) {
+        IndirectDraw& draw = m_draws[order[instance]];
+        const GeometryRange& geometry = draw.model->geometry();
+        // Split only when something culls the meshlets, drawn whole they are just more commands.
+        draw.split = m_clusters && m_culling && !draw.model->meshlets().empty();
+        draw.instance = instance;
+        draw.first_command = static_cast<uint32_t>(m_commands.size());
+        draw.command_count = draw.split ? static_cast<uint32_t>(draw.model->meshlets().size()) : 1;
+        if (static_cast<uint64_t>(draw.first_command) + draw.command_count > m_max_commands) {
+            throw std::runtime_error("failed to build indirect draw list, too many commands!");
+        }
+        // The packed formats' dequantization is folded into the transform, the batch pushes the identity.
+        m_instances[instance] = InstanceData::from_matrix(draw.transform * dequantization_matrix(draw.model->dequantization()));
+
+        // Meshlets only exist for LOD 0.
+        if (draw.split) draw.lod = 0;
+        const MeshLod& level = draw.model->lod(std::min(draw.lod, draw.model->lod_count() - 1));
+        for (uint32_t i = 0; i < draw.command_count; i++) {
+            const Meshlet* meshlet = draw.split ? &draw.model->meshlets()[i] : nullptr;
+            VkDrawIndexedIndirectCommand cmd;
+            cmd.indexCount = meshlet ? meshlet->triangle_count * 3 : level.index_count;
+            cmd.instanceCount = draw.hidden ? 0 : 1;
+            cmd.firstIndex = geometry.first_index + (meshlet ? meshlet->first_index : level.first_index);
+            cmd.vertexOffset = geometry.vertex_offset;
+            cmd.firstInstance = instance;
+            m_commands.push_back(cmd);
+        }
+        if (draw.split) meshlet_commands += draw.command_count;
+
+        if (m_batches.empty() || m_batches.back().pipeline != draw.model->pipeline() || m_batches.back().index_type != geometry.index_type) {
+            Batch batch;
+            batch.pipeline = draw.model->pipeline();
+            batch.index_type = geometry.index_type;
+            batch.first_command = draw.first_command;
+            m_batches.push_back(batch);
+        }
+        m_batches.back().command_count += draw.command_count;
+        m_objects.resize(m_commands.size());
+        write_objects(draw, static_cast<uint32_t>(m_batches.size() - 1));
+    }
+    m_compact = m_path == Path::INDIRECT_COUNT && std::all_of(m_batches.begin(), m_batches.end(),
+        [this](const Batch& batch) { return batch.command_count <= m_max_draw_indirect_count; });
+
+    m_layout_version = ++m_version;
+    m_changes.clear();
+    m_layout_dirty = false;
+
+#ifndef NDEBUG
+    // Rebuilt whenever draws are added or removed, too often to report in release builds.
+    printf("[Indirect] %u draws, %u commands (%u meshlets) in %zu batch(es) \n",
+        draw_count(), command_count(), meshlet_commands, m_batches.size());
+#else
+    (void)meshlet_commands;
+#endif
+}
+
+//----------------------
+//  Frame
+//----------------------
+void IndirectDrawList::write_draw(uint8_t* frame_data, uint32_t draw)
+{
+    const IndirectDraw& d = m_draws[draw];
+    memcpy(frame_data + sizeof(VkDrawIndexedIndirectCommand) * d.first_command, &m_commands[d.first_command],
+        sizeof(VkDrawIndexedIndirectCommand) * d.command_count);
+    memcpy(frame_data + m_instance_offset + sizeof(InstanceData) * d.instance, &m_instances[d.instance], sizeof(InstanceData));
+    memcpy(frame_data + m_object_offset + sizeof(FrustumCuller::Object) * d.first_command, &m_objects[d.first_command],
+        sizeof(FrustumCuller::Object) * d.command_count);
+}
+
+void IndirectDrawList::sync(uint32_t frame)
+{
+    if (m_layout_dirty) build_layout();
+    // Idempotent within a frame, the second sync (record) finds the same clusters and levels.
+    if (!m_hlod.empty()) m_hlod.select(m_view_projection, [this](uint32_t draw, bool hidden) { set_hidden(draw, hidden); });
+    if (m_lod) select_lods();
+
+    uint8_t* frame_data = static_cast<uint8_t*>(m_core_instance.resources().get(m_buffer)->allocation.mapped) + m_frame_size * frame;
+    uint64_t& frame_version = m_frame_versions[frame];
+    if (frame_version < m_layout_version) {
+        memcpy(frame_data, m_commands.data(), m_commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+        memcpy(frame_data + m_instance_offset, m_instances.data(), m_instances.size() * sizeof(InstanceData));
+        uint32_t* counts = reinterpret_cast<uint32_t*>(frame_data + m_count_offset);
+        for (size_t i = 0; i < m_batches.size(); i++) counts[i] = m_batches[i].command_count;
+        memcpy(frame_data + m_object_offset, m_objects.data(), m_objects.size() * sizeof(FrustumCuller::Object));
+    }
+    else {
+        for (const auto& change : m_changes) {
+            if (change.first > frame_version) write_draw(frame_data, change.second);
+        }
+    }
+    frame_version = m_version;
+
+    // Every frame holds the changes up to the oldest frame version, drop those.
+    uint64_t oldest = *std::min_element(m_frame_versions.begin(), m_frame_versions.end());
+    m_changes.erase(std::remove_if(m_changes.begin(), m_changes.end(),
+        [oldest](const std::pair<uint64_t, uint32_t>& change) { return change.first <= oldest; }), m_changes.end());
+}
+
+//----------------------
+//  LOD / HLOD
+//----------------------
+void IndirectDrawList::enable_lod_selection(float viewport_height, float max_pixel_error)
+{
+    m_lod = std::make_unique<LodSelector>(viewport_height, max_pixel_error);
+}
+
+void IndirectDrawList::select_lods()
+{
+    m_lod_switched.clear();
+    m_lod->select(m_view_projection, m_draws, m_lod_switched);
+    for (uint32_t id : m_lod_switched) {
+        const IndirectDraw& draw = m_draws[id];
+        const MeshLod& level = draw.model->lod(draw.lod);
+        VkDrawIndexedIndirectCommand& cmd = m_commands[draw.first_command];
+        cmd.indexCount = level.index_count;
+        cmd.firstIndex = draw.model->geometry().first_index + level.first_index;
+        m_changes.emplace_back(++m_version, id);
+    }
+}
+
+uint32_t IndirectDrawList::add_hlod(Model& proxy, const std::vector<uint32_t>& members, float distance)
+{
+    // Hidden until the camera is far enough, the next sync decides.
+    uint32_t id = add(proxy, glm::mat4(1.0f));
+    m_draws[id].proxy = true;
+    m_draws[id].hidden = true;
+    try {
+        return m_hlod.add(id, members, distance, m_draws);
+    }
+    catch (...) {
+        m_draws.pop_back();
+        throw;
+    }
+}
+
+void IndirectDrawList::set_hidden(uint32_t id, bool hidden)
+{
+    IndirectDraw& draw = m_draws[id];
+    draw.hidden = hidden;
+    for (uint32_t i = 0; i < draw.command_count; i++) m_commands[draw.first_command + i].instanceCount = hidden ? 0 : 1;
+    m_changes.emplace_back(++m_version, id);
+}
+
+//----------------------
+//  Culling
+//----------------------
+void IndirectDrawList::enable_frustum_culling(const glm::mat4& view_projection)
+{
+    if (m_path == Path::DIRECT) {
+        throw std::runtime_error("failed to enable frustum culling, the device has no indirect draw path!");
+    }
+    m_view_projection = view_projection;
+    if (m_culling) return;
+    m_culling = std::make_unique<CullingPass>(m_core_instance, m_max_commands,
+        m_core_instance.resources().buffer(m_buffer), m_frame_size, m_object_offset);
+    if (m_clusters) m_layout_dirty = true;     // the draws are split once something culls them
+}
+
+void IndirectDrawList::enable_occlusion_culling(Renderer& renderer, const glm::mat4& view_projection)
+{
+    if (m_path == Path::DIRECT) {
+        throw std::runtime_error("failed to enable occlusion culling, the device has no indirect draw path!");
+    }
+    m_view_projection = view_projection;
+    if (m_culling && m_culling->has_occlusion()) return;
+    m_culling = std::make_unique<CullingPass>(m_core_instance, m_max_commands,
+        m_core_instance.resources().buffer(m_buffer), m_frame_size, m_object_offset, &renderer);
+    if (m_clusters) m_layout_dirty = true;
+}
+
+void IndirectDrawList::enable_cluster_culling(bool backface)
+{
+    m_clusters = true;
+    m_cone_culling = backface;
+    m_layout_dirty = true;
+}
+
+void IndirectDrawList::update_before_frame(FrameUpdateData& update_data)
+{
+    if (m_culling == nullptr || m_draws.empty()) return;
+    sync(update_data.m_image_idx);
+    m_culling->dispatch(update_data.m_cmdbuffer, update_data.m_image_idx, m_view_projection,
+        command_count(), static_cast<uint32_t>(m_batches.size()), m_compact, m_layout_version);
+}
+
+void IndirectDrawList::update(FrameUpdateData& update_data)
+{
+    record(update_data.m_cmdbuffer, update_data.m_pipeline_layout, update_data.m_image_idx);
+}
+
+void IndirectDrawList::record(VkCommandBuffer cmdBuf, VkPipelineLayout pipeline_layout, uint32_t frame)
+{
+    if (m_draws.empty()) return;
+    sync(frame);
+    if (m_lod) m_lod->count_frame();
+    if (!m_hlod.empty()) m_hlod.count_frame();
+
+    // Drawn unculled when the dispatch was not recorded for this frame.
+    bool culled = m_culling && m_culling->take_dispatched();
+
+    VkBuffer buffer = m_core_instance.resources().buffer(m_buffer);
+    // firstInstance counts from here, the instance ring is bound again at the end.
+    VkDeviceSize instance_offset = m_frame_size * frame + m_instance_offset;
+    vkCmdBindVertexBuffers(cmdBuf, InstanceRing::INSTANCE_BINDING, 1, &buffer, &instance_offset);
+    record_batches(cmdBuf, pipeline_layout, frame, culled, false);
+
+    if (culled && m_culling->has_occlusion()) {
+        m_culling->dispatch_late(cmdBuf, frame, m_view_projection, command_count(), static_cast<uint32_t>(m_batches.size()), m_compact);
+        record_batches(cmdBuf, pipeline_layout, frame, true, true);
+    }
+    m_core_instance.instance_ring().bind(cmdBuf);
+}
+
+void IndirectDrawList::record_batches(VkCommandBuffer cmdBuf, VkPipelineLayout pipeline_layout, uint32_t frame, bool culled, bool late)
+{
+    VkBuffer buffer = m_core_instance.resources().buffer(m_buffer);
+    VkDeviceSize frame_offset = m_frame_size * frame;
+    VkBuffer command_buffer = culled ? m_culling->culler().command_buffer() : buffer;
+    VkDeviceSize commands_offset = culled ? m_culling->culler().command_offset(frame, late) : frame_offset;
+
+    const VertexDequantization identity;
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    for (size_t b = 0; b < m_batches.size(); b++) {
+        const Batch& batch = m_batches[b];
+        if (batch.pipeline != bound_pipeline) {
+            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
+            vkCmdPushConstants(cmdBuf, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization), &identity);
+            bound_pipeline = batch.pipeline;
+        }
+        m_core_instance.geometry_pool().bind_index_buffer(cmdBuf, batch.index_type);
+
+        VkDeviceSize command_offset = commands_offset + sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(batch.first_command);
+        // Batches over maxDrawIndirectCount are split, the count buffer only holds whole batches.
+        // The culled output is then left in place for every batch, the counts are not written.
+        bool split = culled ? !m_compact : batch.command_count > m_max_draw_indirect_count;
+        Path path = m_path == Path::INDIRECT_COUNT && split ? Path::MULTI_DRAW_INDIRECT : m_path;
+        switch (path) {
+        case Path::INDIRECT_COUNT:
+            if (culled) {
+                m_core_instance.cmd_draw_indexed_indirect_count()(cmdBuf, command_buffer, command_offset,
+                    m_culling->culler().count_buffer(), m_culling->culler().count_offset(frame, static_cast<uint32_t>(b), late), batch.command_count, stride);
+            }
+            else {
+                m_core_instance.cmd_draw_indexed_indirect_count()(cmdBuf, buffer, command_offset,
+                    buffer, frame_offset + m_count_offset + sizeof(uint32_t) * b, batch.command_count, stride);
+            }
+            break;
+        case Path::MULTI_DRAW_INDIRECT:
+            for (uint32_t first = 0; first < batch.command_count; first += m_max_draw_indirect_count) {
+                uint32_t count = std::min(batch.command_count - first, m_max_draw_indirect_count);
+                vkCmdDrawIndexedIndirect(cmdBuf, command_buffer, command_offset + static_cast<VkDeviceSize>(first) * stride, count, stride);
+            }
+            break;
+        case Path::SINGLE_DRAW_INDIRECT:
+            for (uint32_t i = 0; i < batch.command_count; i++) {
+                vkCmdDrawIndexedIndirect(cmdBuf, command_buffer, command_offset + static_cast<VkDeviceSize>(i) * stride, 1, stride);
+            }
+            break;
+        case Path::DIRECT:
+            // firstInstance still selects the instance, only indirect draws need the feature for it.
+            for (uint32_t i = 0; i < batch.command_count; i++) {
+                const VkDrawIndexedIndirectCommand& cmd = m_commands[batch.first_command + i];
+                if (cmd.instanceCount == 0) continue;
+                vkCmdDrawIndexed(cmdBuf, cmd.indexCount, cmd.instanceCount, cmd.firstIndex, cmd.vertexOffset, cmd.firstInstance);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include "core/core_fwd.h"
+#include <vector>
+#include <utility>
+#include <memory>
+#include <glm.hpp>
+#include "core/indirect_draw.hpp"
+#include "core/culling_pass.hpp"
+#include "core/lod_selector.hpp"
+#include "core/hlod_switcher.hpp"
+
+// Records a whole scene with a handful of indirect draws.
+// Draws are registered once. Their VkDrawIndexedIndirectCommand and InstanceData live in a
+// host visible buffer per frame in flight, rewritten only where something changed, so
+// recording costs one vkCmdDrawIndexedIndirect(Count) per (pipeline, index type) batch
+// whatever the number of draws. Per draw data reaches the shader through the instance
+// stream: the firstInstance of every command points at its draw's InstanceData.
+// The list owns the draws, their commands and the batches, what picks the drawn commands is
+// left to collaborators created on demand:
+// - CullingPass : the commands go through FrustumCuller first, dispatched by update_before_frame()
+//   (outside the render pass), and the draws read its output instead. With occlusion culling
+//   record() splits the render pass: it draws what was visible last frame, builds the depth
+//   pyramid from it, culls the rest against it and draws what is left.
+// - LodSelector : the draws not split into meshlets pick a level of their model every frame.
+// - HlodSwitcher : groups of static draws far from the camera are swapped for one proxy draw each.
+// With cluster culling a culled draw becomes one command per meshlet of its model, each
+// tested on its own (frustum, normal cone, occlusion) so only the visible parts are drawn.
+class IndirectDrawList : public Component {
+public:
+	// `max_commands` bounds the draws once split into meshlets, 0 : `max_draws`.
+	IndirectDrawList(CoreInstance& core, uint32_t max_draws, uint32_t max_commands = 0);
+	~IndirectDrawList();
+
+	//-----------------
+	//  Component class
+	//-----------------
+	void			update_before_frame(FrameUpdateData& update_data) override;
+	void			update(FrameUpdateData& update_data) override;
+
+	//-----------------
+	//  Draws
+	//-----------------
+	// The model has to outlive the list, returns the draw id.
+	uint32_t		add(Model& model, const glm::mat4& transform);
+	void			set_transform(uint32_t draw, const glm::mat4& transform);
+	void			clear();
+	inline uint32_t	draw_count() const { return static_cast<uint32_t>(m_draws.size()); }
+	inline uint32_t	command_count() const { return static_cast<uint32_t>(m_commands.size()); }
+
+	// Picked from the device features, the first one available wins.
+	enum class Path {
+		INDIRECT_COUNT,			// vkCmdDrawIndexedIndirectCountKHR, the count is read from the buffer
+		MULTI_DRAW_INDIRECT,	// vkCmdDrawIndexedIndirect with drawCount > 1
+		SINGLE_DRAW_INDIRECT,	// no multiDrawIndirect : one indirect call per draw
+		DIRECT,					// no drawIndirectFirstInstance : vkCmdDrawIndexed per draw
+	};
+	inline Path		path() const { return m_path; }
+	void			record(VkCommandBuffer cmdBuf, VkPipelineLayout pipeline_layout, uint32_t frame);
+
+	//-----------------
+	//  Culling
+	//-----------------
+	// `view_projection` is what the transforms are multiplied with in the vertex shader
+	// (proj * view * model of the uniform). Needs one of the indirect paths.
+	void			enable_frustum_culling(const glm::mat4& view_projection);
+	inline void		set_view_projection(const glm::mat4& view_projection) { m_view_projection = view_projection; }
+	// Frustum culling plus the two phase Hi-Z occlusion culling, on the depth of `renderer`.
+	// The renderer has to outlive the list.
+	void			enable_occlusion_culling(Renderer& renderer, const glm::mat4& view_projection);
+	// Culled draws of models with meshlets are split into one command per meshlet.
+	// `backface` adds the normal cone test, only right for closed meshes or pipelines that
+	// cull back faces. Off by default : GraphicsPipeline uses VK_CULL_MODE_NONE, the back
+	// of an open mesh is visible and its meshlets must not be dropped.
+	void			enable_cluster_culling(bool backface = false);
+	// nullptr while culling is disabled, see FrustumCuller::last_stats().
+	inline const FrustumCuller* culler() const { return m_culling ? &m_culling->culler() : nullptr; }
+	// nullptr without occlusion culling, see DepthPyramid::last_build_ms().
+	inline const DepthPyramid* pyramid() const { return m_culling ? m_culling->pyramid() : nullptr; }
+
+	//-----------------
+	//  LOD
+	//-----------------
+	// Every frame, each draw not split into meshlets takes the coarsest level of its model
+	// whose error projects under `max_pixel_error` pixels, seen through set_view_projection()
+	// on a viewport `viewport_height` pixels tall.
+	void			enable_lod_selection(float viewport_height, float max_pixel_error = 1.0f);
+	// nullptr while LOD selection is disabled, see LodSelector::stats().
+	inline const LodSelector* lod_selector() const { return m_lod.get(); }
+
+	//-----------------
+	//  HLOD
+	//-----------------
+	// `proxy` (world space vertices, see HlodBuilder) is drawn instead of the static draws
+	// `members` while the camera, taken from set_view_projection(), is farther than `distance`
+	// from their bounding sphere. A draw belongs to one cluster at most. Returns the cluster id.
+	uint32_t		add_hlod(Model& proxy, const std::vector<uint32_t>& members, float distance);
+	// See HlodSwitcher::stats().
+	inline const HlodSwitcher& hlod_switcher() const { return m_hlod; }
+
+private:
+	// Commands of a batch are contiguous, they share the pipeline and the index buffer.
+	struct Batch {
+		VkPipeline	pipeline = VK_NULL_HANDLE;
+		VkIndexType	index_type = VK_INDEX_TYPE_UINT32;
+		uint32_t	first_command = 0;
+		uint32_t	command_count = 0;
+	};
+
+	CoreInstance&	m_core_instance;
+	uint32_t		m_max_draws = 0;
+	uint32_t		m_max_commands = 0;
+	uint32_t		m_max_draw_indirect_count = 1;
+	Path			m_path = Path::DIRECT;
+
+	std::vector<IndirectDraw>					m_draws;
+	// CPU copies of a frame's content. Commands and cull objects are in command order, the
+	// instances in draw order (the draws' commands are contiguous, in the same order).
+	std::vector<VkDrawIndexedIndirectCommand>	m_commands;
+	std::vector<InstanceData>					m_instances;
+	std::vector<FrustumCuller::Object>			m_objects;
+	std::vector<Batch>							m_batches;
+
+	// Per frame : [ commands | instances | batch counts | cull objects ]
+	BufferHandle	m_buffer;
+	VkDeviceSize	m_frame_size = 0;
+	VkDeviceSize	m_instance_offset = 0;
+	VkDeviceSize	m_count_offset = 0;
+	VkDeviceSize	m_object_offset = 0;
+
+	std::unique_ptr<CullingPass>	m_culling;
+	bool							m_clusters = false;
+	bool							m_cone_culling = false;
+	std::unique_ptr<LodSelector>	m_lod;
+	std::vector<uint32_t>			m_lod_switched;		// scratch of select_lods()
+	HlodSwitcher					m_hlod;
+	glm::mat4						m_view_projection{ 1.0f };
+	// Compacted output, only when every batch fits one vkCmdDrawIndexedIndirectCount.
+	bool							m_compact = false;
+
+	// Every change gets a version, a frame copies what changed since the version it holds.
+	uint64_t									m_version = 0;
+	uint64_t									m_layout_version = 0;	// last add / clear
+	std::vector<uint64_t>						m_frame_versions;
+	std::vector<std::pair<uint64_t, uint32_t>>	m_changes;				// (version, draw id)
+	bool										m_layout_dirty = false;
+
+	void			build_layout();
+	void			sync(uint32_t frame);
+	void			write_draw(uint8_t* frame_data, uint32_t draw);
+	void			record_batches(VkCommandBuffer cmdBuf, VkPipelineLayout pipeline_layout, uint32_t frame, bool culled, bool late);
+	void			write_objects(const IndirectDraw& draw, uint32_t batch);
+	// Rewrites the commands of the draws LodSelector switched.
+	void			select_lods();
+	void			set_hidden(uint32_t draw, bool hidden);
+};
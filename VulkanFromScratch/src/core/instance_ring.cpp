@@ -0,0 +1,65 @@
+#include "instance_ring.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <algorithm>
+
+InstanceRing::~InstanceRing()
+{
+    cleanup();
+}
+
+void InstanceRing::init(CoreInstance& core_instance, uint32_t frame_count, uint32_t instances_per_frame)
+{
+    m_core_instance = &core_instance;
+    m_frame_capacity = instances_per_frame;
+
+    createBuffer(
+        core_instance,
+        static_cast<VkDeviceSize>(sizeof(InstanceData)) * m_frame_capacity * frame_count,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        MemoryUsage::DYNAMIC,  // read once per vertex batch, straight from host visible memory
+        m_buffer,
+        m_allocation);
+
+    // Every region starts with the identity, it is never overwritten.
+    InstanceData identity = InstanceData::from_matrix(glm::mat4(1.0f));
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        static_cast<InstanceData*>(m_allocation.mapped)[static_cast<size_t>(frame) * m_frame_capacity + IDENTITY_INSTANCE] = identity;
+    }
+    begin_frame(0);
+}
+
+void InstanceRing::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    printf("[InstanceRing] peak %u / %u instances per frame \n", m_peak, m_frame_capacity);
+    destroyBuffer(*m_core_instance, m_buffer, m_allocation);
+    m_core_instance = nullptr;
+}
+
+void InstanceRing::begin_frame(uint32_t frame)
+{
+    m_peak = std::max(m_peak, m_head);
+    m_frame = frame;
+    m_head = IDENTITY_INSTANCE + 1;
+}
+
+InstanceRing::Allocation InstanceRing::allocate(uint32_t count)
+{
+    if (m_head + count > m_frame_capacity) {
+        throw std::runtime_error("instance ring is full for this frame!");
+    }
+    Allocation allocation{};
+    allocation.data = region() + m_head;
+    allocation.first_instance = m_head;
+    m_head += count;
+    return allocation;
+}
+
+void InstanceRing::bind(VkCommandBuffer cmdBuf)
+{
+    // firstInstance counts from the start of the bound region.
+    VkDeviceSize offset = static_cast<VkDeviceSize>(sizeof(InstanceData)) * m_frame_capacity * m_frame;
+    vkCmdBindVertexBuffers(cmdBuf, INSTANCE_BINDING, 1, &m_buffer, &offset);
+}
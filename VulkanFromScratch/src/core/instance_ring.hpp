@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include "./core/memory_allocator.hpp"
+#include "./core/vertex_format.hpp"
+
+class CoreInstance;
+
+// Per frame linear allocator for the per instance vertex stream (InstanceData, binding 1).
+// Works like UniformRing: every frame in flight owns a region of one persistently mapped
+// buffer, bound once per frame. Draws select their slice with firstInstance, so a
+// thousand copies of a mesh are one vkCmdDrawIndexed. Instance 0 of every region is the
+// identity, draws that are not instanced use it.
+class InstanceRing {
+public:
+	InstanceRing() = default;
+	~InstanceRing();
+
+	struct Allocation {
+		InstanceData*	data = nullptr;		// write `count` instances here
+		uint32_t		first_instance = 0;	// firstInstance of the draw
+	};
+
+	void init(CoreInstance& core_instance, uint32_t frame_count, uint32_t instances_per_frame);
+	void cleanup();
+
+	// Call once the fence of `frame` has signaled.
+	void		begin_frame(uint32_t frame);
+	Allocation	allocate(uint32_t count);
+	// Binds the region of the current frame to binding 1.
+	void		bind(VkCommandBuffer cmdBuf);
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	inline uint32_t instances_used() const { return m_head; }
+	inline uint32_t capacity() const { return m_frame_capacity; }
+
+	static const uint32_t IDENTITY_INSTANCE = 0;
+	static const uint32_t INSTANCE_BINDING = 1;
+
+private:
+	CoreInstance*		m_core_instance = nullptr;
+	VkBuffer			m_buffer = VK_NULL_HANDLE;
+	MemoryAllocation	m_allocation;
+	uint32_t			m_frame_capacity = 0;
+	uint32_t			m_frame = 0;
+	uint32_t			m_head = 0;		// instances used in the current frame's region
+	uint32_t			m_peak = 0;
+
+	inline InstanceData* region() const {
+		return static_cast<InstanceData*>(m_allocation.mapped) + static_cast<size_t>(m_frame) * m_frame_capacity;
+	}
+};
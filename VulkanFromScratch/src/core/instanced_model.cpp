@@ -0,0 +1,33 @@
+#include "instanced_model.hpp"
+#include <cstring>
+
+InstancedModel::InstancedModel(CoreInstance& core, Model& model) : m_core_instance{ core }, m_model{ model }
+{
+}
+
+void InstancedModel::update(FrameUpdateData& update_data)
+{
+    if (m_instances.empty()) return;
+
+    auto slice = m_core_instance.instance_ring().allocate(instance_count());
+    memcpy(slice.data, m_instances.data(), m_instances.size() * sizeof(InstanceData));
+
+    m_model.bind(update_data.m_cmdbuffer, update_data.m_pipeline_layout);
+    m_model.draw_instanced(update_data.m_cmdbuffer, slice.first_instance, instance_count());
+}
+
+uint32_t InstancedModel::add_instance(const glm::mat4& transform)
+{
+    m_instances.push_back(InstanceData::from_matrix(transform));
+    return instance_count() - 1;
+}
+
+void InstancedModel::set_transform(uint32_t instance, const glm::mat4& transform)
+{
+    m_instances[instance] = InstanceData::from_matrix(transform);
+}
+
+void InstancedModel::clear()
+{
+    m_instances.clear();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "core/core_fwd.h"
+#include <vector>
+#include <glm.hpp>
+
+// Draws many copies of one Model with a single instanced draw.
+// The transforms are copied into CoreInstance::instance_ring() every frame, the copies
+// need no Model, TransformObject or descriptor set of their own.
+class InstancedModel : public Component {
+public:
+	InstancedModel(CoreInstance& core, Model& model);
+
+	//-----------------
+	//  Component class
+	//-----------------
+	void			update(FrameUpdateData& update_data) override;
+
+	//-----------------
+	//  Instances
+	//-----------------
+	uint32_t		add_instance(const glm::mat4& transform);
+	void			set_transform(uint32_t instance, const glm::mat4& transform);
+	void			clear();
+	inline uint32_t	instance_count() const { return static_cast<uint32_t>(m_instances.size()); }
+
+private:
+	CoreInstance&				m_core_instance;
+	Model&						m_model;
+	// Already in the stream layout, a frame only memcpy's them.
+	std::vector<InstanceData>	m_instances;
+};
@@ -0,0 +1,52 @@
+#include "lod_selector.hpp"
+#include "core/core_fwd.h"
+#include <cstdio>
+
+LodSelector::LodSelector(float viewport_height, float max_pixel_error)
+    : m_pixel_scale{ viewport_height * 0.5f }, m_max_pixel_error{ max_pixel_error }
+{
+}
+
+LodSelector::~LodSelector()
+{
+    if (m_frames > 0) {
+        printf("[LOD] %llu frame(s), %.1f%% of the LOD 0 triangles selected on average \n", static_cast<unsigned long long>(m_frames),
+            m_total_full_triangles > 0 ? 100.0 * m_total_triangles / m_total_full_triangles : 100.0);
+    }
+}
+
+void LodSelector::select(const glm::mat4& view_projection, std::vector<IndirectDraw>& draws, std::vector<uint32_t>& switched)
+{
+    // Rows of the view projection (glm is column major) : y scales the projected size, w is the depth.
+    glm::vec4 row_y(view_projection[0][1], view_projection[1][1], view_projection[2][1], view_projection[3][1]);
+    glm::vec4 row_w(view_projection[0][3], view_projection[1][3], view_projection[2][3], view_projection[3][3]);
+    const float focal = glm::length(glm::vec3(row_y)) * m_pixel_scale;
+    const float depth_scale = glm::length(glm::vec3(row_w));
+
+    m_stats = Stats();
+    for (uint32_t id = 0; id < draws.size(); id++) {
+        IndirectDraw& draw = draws[id];
+        const Model& model = *draw.model;
+        if (!draw.proxy) m_stats.full_triangles += model.lod(0).index_count / 3;
+        if (draw.hidden) continue;
+        if (!draw.split) {
+            // Nearest depth of the bounding sphere, a camera inside it keeps LOD 0.
+            const glm::vec4 sphere = world_sphere(draw, model.bounding_sphere());
+            float depth = glm::dot(row_w, glm::vec4(glm::vec3(sphere), 1.0f)) - sphere.w * depth_scale;
+            uint32_t level = depth > 0.0f ? model.select_lod(max_scale(draw.transform) * focal / depth, m_max_pixel_error, draw.lod) : 0;
+            if (level != draw.lod) {
+                draw.lod = level;
+                switched.push_back(id);
+                m_stats.switches++;
+            }
+        }
+        m_stats.triangles += model.lod(draw.lod).index_count / 3;
+    }
+}
+
+void LodSelector::count_frame()
+{
+    m_frames++;
+    m_total_triangles += m_stats.triangles;
+    m_total_full_triangles += m_stats.full_triangles;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "core/indirect_draw.hpp"
+
+// LOD selection of IndirectDrawList (see IndirectDrawList::enable_lod_selection).
+// Every frame, each draw not split into meshlets takes the coarsest level of its model whose
+// error projects under `max_pixel_error` pixels, on a viewport `viewport_height` pixels tall.
+class LodSelector {
+public:
+	LodSelector(float viewport_height, float max_pixel_error);
+	~LodSelector();
+
+	// Updates IndirectDraw::lod, the ids of the draws that switched are appended to `switched`.
+	void			select(const glm::mat4& view_projection, std::vector<IndirectDraw>& draws, std::vector<uint32_t>& switched);
+	// Adds the last selection to the average printed at destruction, once per recorded frame.
+	void			count_frame();
+
+	struct Stats {
+		uint32_t	triangles = 0;			// selected, before culling
+		uint32_t	full_triangles = 0;		// at LOD 0, without the HLOD proxies
+		uint32_t	switches = 0;
+	};
+	// Last selection
+	inline const Stats& stats() const { return m_stats; }
+
+private:
+	float			m_pixel_scale = 0.0f;	// half the viewport height
+	float			m_max_pixel_error = 1.0f;
+	Stats			m_stats;
+	uint64_t		m_frames = 0;
+	uint64_t		m_total_triangles = 0;
+	uint64_t		m_total_full_triangles = 0;
+};
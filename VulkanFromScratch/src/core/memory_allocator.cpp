@@ -0,0 +1,398 @@
+#include "memory_allocator.hpp"
+#include "core_instance.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+
+//----------------------
+//  Other function
+//----------------------
+static VkDeviceSize next_pow2(VkDeviceSize v) {
+    VkDeviceSize p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+static uint32_t log2_of(VkDeviceSize v) {
+    uint32_t l = 0;
+    while (v > 1) { v >>= 1; l++; }
+    return l;
+}
+
+MemoryPolicy::MemoryPolicy(MemoryUsage usage)
+{
+    switch (usage) {
+    case MemoryUsage::GPU_ONLY:
+        required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        avoid = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        break;
+    case MemoryUsage::UPLOAD:
+        // plain system memory, keep the small BAR heap free for dynamic data
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        avoid = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MemoryUsage::READBACK:
+        // cached memory makes CPU reads fast
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MemoryUsage::DYNAMIC:
+        // device local + host visible (ReBAR) lets the GPU read it at VRAM speed
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        avoid = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    }
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    cleanup();
+}
+
+void MemoryAllocator::init(CoreInstance& core_instance)
+{
+    m_core_instance = &core_instance;
+    m_device = core_instance.get_device();
+    m_memory_properties = core_instance.get_memory_properties();
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(core_instance.get_physical_device(), &properties);
+    m_buffer_image_granularity = properties.limits.bufferImageGranularity;
+    m_max_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+    m_heap_stats.resize(m_memory_properties.memoryHeapCount);
+}
+
+void MemoryAllocator::cleanup()
+{
+    if (m_device == VK_NULL_HANDLE) return;
+
+    // Every block goes, block 0 included (free() keeps it alive while the allocator runs).
+    for (auto& pool : m_pools) {
+        for (auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            if (block.allocation_count > 0) {
+                printf("[!] MemoryAllocator: %u allocation(s) still alive in memory type %u \n", block.allocation_count, pool.memory_type);
+            }
+            free_device_memory(block.memory, pool.block_size, pool.memory_type);
+            block.memory = VK_NULL_HANDLE;
+        }
+    }
+    m_pools.clear();
+    if (!m_dedicated.empty()) {
+        printf("[!] MemoryAllocator: %zu dedicated allocation(s) still alive \n", m_dedicated.size());
+    }
+    for (const Dedicated& dedicated : m_dedicated) {
+        free_device_memory(dedicated.memory, dedicated.size, dedicated.memory_type);
+    }
+    m_dedicated.clear();
+    m_device = VK_NULL_HANDLE;
+    m_core_instance = nullptr;
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, const MemoryPolicy& policy, bool is_linear)
+{
+    MemoryAllocation allocation{};
+    allocation.memory_type = m_core_instance->find_memory_type(requirements.memoryTypeBits, policy, requirements.size);
+
+    // When the granularity is 1 linear and optimal resources may live side by side.
+    if (m_buffer_image_granularity <= 1) {
+        is_linear = true;
+    }
+    allocation.pool = get_pool(allocation.memory_type, is_linear);
+    Pool& pool = m_pools[allocation.pool];
+
+    // Buddy nodes are power of two sized and aligned to their own size,
+    // so rounding up also takes care of the alignment requirement.
+    VkDeviceSize node_size = next_pow2(std::max({ requirements.size, requirements.alignment, MIN_NODE_SIZE }));
+
+    //---------------
+    //  Dedicated allocation for big resources
+    //---------------
+    if (node_size > pool.block_size / 2) {
+        allocation.memory = allocate_device_memory(requirements.size, allocation.memory_type, &allocation.mapped);
+        allocation.size = requirements.size;
+        allocation.block = UINT32_MAX;
+        m_dedicated.push_back(Dedicated{ allocation.memory, allocation.size, allocation.memory_type });
+        auto& stats = m_heap_stats[heap_of(allocation.memory_type)];
+        stats.allocation_count++;
+        stats.allocation_bytes += allocation.size;
+        return allocation;
+    }
+
+    //---------------
+    //  Sub allocate from blocks
+    //---------------
+    uint32_t level = log2_of(pool.block_size / node_size);
+    bool found = false;
+    for (uint32_t i = 0; i < pool.blocks.size() && !found; i++) {
+        found = try_allocate_in_block(pool, i, level, allocation);
+    }
+    if (!found) {
+        uint32_t block_idx = create_block(pool);
+        found = try_allocate_in_block(pool, block_idx, level, allocation);
+    }
+    if (!found) {
+        throw std::runtime_error("failed to sub-allocate device memory!");
+    }
+
+    auto& stats = m_heap_stats[heap_of(allocation.memory_type)];
+    stats.allocation_count++;
+    stats.allocation_bytes += allocation.size;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+    if (!allocation.is_valid()) return;
+
+    auto& stats = m_heap_stats[heap_of(allocation.memory_type)];
+    stats.allocation_count--;
+    stats.allocation_bytes -= allocation.size;
+
+    if (allocation.block == UINT32_MAX) {
+        m_dedicated.erase(std::find_if(m_dedicated.begin(), m_dedicated.end(),
+            [&](const Dedicated& dedicated) { return dedicated.memory == allocation.memory; }));
+        free_device_memory(allocation.memory, allocation.size, allocation.memory_type);
+        allocation = MemoryAllocation{};
+        return;
+    }
+
+    Pool& pool = m_pools[allocation.pool];
+    Block& block = pool.blocks[allocation.block];
+
+    // Merge with the buddy as long as it is free too.
+    VkDeviceSize offset = allocation.offset;
+    uint32_t level = allocation.level;
+    while (level > 0) {
+        VkDeviceSize buddy = offset ^ (pool.block_size >> level);
+        auto it = block.free_nodes[level].find(buddy);
+        if (it == block.free_nodes[level].end()) break;
+        block.free_nodes[level].erase(it);
+        offset = std::min(offset, buddy);
+        level--;
+    }
+    block.free_nodes[level].insert(offset);
+    block.allocation_count--;
+    block.used_bytes -= allocation.size;
+
+    // Keep the first block of a pool around to avoid vkAllocateMemory thrashing,
+    // release the others as soon as they become empty.
+    if (block.allocation_count == 0 && allocation.block != 0) {
+        free_device_memory(block.memory, pool.block_size, pool.memory_type);
+        block = Block{};
+    }
+    allocation = MemoryAllocation{};
+}
+
+uint32_t MemoryAllocator::get_pool(uint32_t memory_type, bool is_linear)
+{
+    for (uint32_t i = 0; i < m_pools.size(); i++) {
+        if (m_pools[i].memory_type == memory_type && m_pools[i].is_linear == is_linear) {
+            return i;
+        }
+    }
+
+    Pool pool{};
+    pool.memory_type = memory_type;
+    pool.is_linear = is_linear;
+
+    // Small heaps (e.g. the 256MB host visible + device local heap) get smaller blocks
+    // so a single block never eats a large part of the heap.
+    VkDeviceSize heap_size = m_memory_properties.memoryHeaps[heap_of(memory_type)].size;
+    pool.block_size = DEFAULT_BLOCK_SIZE;
+    while (pool.block_size > 1024 * 1024 && pool.block_size > heap_size / 8) {
+        pool.block_size >>= 1;
+    }
+    pool.level_count = log2_of(pool.block_size / MIN_NODE_SIZE) + 1;
+
+    m_pools.push_back(pool);
+    return static_cast<uint32_t>(m_pools.size() - 1);
+}
+
+uint32_t MemoryAllocator::create_block(Pool& pool)
+{
+    Block block{};
+    block.memory = allocate_device_memory(pool.block_size, pool.memory_type, &block.mapped);
+    block.free_nodes.resize(pool.level_count);
+    block.free_nodes[0].insert(0); // the whole block is one free node
+
+    // Reuse the slot of a released block, allocations refer to blocks by index.
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        if (pool.blocks[i].memory == VK_NULL_HANDLE) {
+            pool.blocks[i] = std::move(block);
+            return i;
+        }
+    }
+    pool.blocks.push_back(std::move(block));
+    return static_cast<uint32_t>(pool.blocks.size() - 1);
+}
+
+bool MemoryAllocator::try_allocate_in_block(Pool& pool, uint32_t block_idx, uint32_t level, MemoryAllocation& allocation)
+{
+    Block& block = pool.blocks[block_idx];
+    if (block.memory == VK_NULL_HANDLE) return false;
+
+    // Find the smallest free node that is still big enough.
+    int l = static_cast<int>(level);
+    while (l >= 0 && block.free_nodes[l].empty()) l--;
+    if (l < 0) return false;
+
+    VkDeviceSize offset = *block.free_nodes[l].begin();
+    block.free_nodes[l].erase(block.free_nodes[l].begin());
+
+    // Split it down to the requested level, the upper halves become free buddies.
+    while (static_cast<uint32_t>(l) < level) {
+        l++;
+        block.free_nodes[l].insert(offset + (pool.block_size >> l));
+    }
+
+    block.allocation_count++;
+    block.used_bytes += pool.block_size >> level;
+    allocation.memory = block.memory;
+    allocation.offset = offset;
+    allocation.size = pool.block_size >> level;
+    allocation.block = block_idx;
+    allocation.level = level;
+    allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+    return true;
+}
+
+VkDeviceMemory MemoryAllocator::allocate_device_memory(VkDeviceSize size, uint32_t memory_type, void** mapped)
+{
+    if (m_device_allocation_count >= m_max_allocation_count) {
+        throw std::runtime_error("maxMemoryAllocationCount exceeded!");
+    }
+
+    // find_memory_type already steers away from full heaps, this is the last warning before the driver starts paging.
+    if (m_core_instance->is_heap_over_budget(heap_of(memory_type), size)) {
+        printf("[!] MemoryAllocator: heap %u goes over its memory budget \n", heap_of(memory_type));
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memory_type;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_device, &allocInfo, m_core_instance->allocation_callbacks(), &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+    m_device_allocation_count++;
+
+    // Host visible blocks stay mapped for their whole life,
+    // a memory object can only be mapped once so sub allocations share this pointer.
+    *mapped = nullptr;
+    if (m_memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    }
+
+    auto& stats = m_heap_stats[heap_of(memory_type)];
+    stats.block_count++;
+    stats.block_bytes += size;
+    m_core_instance->track_heap_usage(heap_of(memory_type), static_cast<int64_t>(size));
+    return memory;
+}
+
+void MemoryAllocator::free_device_memory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type)
+{
+    // Freeing a mapped memory object implicitly unmaps it.
+    vkFreeMemory(m_device, memory, m_core_instance->allocation_callbacks());
+    m_device_allocation_count--;
+
+    auto& stats = m_heap_stats[heap_of(memory_type)];
+    stats.block_count--;
+    stats.block_bytes -= size;
+    m_core_instance->track_heap_usage(heap_of(memory_type), -static_cast<int64_t>(size));
+}
+
+uint32_t MemoryAllocator::least_used_block(const Pool& pool) const
+{
+    // Block 0 is never released, emptying it would not give anything back.
+    uint32_t source = UINT32_MAX;
+    for (uint32_t i = 1; i < pool.blocks.size(); i++) {
+        const Block& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE) continue;
+        if (source == UINT32_MAX || block.used_bytes < pool.blocks[source].used_bytes) {
+            source = i;
+        }
+    }
+    return source;
+}
+
+MemoryAllocator::FragmentationStats MemoryAllocator::get_fragmentation_stats() const
+{
+    FragmentationStats stats{};
+    for (const auto& pool : m_pools) {
+        for (const auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.block_count++;
+            stats.free_bytes += pool.block_size - block.used_bytes;
+            for (uint32_t l = 0; l < block.free_nodes.size(); l++) {
+                if (block.free_nodes[l].empty()) continue;
+                stats.largest_free = std::max(stats.largest_free, pool.block_size >> l);
+                break;
+            }
+        }
+    }
+    return stats;
+}
+
+bool MemoryAllocator::is_move_candidate(const MemoryAllocation& allocation) const
+{
+    if (!allocation.is_valid() || allocation.block == UINT32_MAX) return false;
+    return least_used_block(m_pools[allocation.pool]) == allocation.block;
+}
+
+bool MemoryAllocator::allocate_for_move(const VkMemoryRequirements& requirements, const MemoryAllocation& current, MemoryAllocation& moved)
+{
+    if (current.block == UINT32_MAX) return false;
+    if ((requirements.memoryTypeBits & (1u << current.memory_type)) == 0) return false;
+
+    Pool& pool = m_pools[current.pool];
+    VkDeviceSize node_size = next_pow2(std::max({ requirements.size, requirements.alignment, MIN_NODE_SIZE }));
+    if (node_size > pool.block_size / 2) return false;
+    uint32_t level = log2_of(pool.block_size / node_size);
+
+    // Fullest blocks first, so the allocations end up packed in as few blocks as possible.
+    std::vector<uint32_t> targets;
+    for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+        if (i == current.block || pool.blocks[i].memory == VK_NULL_HANDLE) continue;
+        if (pool.blocks[i].used_bytes < pool.blocks[current.block].used_bytes) continue;
+        targets.push_back(i);
+    }
+    std::sort(targets.begin(), targets.end(), [&pool](uint32_t a, uint32_t b) {
+        return pool.blocks[a].used_bytes > pool.blocks[b].used_bytes;
+    });
+
+    moved = MemoryAllocation{};
+    moved.memory_type = current.memory_type;
+    moved.pool = current.pool;
+    for (uint32_t block_idx : targets) {
+        if (try_allocate_in_block(pool, block_idx, level, moved)) {
+            auto& stats = m_heap_stats[heap_of(moved.memory_type)];
+            stats.allocation_count++;
+            stats.allocation_bytes += moved.size;
+            return true;
+        }
+    }
+    moved = MemoryAllocation{};
+    return false;
+}
+
+MemoryAllocator::HeapStats MemoryAllocator::get_heap_stats(uint32_t heap_index) const
+{
+    return m_heap_stats[heap_index];
+}
+
+void MemoryAllocator::print_stats() const
+{
+    for (uint32_t i = 0; i < m_heap_stats.size(); i++) {
+        const auto& stats = m_heap_stats[i];
+        printf("[Memory] heap %u : %u block(s) %.2f MB reserved, %u allocation(s) %.2f MB used \n",
+            i,
+            stats.block_count, stats.block_bytes / (1024.0 * 1024.0),
+            stats.allocation_count, stats.allocation_bytes / (1024.0 * 1024.0));
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <set>
+#include <cstdint>
+
+class CoreInstance;
+
+// Usage hints understood by CoreInstance::find_memory_type.
+enum class MemoryUsage {
+	GPU_ONLY,	// written by transfers / the GPU only (textures, static geometry)
+	UPLOAD,		// CPU writes once, GPU copies from it (staging)
+	READBACK,	// GPU writes, CPU reads (queries, statistics)
+	DYNAMIC,	// CPU rewrites it every frame and the GPU reads it directly (uniforms)
+};
+
+// Memory type selection policy: a type must contain all `required` flags, gets a bonus
+// for every `preferred` flag and a penalty for every `avoid` flag.
+struct MemoryPolicy {
+	VkMemoryPropertyFlags required = 0;
+	VkMemoryPropertyFlags preferred = 0;
+	VkMemoryPropertyFlags avoid = 0;
+
+	MemoryPolicy() = default;
+	MemoryPolicy(VkMemoryPropertyFlags required_flags) : required{ required_flags } {}
+	MemoryPolicy(VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags, VkMemoryPropertyFlags avoid_flags)
+		: required{ required_flags }, preferred{ preferred_flags }, avoid{ avoid_flags } {}
+	MemoryPolicy(MemoryUsage usage);
+};
+
+// A piece of device memory handed out by MemoryAllocator.
+// Buffers/images are bound with (memory, offset) instead of owning a VkDeviceMemory.
+struct MemoryAllocation {
+	VkDeviceMemory	memory = VK_NULL_HANDLE;
+	VkDeviceSize	offset = 0;
+	VkDeviceSize	size = 0;			// size of the buddy node (>= requested size)
+	void*			mapped = nullptr;	// persistent mapping, nullptr if not host visible
+	uint32_t		memory_type = 0;
+	uint32_t		pool = 0;			// index into MemoryAllocator::m_pools
+	uint32_t		block = UINT32_MAX;	// UINT32_MAX => dedicated allocation
+	uint32_t		level = 0;			// buddy level inside the block
+
+	inline bool is_valid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// Block based device memory allocator.
+// Every memory type gets its own list of large VkDeviceMemory blocks that are
+// sub-allocated with a buddy allocator, so loading thousands of meshes only costs
+// a handful of vkAllocateMemory calls (and stays far below maxMemoryAllocationCount).
+class MemoryAllocator {
+public:
+	MemoryAllocator() = default;
+	~MemoryAllocator();
+
+	struct HeapStats {
+		uint32_t		block_count = 0;		// vkAllocateMemory calls alive on this heap
+		uint32_t		allocation_count = 0;	// sub allocations alive on this heap
+		VkDeviceSize	block_bytes = 0;		// bytes reserved from the driver
+		VkDeviceSize	allocation_bytes = 0;	// bytes handed out to resources
+	};
+
+	void init(CoreInstance& core_instance);
+	void cleanup();
+
+	//--------------------
+	//  Allocation
+	//--------------------
+	// is_linear : buffers and linear images. Kept apart from optimal images so
+	// that neighbours never violate bufferImageGranularity.
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, const MemoryPolicy& policy, bool is_linear = true);
+	void free(MemoryAllocation& allocation);
+
+	//--------------------
+	//  Defragmentation
+	//--------------------
+	struct FragmentationStats {
+		uint32_t		block_count = 0;	// sub allocated blocks (dedicated allocations are not counted)
+		VkDeviceSize	free_bytes = 0;		// unused bytes inside those blocks
+		VkDeviceSize	largest_free = 0;	// biggest single free node
+		// 0 when all free space is one node, close to 1 when it is spread in small holes.
+		inline float fragmentation() const { return free_bytes == 0 ? 0.0f : 1.0f - float(largest_free) / float(free_bytes); }
+	};
+	FragmentationStats get_fragmentation_stats() const;
+	// True when the allocation sits in the emptiest block of its pool, i.e. moving
+	// it out brings that block closer to being released.
+	bool is_move_candidate(const MemoryAllocation& allocation) const;
+	// Sub allocates room for a moved copy of `current` in one of the fuller blocks of the same pool.
+	// Never creates a block, returns false when the other blocks are too full.
+	bool allocate_for_move(const VkMemoryRequirements& requirements, const MemoryAllocation& current, MemoryAllocation& moved);
+
+	HeapStats get_heap_stats(uint32_t heap_index) const;
+	inline uint32_t heap_count() const { return m_memory_properties.memoryHeapCount; }
+	void print_stats() const;
+
+	// Block size used for heaps large enough to hold it. Allocations bigger than
+	// half a block get their own dedicated VkDeviceMemory.
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+	static constexpr VkDeviceSize MIN_NODE_SIZE = 256;
+
+private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		uint32_t allocation_count = 0;
+		VkDeviceSize used_bytes = 0;
+		// free_nodes[level] holds the offsets of the free buddy nodes of size (block_size >> level)
+		std::vector<std::set<VkDeviceSize>> free_nodes;
+	};
+	struct Pool {
+		uint32_t memory_type = 0;
+		bool is_linear = true;
+		VkDeviceSize block_size = 0;
+		uint32_t level_count = 0;
+		std::vector<Block> blocks;
+	};
+	struct Dedicated {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memory_type = 0;
+	};
+
+	CoreInstance*						m_core_instance = nullptr;
+	VkDevice							m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties	m_memory_properties{};
+	VkDeviceSize						m_buffer_image_granularity = 1;
+	uint32_t							m_max_allocation_count = 0;
+	uint32_t							m_device_allocation_count = 0;
+	std::vector<Pool>					m_pools;
+	std::vector<Dedicated>				m_dedicated;	// alive dedicated allocations, released by cleanup()
+	std::vector<HeapStats>				m_heap_stats;
+
+	uint32_t get_pool(uint32_t memory_type, bool is_linear);
+	uint32_t create_block(Pool& pool);
+	bool try_allocate_in_block(Pool& pool, uint32_t block_idx, uint32_t level, MemoryAllocation& allocation);
+	uint32_t least_used_block(const Pool& pool) const;
+	VkDeviceMemory allocate_device_memory(VkDeviceSize size, uint32_t memory_type, void** mapped);
+	void free_device_memory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type);
+	inline uint32_t heap_of(uint32_t memory_type) const { return m_memory_properties.memoryTypes[memory_type].heapIndex; }
+};
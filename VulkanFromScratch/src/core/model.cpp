@@ -1,175 +1,89 @@
 #include "model.hpp"
+#include "helper/mesh_cache.hpp"
 #include <stdexcept>
+#include <chrono>
+#include <algorithm>
 
-Model::Model(CoreInstance& _core, VkPipeline pipeline) : m_core_instance{ _core } , m_pipeline{pipeline}
+Model::Model(CoreInstance& _core, VkPipeline pipeline, const std::string& path, VertexFormat format) : m_core_instance{ _core } , m_pipeline{pipeline}
 {	
-	create_vertexBuffer();
-	create_indexBuffer();
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The cache is laid out like the pool buffers: the sections are copied from the
+	// mapping into the staging ring, nothing is parsed or copied in between.
+	// The mapping can go right after, upload_buffer() copies synchronously.
+	MappedMesh mesh;
+	bool imported = MeshCache::load(path, mesh, format);
+	if (mesh.index_count() == 0) {
+		throw std::runtime_error("failed to load model, mesh has no triangles!");
+	}
+	m_dequantization = mesh.dequantization();
+	m_bounds_min = glm::vec3(mesh.header().bounds_min[0], mesh.header().bounds_min[1], mesh.header().bounds_min[2]);
+	m_bounds_max = glm::vec3(mesh.header().bounds_max[0], mesh.header().bounds_max[1], mesh.header().bounds_max[2]);
+	m_meshlets.assign(mesh.meshlets(), mesh.meshlets() + mesh.meshlet_count());
+	m_lods.assign(mesh.lods(), mesh.lods() + mesh.lod_count());
+	m_geometry = m_core_instance.geometry_pool().allocate(
+		mesh.vertex_data(), mesh.vertex_count(), vertex_stride(format),
+		mesh.index_data(), mesh.index_count(), mesh.index_size());
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("[Model] %s : %u %s vertices %u indices (%s) %u meshlets %u LODs ready in %.2f ms (%s) \n",
+		path.c_str(), mesh.vertex_count(), vertex_format_name(format), m_lods[0].index_count,
+		m_geometry.index_size == 1 ? "u8" : m_geometry.index_size == 2 ? "u16" : "u32", mesh.meshlet_count(), lod_count(),
+		ms, imported ? "imported" : "cached");
 }
 
 Model::~Model()
 {
-	vkDestroyBuffer(m_core_instance.get_device(), m_vertexBuffer, nullptr);
-	vkDestroyBuffer(m_core_instance.get_device(), m_vertexBuffer, nullptr);
-	vkDestroyBuffer(m_core_instance.get_device(), m_indexBuffer, nullptr);
-	vkFreeMemory(m_core_instance.get_device(), m_indexBufferMemory, nullptr);
-	vkFreeMemory(m_core_instance.get_device(), m_vertexBufferMemory, nullptr);
-
+	// Retired through the deletion queue, frames in flight may still draw this model.
+	m_core_instance.geometry_pool().free(m_geometry);
 }
 
 void Model::update(FrameUpdateData& update_data)
 {
-	bind(update_data.m_cmdbuffer);
+	bind(update_data.m_cmdbuffer, update_data.m_pipeline_layout);
 	draw(update_data.m_cmdbuffer);
 }
 
 
-void Model::bind(const VkCommandBuffer& cmdBuf )
+void Model::bind(const VkCommandBuffer& cmdBuf, VkPipelineLayout pipeline_layout)
 {
 	vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+	// Packed positions are stored relative to the mesh bounds (identity for the full format).
+	vkCmdPushConstants(cmdBuf, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VertexDequantization), &m_dequantization);
 
-	VkBuffer vertexBuffers[] = { m_vertexBuffer };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(cmdBuf, 0, 1, vertexBuffers, offsets);
-	// the possible types are VK_INDEX_TYPE_UINT16 and VK_INDEX_TYPE_UINT32.
-	vkCmdBindIndexBuffer(cmdBuf , m_indexBuffer , 0 , VK_INDEX_TYPE_UINT16); //you can only have a single index buffer
+	// Models of the same index width draw back to back without any buffer bind.
+	m_core_instance.geometry_pool().bind_index_buffer(cmdBuf, m_geometry.index_type);
 }
 
 void Model::draw(const VkCommandBuffer& cmdBuf)
 {
 	//vkCmdDraw(cmdBuf, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-	vkCmdDrawIndexed(cmdBuf, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	draw_instanced(cmdBuf, InstanceRing::IDENTITY_INSTANCE, 1);
 }
 
-void Model::create_vertexBuffer()
+void Model::draw_instanced(const VkCommandBuffer& cmdBuf, uint32_t first_instance, uint32_t instance_count)
 {
-	uint32_t buffer_size = sizeof(vertices[0]) * vertices.size();
-	createBuffer(
-		m_core_instance.get_device(),
-		m_core_instance.get_physical_device(),
-		buffer_size,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		m_vertexBuffer,
-		m_vertexBufferMemory);
-	/*
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = sizeof(vertices[0]) * vertices.size();
-	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(
-		m_core_instance.get_device(),
-		&bufferInfo, nullptr, &m_vertexBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create vertex buffer!");
-	}
-
-	//----------------
-	//		Memory
-	//----------------
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(m_core_instance.get_device(), m_vertexBuffer, &memRequirements);
-
-	{
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		if (vkAllocateMemory(m_core_instance.get_device(), &allocInfo, nullptr, &m_vertexBufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
-		vkBindBufferMemory(m_core_instance.get_device(), m_vertexBuffer, m_vertexBufferMemory, 0);
-	}
-	*/
-	//----------------
-	//		Dtat mapping
-	//----------------
-	{
-		void* data; // pointer to the mapped memory
-		vkMapMemory(m_core_instance.get_device(), m_vertexBufferMemory, 0, buffer_size, 0, &data);
-		// The driver may not immediately copy the data into the buffer memory, for example because of caching. 
-		// It is also possible that writes to the buffer are not visible in the mapped memory yet. There are two
-		// ways to deal with that problem:
-		//		* Use a memory heap that is host coherent, indicated with VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		//		* Call vkFlushMappedMemoryRanges after writing to the mapped memory, and call vkInvalidateMappedMemoryRanges 
-		//		  before reading from the mapped memory
-		//memcpy(data, vertices.data(), (size_t)bufferInfo.size);
-		memcpy(data, vertices.data(), buffer_size);
-		vkUnmapMemory(m_core_instance.get_device(), m_vertexBufferMemory);
-
-		// Flushing memory ranges or using a coherent memory heap means that the driver will be aware of our writes to the buffer,
-		// but it doesn't mean that they are actually visible on the GPU yet. The transfer of data to the GPU is an operation that
-		// happens in the background and the specification simply tells us that it is guaranteed to be complete as of the next call
-		// to vkQueueSubmit.
-	}
-
+	const MeshLod& level = m_lods[m_lod];
+	vkCmdDrawIndexed(cmdBuf, level.index_count, instance_count, m_geometry.first_index + level.first_index, m_geometry.vertex_offset, first_instance);
 }
 
-void Model::create_indexBuffer()
+//----------------------
+//  LOD
+//----------------------
+void Model::set_lod(uint32_t level)
 {
-	VkBufferCreateInfo bufferInfo{};
-	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferInfo.size = sizeof(indices[0]) * indices.size();
-	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	if (vkCreateBuffer(
-		m_core_instance.get_device(),
-		&bufferInfo, nullptr, &m_indexBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create vertex buffer!");
-	}
-
-	//----------------
-	//		Memory
-	//----------------
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(m_core_instance.get_device(), m_indexBuffer, &memRequirements);
-	{
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		if (vkAllocateMemory(m_core_instance.get_device(), &allocInfo, nullptr, &m_indexBufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
-		}
-		vkBindBufferMemory(m_core_instance.get_device(), m_indexBuffer, m_indexBufferMemory, 0);
-	}
-
-	//----------------
-	//		Dtat mapping
-	//----------------
-	{
-		void* data; // pointer to the mapped memory
-		vkMapMemory(m_core_instance.get_device(), m_indexBufferMemory, 0, bufferInfo.size, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferInfo.size);
-		vkUnmapMemory(m_core_instance.get_device(), m_indexBufferMemory);
-	}
+	m_lod = std::min(level, lod_count() - 1);
 }
 
-uint32_t Model::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+uint32_t Model::select_lod(float pixels_per_unit, float max_pixels, uint32_t current) const
 {
-	/*
-	The VkPhysicalDeviceMemoryProperties structure has two arrays memoryTypes and memoryHeaps. 
-	Memory heaps are distinct memory resources like dedicated VRAM and swap space in RAM for when
-	VRAM runs out. The different types of memory exist within these heaps. Right now we'll only 
-	concern ourselves with the type of memory and not the heap it comes from, but you can imagine 
-	that this can affect performance.
-	*/
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_core_instance.get_physical_device(), &memProperties);
-	// memoryTypeCount : The number of memory types available.
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-			return i;
-		}
-	}
-	throw std::runtime_error("failed to find suitable memory type!");
+	// The errors grow with the level, the coarsest one under the threshold is searched from the end.
+	auto coarsest_under = [&](float pixels) {
+		uint32_t level = lod_count() - 1;
+		while (level > 0 && m_lods[level].error * pixels_per_unit > pixels) level--;
+		return level;
+	};
+	current = std::min(current, lod_count() - 1);
+	if (m_lods[current].error * pixels_per_unit > max_pixels) return coarsest_under(max_pixels);
+	return std::max(current, coarsest_under(max_pixels * (1.0f - LOD_HYSTERESIS)));
 }
-
-
-// ToDo:
-//	Staging memory
-//		https://vulkan-tutorial.com/en/Vertex_buffers/Staging_buffer
\ No newline at end of file
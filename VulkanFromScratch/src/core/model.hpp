@@ -3,7 +3,10 @@
 #include "core/core_fwd.h"
 #include <vector>
 #include <array>
+#include <string>
 #include <glm.hpp>
+#include "helper/meshlet_builder.hpp"
+#include "helper/mesh_simplifier.hpp"
 /*
 #include <vulkan/vulkan.h>
 #include <core/core_instance.hpp>
@@ -11,7 +14,10 @@
 class Model : public Component{
 
 public:
-    Model(CoreInstance& _core , VkPipeline pipeline);
+    // Loads an OBJ / glTF mesh through its binary cache (see MeshCache).
+    // `format` has to match the one the pipeline was created with.
+    Model(CoreInstance& _core , VkPipeline pipeline, const std::string& path,
+        VertexFormat format = VertexFormat::FULL);
     ~Model();
     //-----------------
     //  Component class 
@@ -19,68 +25,67 @@ public:
     void            update(FrameUpdateData& update_data) override;
 
     //-----------------
-    //  Temp data
+    //  Vertex layout
     //-----------------
+    // The binding / attribute descriptions are generated from VertexLayoutOf<Model::Vertex>.
     struct Vertex {
         glm::vec3 pos;
         glm::vec3 color;
         glm::vec2 texCoord;
-
-        static inline VkVertexInputBindingDescription get_binding_description() {
-            VkVertexInputBindingDescription bindingDescription{};
-            bindingDescription.binding = 0;
-            bindingDescription.stride = sizeof(Vertex);
-            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-            return bindingDescription;
-        }
-
-        static std::array<VkVertexInputAttributeDescription, 3> get_attribute_descriptions() {
-            std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-
-            attributeDescriptions[0].binding = 0;
-            attributeDescriptions[0].location = 0;
-            attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-            attributeDescriptions[1].binding = 0;
-            attributeDescriptions[1].location = 1;
-            attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-            attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-            attributeDescriptions[2].binding = 0;
-            attributeDescriptions[2].location = 2;
-            attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-            attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-            return attributeDescriptions;
-        }
-    };
-    const std::vector<Vertex> vertices = {
-        {{-0.5f, -0.5f ,0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
-        {{0.5f, -0.5f  ,0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
-        {{0.5f, 0.5f   ,0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
-        {{-0.5f, 0.5f  ,0.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}
     };
+    // The pool buffers are bound by Renderer::bind, only the index type may need a rebind.
+    void bind(const VkCommandBuffer& cmdBuf, VkPipelineLayout pipeline_layout);
+    // One copy of the current LOD with the identity transform (InstanceRing::IDENTITY_INSTANCE).
+    void draw(const VkCommandBuffer& cmdBuf);
+    // `instance_count` copies from the frame's instance region, see InstancedModel.
+    void draw_instanced(const VkCommandBuffer& cmdBuf, uint32_t first_instance, uint32_t instance_count);
 
-    const std::vector<uint16_t> indices = {
-        0, 1, 2, 2, 3, 0
-    };
+    inline const GeometryRange& geometry() const { return m_geometry; }
+    inline VkPipeline pipeline() const { return m_pipeline; }
+    inline const VertexDequantization& dequantization() const { return m_dequantization; }
+    // Bounds of the decoded positions (before the transform), from the mesh cache.
+    inline const glm::vec3& bounds_min() const { return m_bounds_min; }
+    inline const glm::vec3& bounds_max() const { return m_bounds_max; }
+    // xyz center, w radius, enclosing the bounds.
+    inline glm::vec4 bounding_sphere() const {
+        return glm::vec4((m_bounds_min + m_bounds_max) * 0.5f, glm::length(m_bounds_max - m_bounds_min) * 0.5f);
+    }
+    // Meshlets of LOD 0. Index ranges relative to geometry().first_index, bounds in the space of bounds_min / max.
+    inline const std::vector<Meshlet>& meshlets() const { return m_meshlets; }
 
-    void bind(const VkCommandBuffer& cmdBuf);
-    void draw(const VkCommandBuffer& cmdBuf);
-    
-    void create_vertexBuffer();
-    void create_indexBuffer();
+    //-----------------
+    //  LOD
+    //-----------------
+    // Level 0 is the full mesh. Index ranges relative to geometry().first_index.
+    inline uint32_t lod_count() const { return static_cast<uint32_t>(m_lods.size()); }
+    inline const MeshLod& lod(uint32_t level) const { return m_lods[level]; }
+    // Level drawn by draw() / draw_instanced().
+    inline uint32_t lod_level() const { return m_lod; }
+    void set_lod(uint32_t level);
+    // Coarsest level whose error stays under `max_pixels` once projected (`pixels_per_unit`
+    // pixels per unit of the vertices). Going coarser than `current` needs the error to be
+    // under `max_pixels * (1 - LOD_HYSTERESIS)`, so a level does not flicker at the threshold.
+    uint32_t select_lod(float pixels_per_unit, float max_pixels, uint32_t current) const;
+    static constexpr float LOD_HYSTERESIS = 0.25f;
 private:
 
-    VkBuffer m_vertexBuffer;
-    VkDeviceMemory m_vertexBufferMemory;
-    VkBuffer m_indexBuffer;
-    VkDeviceMemory m_indexBufferMemory;
+    // Range of CoreInstance::geometry_pool(), shared buffers with every other model.
+    GeometryRange m_geometry;
+    VertexDequantization m_dequantization;
+    glm::vec3 m_bounds_min{ 0.0f };
+    glm::vec3 m_bounds_max{ 0.0f };
+    std::vector<Meshlet> m_meshlets;
+    std::vector<MeshLod> m_lods;
+    uint32_t m_lod = 0;
 
     CoreInstance& m_core_instance;
     VkPipeline m_pipeline;
+};
 
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+template<>
+struct VertexLayoutOf<Model::Vertex> {
+    using type = VertexLayout<Model::Vertex, VK_VERTEX_INPUT_RATE_VERTEX,
+        VERTEX_ATTRIBUTE(Model::Vertex, pos, 0),
+        VERTEX_ATTRIBUTE(Model::Vertex, color, 1),
+        VERTEX_ATTRIBUTE(Model::Vertex, texCoord, 2)>;
 };
\ No newline at end of file
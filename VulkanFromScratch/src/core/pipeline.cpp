@@ -31,7 +31,7 @@ VkShaderModule GraphicsPipeline::createShaderModule(const std::vector<char>& cod
 	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(m_core_instance.get_device(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+	if (vkCreateShaderModule(m_core_instance.get_device(), &createInfo, m_core_instance.allocation_callbacks(), &shaderModule) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create shader module!");
 	}
 
@@ -40,11 +40,11 @@ VkShaderModule GraphicsPipeline::createShaderModule(const std::vector<char>& cod
 
 void GraphicsPipeline::cleanup()
 {
-	vkDestroyShaderModule(m_core_instance.get_device(), m_vert_shader_module, nullptr);
-	vkDestroyShaderModule(m_core_instance.get_device(), m_frag_shader_module, nullptr);
-	vkDestroyPipelineLayout(m_core_instance.get_device() , m_pipeline_layout, nullptr);
+	vkDestroyShaderModule(m_core_instance.get_device(), m_vert_shader_module, m_core_instance.allocation_callbacks());
+	vkDestroyShaderModule(m_core_instance.get_device(), m_frag_shader_module, m_core_instance.allocation_callbacks());
+	vkDestroyPipelineLayout(m_core_instance.get_device() , m_pipeline_layout, m_core_instance.allocation_callbacks());
 	//vkDestroyRenderPass(m_core_instance.get_device(), m_renderPass, nullptr);
-	vkDestroyPipeline(m_core_instance.get_device(), m_graphicsPipeline, nullptr);
+	vkDestroyPipeline(m_core_instance.get_device(), m_graphicsPipeline, m_core_instance.allocation_callbacks());
 	
 }
 
@@ -57,8 +57,24 @@ void GraphicsPipeline::cleanup()
 */
 void GraphicsPipeline::create_pipleine( 
 	VkRenderPass renderpass , 
-	std::vector<VkDescriptorSetLayout>* descriptors )
+	std::vector<VkDescriptorSetLayout>* descriptors,
+	VertexFormat vertex_format )
 {
+	m_vertex_format = vertex_format;
+	create_pipleine(renderpass, descriptors, vertex_input_description(vertex_format));
+}
+
+// Every format the pipeline can be created with has to feed the shader.
+static_assert(check_vertex_inputs<SimpleShaderInputs, Model::Vertex, InstanceData>());
+static_assert(check_vertex_inputs<SimpleShaderInputs, PackedVertexSnorm16, InstanceData>());
+static_assert(check_vertex_inputs<SimpleShaderInputs, PackedVertexHalf, InstanceData>());
+
+void GraphicsPipeline::create_pipleine(
+	VkRenderPass renderpass ,
+	std::vector<VkDescriptorSetLayout>* descriptors,
+	const VertexInputDescription& vertex_input )
+{
+
 	//-------------------
 	// 	   Vert Stage
 	//-------------------
@@ -80,14 +96,12 @@ void GraphicsPipeline::create_pipleine(
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	auto vert_binding_dscp = Model::Vertex::get_binding_description();
-	auto attr_binding_dscp = Model::Vertex::get_attribute_descriptions();
 
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &vert_binding_dscp; // Optional
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attr_binding_dscp.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attr_binding_dscp.data(); // Optional
+	vertexInputInfo.vertexBindingDescriptionCount = vertex_input.binding_count;
+	vertexInputInfo.pVertexBindingDescriptions = vertex_input.bindings; // Optional
+	vertexInputInfo.vertexAttributeDescriptionCount = vertex_input.attribute_count;
+	vertexInputInfo.pVertexAttributeDescriptions = vertex_input.attributes; // Optional
 
 	//---------------------- fixed-function ------------------------
 
@@ -195,6 +209,18 @@ void GraphicsPipeline::create_pipleine(
 	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
 	multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
+	//-------------------
+	// 	   Depth
+	//-------------------
+	// Depth cleared to 1.0 (Renderer), closer fragments pass. The depth pyramid keeps the farthest depth.
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthBoundsTestEnable = VK_FALSE;
+	depthStencil.stencilTestEnable = VK_FALSE;
+
 	//-------------------
 	// 	   Color blending
 	//-------------------
@@ -233,8 +259,10 @@ void GraphicsPipeline::create_pipleine(
 	pipelineLayoutInfo.setLayoutCount = 0; // Optional
 	pipelineLayoutInfo.pSetLayouts = nullptr; // Optional
 	*/
-	//pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	//pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+	// Per model vertex dequantization (see VertexDequantization)
+	VkPushConstantRange push_constant_range = vertex_push_constant_range();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &push_constant_range;
 	//pipelineLayoutInfo.setLayoutCount = 1;//static_cast<uint32_t>( descriptors.size()); // Optional
 	//pipelineLayoutInfo.pSetLayouts = &descriptors; // Optional
 	
@@ -242,7 +270,7 @@ void GraphicsPipeline::create_pipleine(
 	pipelineLayoutInfo.pSetLayouts = descriptors->data();
 
 	if (vkCreatePipelineLayout(
-		m_core_instance.get_device(), &pipelineLayoutInfo, nullptr, &m_pipeline_layout) != VK_SUCCESS) {
+		m_core_instance.get_device(), &pipelineLayoutInfo, m_core_instance.allocation_callbacks(), &m_pipeline_layout) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create pipeline layout!");
 	}
 
@@ -259,7 +287,7 @@ void GraphicsPipeline::create_pipleine(
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr; // Optional
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = m_pipeline_layout;
@@ -282,7 +310,7 @@ void GraphicsPipeline::create_pipleine(
 
 	if (vkCreateGraphicsPipelines(
 		m_core_instance.get_device(),
-		VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_graphicsPipeline) != VK_SUCCESS) {
+		VK_NULL_HANDLE, 1, &pipelineInfo, m_core_instance.allocation_callbacks(), &m_graphicsPipeline) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create graphics pipeline!");
 	}
 }
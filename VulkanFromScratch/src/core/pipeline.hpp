@@ -4,6 +4,16 @@
 #include "./helper/file_loader.hpp"
 #include <core/core_instance.hpp>
 #include "swapchain.hpp"
+#include "vertex_format.hpp"
+
+// Vertex inputs of simple_shader.vert, keep in sync with the shader.
+using SimpleShaderInputs = ShaderInputs<
+	ShaderInput<0, float>,	// inPosition
+	ShaderInput<1, float>,	// inColor
+	ShaderInput<2, float>,	// inUv
+	ShaderInput<3, float>,	// inModelRow0 (per instance)
+	ShaderInput<4, float>,	// inModelRow1
+	ShaderInput<5, float>>;	// inModelRow2
 
 class GraphicsPipeline {
 public:
@@ -15,8 +25,22 @@ public:
 	inline const VkPipeline& get_pipeline() const { return m_graphicsPipeline;}
 	inline VkPipelineLayout& get_layout() { return m_pipeline_layout; }
 	
+	// Models drawn with this pipeline have to be loaded with the same vertex format.
+	void create_pipleine( VkRenderPass renderpass ,
+		std::vector<VkDescriptorSetLayout>* descriptors,
+		VertexFormat vertex_format = VertexFormat::FULL);
+	inline VertexFormat vertex_format() const { return m_vertex_format; }
+	// Any vertex type with a VertexLayoutOf specialization, checked against the shader at compile time.
+	// InstanceData is always bound at binding 1.
+	template<typename Vertex>
+	void create_pipleine( VkRenderPass renderpass ,
+		std::vector<VkDescriptorSetLayout>* descriptors) {
+		static_assert(check_vertex_inputs<SimpleShaderInputs, Vertex, InstanceData>());
+		create_pipleine(renderpass, descriptors, VertexInputDescription::of<Vertex, InstanceData>());
+	}
 	void create_pipleine( VkRenderPass renderpass ,
-		std::vector<VkDescriptorSetLayout>* descriptors);
+		std::vector<VkDescriptorSetLayout>* descriptors,
+		const VertexInputDescription& vertex_input);
 private:
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 	CoreInstance& m_core_instance;
@@ -26,6 +50,7 @@ private:
 	VkPipelineLayout m_pipeline_layout;
 	//VkRenderPass m_renderPass;
 	VkPipeline m_graphicsPipeline;
+	VertexFormat m_vertex_format = VertexFormat::FULL;
 	//unsigned int m_width;
 	//unsigned int m_height;
 
@@ -2,6 +2,7 @@
 
 Renderer::Renderer(CoreInstance& core_instance, SwapChain& swapchain) :m_core_instance{ core_instance }, m_swapchain{swapchain}
 {
+    create_depthResources();
     create_renderPass();
     create_frameBuffer(m_swapchain , m_renderpass);
     create_commandBuffer();
@@ -15,10 +16,59 @@ Renderer::~Renderer()
 void Renderer::cleanup()
 {
     for (auto framebuffer : m_swapChain_framebuffers) {
-        vkDestroyFramebuffer(m_core_instance.get_device(), framebuffer, nullptr);
+        vkDestroyFramebuffer(m_core_instance.get_device(), framebuffer, m_core_instance.allocation_callbacks());
     }
-    vkDestroyCommandPool(m_core_instance.get_device(), m_core_instance.cmd_pool(), nullptr);
-    vkDestroyRenderPass(m_core_instance.get_device(), m_renderpass, nullptr);
+    vkDestroyCommandPool(m_core_instance.get_device(), m_core_instance.cmd_pool(), m_core_instance.allocation_callbacks());
+    vkDestroyRenderPass(m_core_instance.get_device(), m_renderpass, m_core_instance.allocation_callbacks());
+    vkDestroyRenderPass(m_core_instance.get_device(), m_renderpass_load, m_core_instance.allocation_callbacks());
+    m_core_instance.resources().destroy(m_depth_image);
+}
+
+void Renderer::create_depthResources()
+{
+    // Single aspect formats only, the same view is the attachment and the sampled depth (DepthPyramid).
+    // D16 is always supported as a depth attachment.
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_core_instance.get_physical_device(), format, &properties);
+        if ((properties.optimalTilingFeatures & features) == features) {
+            m_depth_format = format;
+            break;
+        }
+    }
+    if (m_depth_format == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("failed to find a depth format!");
+    }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = VkExtent3D{ m_swapchain._width(), m_swapchain._height(), 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = m_depth_format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    m_depth_image = m_core_instance.resources().create_image(imageInfo, MemoryUsage::GPU_ONLY, VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void Renderer::recreate_swapchain()
+{
+    m_swapchain.recreate();
+
+    // The device is idle, nothing uses the framebuffers or the depth buffer anymore.
+    for (auto framebuffer : m_swapChain_framebuffers) {
+        vkDestroyFramebuffer(m_core_instance.get_device(), framebuffer, m_core_instance.allocation_callbacks());
+    }
+    m_core_instance.resources().destroy(m_depth_image);
+    create_depthResources();
+    create_frameBuffer(m_swapchain, m_renderpass);
+    m_extent_generation++;
 }
 
 void Renderer::create_frameBuffer(SwapChain& swapchain, VkRenderPass renderPass )
@@ -31,19 +81,20 @@ void Renderer::create_frameBuffer(SwapChain& swapchain, VkRenderPass renderPass
 
     for (size_t i = 0; i < swapchain.get_image_views().size(); i++) {
         VkImageView attachments[] = {
-            swapchain.get_image_views()[i]
+            swapchain.get_image_views()[i],
+            m_core_instance.resources().view(m_depth_image)
         };
 
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
         framebufferInfo.renderPass = renderPass;
-        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.attachmentCount = 2;
         framebufferInfo.pAttachments = attachments;
         framebufferInfo.width = swapchain._width();
         framebufferInfo.height = swapchain._height();
         framebufferInfo.layers = 1; //Our swap chain images are single images, so the number of layers is 1.
 
-        if (vkCreateFramebuffer(m_core_instance.get_device(), &framebufferInfo, nullptr, &m_swapChain_framebuffers[i]) != VK_SUCCESS) {
+        if (vkCreateFramebuffer(m_core_instance.get_device(), &framebufferInfo, m_core_instance.allocation_callbacks(), &m_swapChain_framebuffers[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create framebuffer!");
         }
     }
@@ -60,7 +111,7 @@ void Renderer::create_commnadPool()
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = m_core_instance.get_queuefailmy_indexs()->graphic_queuefamily_index.value();
 
-    if (vkCreateCommandPool(m_core_instance.get_device(), &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(m_core_instance.get_device(), &poolInfo, m_core_instance.allocation_callbacks(), &m_commandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
 }
@@ -114,12 +165,31 @@ void Renderer::begin_commandBuffer()
     if (vkBeginCommandBuffer(m_commandBuffers[current_frame], &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
+}
+
+void Renderer::begin_renderPass()
+{
+    begin_pass(m_renderpass);
+}
 
+void Renderer::resume_renderPass()
+{
+    begin_pass(m_renderpass_load);
+}
+
+void Renderer::end_renderPass()
+{
+    vkCmdEndRenderPass(m_commandBuffers[m_swapchain.current_frame()]);
+}
+
+void Renderer::begin_pass(VkRenderPass renderPass)
+{
+    auto current_frame = m_swapchain.current_frame();
 
     // We created a framebuffer for each swap chain image where it is specified as a color attachment.
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderpass;
+    renderPassInfo.renderPass = renderPass;
     renderPassInfo.framebuffer = m_swapChain_framebuffers[m_imageIndex];
 
     // The render area defines where shader loads and stores will take place. 
@@ -129,9 +199,12 @@ void Renderer::begin_commandBuffer()
     renderPassInfo.renderArea.extent = VkExtent2D{m_swapchain._width() , m_swapchain._height() };
     
     // Define clear color
-    VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    // In attachment order, the depth is cleared to the far plane.
+    VkClearValue clearValues[2]{};
+    clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+    clearValues[1].depthStencil = { 1.0f, 0 };
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
 
     /*
         * VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
@@ -220,6 +293,17 @@ void Renderer::create_renderPass()
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; //which layout the image will have before the render pass begins. 
     colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+    // Stored, a second pass (resume_renderPass) or the depth pyramid may read it.
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = m_depth_format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     //-------------------
     // 	   Pipeline Reference
     //-------------------
@@ -227,12 +311,17 @@ void Renderer::create_renderPass()
     colorAttachmentRef.attachment = 0; // Our array consists of a single VkAttachmentDescription, so its index is 0.
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 1;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
     VkSubpassDescription subpass{};
     // The index of the attachment in this array is directly referenced from the fragment shader with the 
     // layout(location = 0) out vec4 outColor directive!
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
    
     // Subpasses in a render pass automatically take care of image layout transitions. 
     // These transitions are controlled by subpass dependencies, which specify memory 
@@ -251,26 +340,49 @@ void Renderer::create_renderPass()
     // specify the operations to wait on and the stages in which these operations occur. 
     // We need to wait for the swap chain to finish reading from the image before we can access it.
     // This can be accomplished by waiting on the color attachment output stage itself.
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; //specifies the pipeline stage that produces the data.
-    dependency.srcAccessMask = 0; // 0 means the dependency is not waiting for any specific memory access to complete.
+    // The depth buffer is shared by the frames in flight : the previous frame's depth writes come first.
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT; //specifies the pipeline stage that produces the data.
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;// indicating that the subsequent operations will also involve writing to color attachments.
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; // indicates that the destination stage will involve writing to color attachments.
+    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;// indicating that the subsequent operations will also involve writing to color attachments.
+    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT; // indicates that the destination stage will involve writing to color attachments.
 
     //--------------------------
     //      Render Pass
     //--------------------------    
     VkRenderPassCreateInfo renderpassinfo{};
     renderpassinfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderpassinfo.attachmentCount = 1;
-    renderpassinfo.pAttachments = &colorAttachment;
+    VkAttachmentDescription attachments[] = { colorAttachment, depthAttachment };
+    renderpassinfo.attachmentCount = 2;
+    renderpassinfo.pAttachments = attachments;
     renderpassinfo.subpassCount = 1;
     renderpassinfo.pSubpasses = &subpass;
 
     renderpassinfo.dependencyCount = 1;
     renderpassinfo.pDependencies = &dependency;
 
-    if (vkCreateRenderPass(m_core_instance.get_device(), &renderpassinfo, nullptr, &m_renderpass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(m_core_instance.get_device(), &renderpassinfo, m_core_instance.allocation_callbacks(), &m_renderpass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass!");
+    }
+
+    // Same attachments loaded instead of cleared : compatible, the framebuffers and pipelines work with both.
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    // The first pass wrote both attachments and the load reads them back : the color and depth
+    // writes have to land before the load, and the writes of this pass come after them.
+    VkSubpassDependency loadDependency{};
+    loadDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    loadDependency.dstSubpass = 0;
+    loadDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    loadDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    loadDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    loadDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    renderpassinfo.pDependencies = &loadDependency;
+    if (vkCreateRenderPass(m_core_instance.get_device(), &renderpassinfo, m_core_instance.allocation_callbacks(), &m_renderpass_load) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
 }
@@ -289,6 +401,10 @@ void Renderer::draw_frame()
         
     //record_commandBuffer(m_imageIndex, pipeline);
 
+    // Uploads and one-shot commands recorded while building this frame have to reach the queue before it.
+    m_core_instance.staging_ring().flush();
+    m_core_instance.immediate().submit();
+
     //----------------
     //     Submit
     //----------------
@@ -344,7 +460,14 @@ void Renderer::draw_frame()
     // It allows you to specify an array of VkResult values to check for every individual swap chain if presentation was successful.
     presentInfo.pResults = nullptr; // Optional 
     // Submits the request to present an image to the swap chain
-    vkQueuePresentKHR(m_core_instance.present_queue(), &presentInfo); 
+    VkResult result = vkQueuePresentKHR(m_core_instance.present_queue(), &presentInfo);
+    // Suboptimal still presents, the swap chain is replaced for the next frame anyway.
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_swapchain.window_resized()) {
+        recreate_swapchain();
+    }
+    else if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to present swap chain image!");
+    }
 
     m_swapchain.update_frame_count();
 }
@@ -360,11 +483,31 @@ void Renderer::reset_renderpass()
     vkWaitForFences(m_core_instance.get_device(), 1, &fence, VK_TRUE, UINT64_MAX);
     vkResetFences(m_core_instance.get_device(), 1, &fence);  // Rest
 
+    // The GPU is done with this frame, its slice of the uniform ring can be reused
+    // and the resources retired the last time this slot was recorded can be destroyed.
+    m_core_instance.uniform_ring().begin_frame(current_frame);
+    m_core_instance.instance_ring().begin_frame(current_frame);
+    m_core_instance.deletion_queue().begin_frame(current_frame);
+    m_core_instance.update_memory_budget();
+    m_core_instance.host_allocator().begin_frame();
+    m_core_instance.staging_ring().retire();
+    m_core_instance.immediate().poll(0);  // recycle finished one-shot batches
+    // Moves a few resources out of sparse memory blocks, before anything records their handles.
+    m_core_instance.defragmenter().step();
 
     
     // Signaled when the presentation engine is finished using the image. 
-    vkAcquireNextImageKHR(m_core_instance.get_device(), m_swapchain.swap_chain(), UINT64_MAX,
+    // Out of date : nothing was acquired (the semaphore is left unsignaled), retried on a new swap chain.
+    VkResult result = vkAcquireNextImageKHR(m_core_instance.get_device(), m_swapchain.swap_chain(), UINT64_MAX,
         m_swapchain.get_avaliable_semaphore(), VK_NULL_HANDLE, &m_imageIndex);
+    while (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        recreate_swapchain();
+        result = vkAcquireNextImageKHR(m_core_instance.get_device(), m_swapchain.swap_chain(), UINT64_MAX,
+            m_swapchain.get_avaliable_semaphore(), VK_NULL_HANDLE, &m_imageIndex);
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swap chain image!");
+    }
 
     vkResetCommandBuffer(m_commandBuffers[current_frame], 0);
 }
@@ -378,19 +521,35 @@ void Renderer::end_render()
     }
 }
 
+void Renderer::set_texture(Image& image)
+{
+    m_texture_image = image.handle();
+    m_texture_layout = image.get_descriptorsetLayout();
+}
+
 void Renderer::bind(VkCommandBuffer& cmdBuf, VkPipelineLayout& pipeline_layout)
 {
+    // Every model draws from the shared geometry buffers and the frame's instance
+    // region, both bound once for the whole frame.
+    m_core_instance.geometry_pool().bind_vertex_buffer(cmdBuf);
+    m_core_instance.instance_ring().bind(cmdBuf);
+
+    // The set changes when the texture is relocated, a stale handle means it was destroyed.
+    ImageRecord* texture = m_core_instance.resources().get(m_texture_image);
+    if (texture == nullptr || texture->descriptor_set == VK_NULL_HANDLE) {
+        throw std::runtime_error("stale texture handle!");
+    }
     vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipeline_layout,   //Where to bind
         1,  // index of the first descriptor set,
         1,  // the number of sets to bind
-        &m_texture_image->m_descriptorSets, //array of set to bind
+        &texture->descriptor_set, //array of set to bind
         0, nullptr);
 }
 
 VkDescriptorSetLayout Renderer::get_descriptorset_layout()
 {
-    return m_texture_image->get_descriptorsetLayout();
+    return m_texture_layout;
 }
 
 void Renderer::update(FrameUpdateData& updateData)
@@ -17,7 +17,8 @@ public :
 	//------------------
 	//	Additional Property
 	//------------------
-	Image* m_texture_image;
+	// Texture bound at set 1, its descriptor set is looked up in CoreInstance::resources().
+	void set_texture(Image& image);
 
 
 	void cleanup();
@@ -25,22 +26,47 @@ public :
 	void create_frameBuffer(SwapChain& swapchain , VkRenderPass renderPass);	
 	void create_commandBuffer();
 	void create_renderPass();
+	void create_depthResources();
+	// On VK_ERROR_OUT_OF_DATE_KHR / VK_SUBOPTIMAL_KHR or a resized window : new swap chain,
+	// depth buffer and framebuffers at the window's size. Waits for the device.
+	void recreate_swapchain();
 	
 	void draw_frame();
 	void begin_commandBuffer();
+	// Everything recorded between the two (GameObject::execute_before_frame) runs outside the pass.
+	void begin_renderPass();
+	// Splits the frame for work that has to run outside a render pass (e.g. reading the depth),
+	// the second pass loads the color and depth of the first one.
+	void end_renderPass();
+	void resume_renderPass();
 	void reset_renderpass();
 	void bind(VkCommandBuffer& cmdBuf , VkPipelineLayout& pipeline_layout);
 	void end_render();
 	
 	inline const auto get_renderPass()const { return m_renderpass; } // Todo : split to small class
 	inline VkCommandBuffer& get_current_cmdbuffer() { return m_commandBuffers[m_swapchain.current_frame()]; }
+	// In VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL between the render passes.
+	inline ImageHandle depth_image() const { return m_depth_image; }
+	inline VkFormat depth_format() const { return m_depth_format; }
+	inline VkExtent2D extent() const { return VkExtent2D{ m_swapchain._width(), m_swapchain._height() }; }
+	// Bumped by every recreate_swapchain(), what is sized after extent() or built on
+	// depth_image() compares it to rebuild (DepthPyramid::update_extent).
+	inline uint32_t extent_generation() const { return m_extent_generation; }
 	
 
 private:
+	void begin_pass(VkRenderPass renderPass);
+
 	CoreInstance& m_core_instance;
 	std::vector<VkFramebuffer> m_swapChain_framebuffers;
 	SwapChain& m_swapchain;
 	VkRenderPass m_renderpass;
+	VkRenderPass m_renderpass_load = VK_NULL_HANDLE;	// compatible with m_renderpass, loads instead of clearing
+
+	// One depth buffer for every frame in flight, the frames are serialized on the graphics queue.
+	ImageHandle m_depth_image;
+	VkFormat m_depth_format = VK_FORMAT_UNDEFINED;
+	uint32_t m_extent_generation = 0;
 
 
 	//VkCommandBuffer m_commandBuffer;
@@ -48,4 +74,7 @@ private:
 
 	uint32_t m_imageIndex;
 
+	ImageHandle m_texture_image;
+	VkDescriptorSetLayout m_texture_layout = VK_NULL_HANDLE;
+
 };
\ No newline at end of file
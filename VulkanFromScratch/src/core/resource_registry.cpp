@@ -0,0 +1,328 @@
+#include "resource_registry.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <cstdio>
+
+//----------------------
+//  Pool
+//----------------------
+template<typename Record, typename Handle>
+Handle ResourceRegistry::Pool<Record, Handle>::add(const Record& record)
+{
+    uint32_t slot_idx;
+    if (!free_slots.empty()) {
+        slot_idx = free_slots.back();
+        free_slots.pop_back();
+    }
+    else {
+        if (slots.size() > Handle::INDEX_MASK) {
+            throw std::runtime_error("failed to create resource, out of handle slots!");
+        }
+        slots.push_back(Slot{});
+        slot_idx = static_cast<uint32_t>(slots.size() - 1);
+    }
+
+    Slot& slot = slots[slot_idx];
+    slot.dense = static_cast<uint32_t>(records.size());
+    records.push_back(record);
+    record_slots.push_back(slot_idx);
+    return Handle::make(slot_idx, slot.generation);
+}
+
+template<typename Record, typename Handle>
+Record* ResourceRegistry::Pool<Record, Handle>::get(Handle handle)
+{
+    if (handle.is_null() || handle.index() >= slots.size()) return nullptr;
+    const Slot& slot = slots[handle.index()];
+    if (slot.generation != handle.generation() || slot.dense == UINT32_MAX) return nullptr;
+    return &records[slot.dense];
+}
+
+template<typename Record, typename Handle>
+bool ResourceRegistry::Pool<Record, Handle>::remove(Handle handle, Record& removed)
+{
+    Record* record = get(handle);
+    if (record == nullptr) return false;
+    removed = *record;
+
+    // Keep the records packed: the last one takes the free place.
+    Slot& slot = slots[handle.index()];
+    uint32_t last = static_cast<uint32_t>(records.size() - 1);
+    if (slot.dense != last) {
+        records[slot.dense] = records[last];
+        record_slots[slot.dense] = record_slots[last];
+        slots[record_slots[slot.dense]].dense = slot.dense;
+    }
+    records.pop_back();
+    record_slots.pop_back();
+
+    // 0 is kept for null handles.
+    slot.generation = (slot.generation + 1) & Handle::GENERATION_MASK;
+    if (slot.generation == 0) slot.generation = 1;
+    slot.dense = UINT32_MAX;
+    free_slots.push_back(handle.index());
+    return true;
+}
+
+//----------------------
+//  ResourceRegistry
+//----------------------
+ResourceRegistry::~ResourceRegistry()
+{
+    cleanup();
+}
+
+void ResourceRegistry::init(CoreInstance& core_instance)
+{
+    m_core_instance = &core_instance;
+}
+
+void ResourceRegistry::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    // The device is idle here, whatever is left is destroyed right away.
+    if (!m_buffers.records.empty() || !m_images.records.empty()) {
+        printf("[!] ResourceRegistry: %zu buffer(s) and %zu image(s) still alive \n",
+            m_buffers.records.size(), m_images.records.size());
+    }
+    VkDevice device = m_core_instance->get_device();
+    for (auto& record : m_buffers.records) {
+        m_core_instance->defragmenter().unregister(record.defrag_id);
+        destroyBuffer(*m_core_instance, record.buffer, record.allocation);
+    }
+    for (auto& record : m_images.records) {
+        m_core_instance->defragmenter().unregister(record.defrag_id);
+        vkDestroyImageView(device, record.view, m_core_instance->allocation_callbacks());
+        destroyImage(*m_core_instance, record.image, record.allocation);
+    }
+    m_buffers = {};
+    m_images = {};
+    m_buffer_listeners.clear();
+    m_image_listeners.clear();
+    m_core_instance = nullptr;
+}
+
+//----------------------
+//  Create / destroy
+//----------------------
+BufferHandle ResourceRegistry::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const MemoryPolicy& memory_policy)
+{
+    BufferRecord record{};
+    record.size = size;
+    record.usage = usage;
+    createBuffer(*m_core_instance, size, usage, memory_policy, record.buffer, record.allocation);
+
+    BufferHandle handle = m_buffers.add(record);
+    if (m_buffer_listeners.size() <= handle.index()) {
+        m_buffer_listeners.resize(handle.index() + 1);
+    }
+    m_buffer_listeners[handle.index()] = nullptr;
+    return handle;
+}
+
+ImageHandle ResourceRegistry::create_image(const VkImageCreateInfo& image_info, const MemoryPolicy& memory_policy, VkImageAspectFlags aspect)
+{
+    ImageRecord record{};
+    record.type = image_info.imageType;
+    record.format = image_info.format;
+    record.usage = image_info.usage;
+    record.extent = image_info.extent;
+    record.mip_levels = image_info.mipLevels;
+    record.array_layers = image_info.arrayLayers;
+    record.aspect = aspect;
+    createImage(*m_core_instance, image_info, memory_policy, record.image, record.allocation);
+    record.view = create_view(record);
+
+    ImageHandle handle = m_images.add(record);
+    if (m_image_listeners.size() <= handle.index()) {
+        m_image_listeners.resize(handle.index() + 1);
+    }
+    m_image_listeners[handle.index()] = nullptr;
+    return handle;
+}
+
+void ResourceRegistry::destroy(BufferHandle handle)
+{
+    BufferRecord record;
+    if (!m_buffers.remove(handle, record)) return;
+
+    m_core_instance->defragmenter().unregister(record.defrag_id);
+    m_buffer_listeners[handle.index()] = nullptr;
+    CoreInstance* core_instance = m_core_instance;
+    m_core_instance->deletion_queue().push([core_instance, record]() mutable {
+        destroyBuffer(*core_instance, record.buffer, record.allocation);
+    });
+}
+
+void ResourceRegistry::destroy(ImageHandle handle)
+{
+    ImageRecord record;
+    if (!m_images.remove(handle, record)) return;
+
+    m_core_instance->defragmenter().unregister(record.defrag_id);
+    m_image_listeners[handle.index()] = nullptr;
+    CoreInstance* core_instance = m_core_instance;
+    m_core_instance->deletion_queue().push([core_instance, record]() mutable {
+        vkDestroyImageView(core_instance->get_device(), record.view, core_instance->allocation_callbacks());
+        destroyImage(*core_instance, record.image, record.allocation);
+    });
+}
+
+void ResourceRegistry::make_movable(BufferHandle handle, uint64_t ready_ticket, std::function<void(BufferHandle)> on_moved)
+{
+    BufferRecord* record = get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale buffer handle!");
+    }
+    m_buffer_listeners[handle.index()] = std::move(on_moved);
+    // The callback looks the record up again, records move around inside the dense array.
+    record->defrag_id = m_core_instance->defragmenter().register_buffer(
+        record->buffer, record->allocation, record->size, record->usage, ready_ticket,
+        [this, handle](const Defragmenter::MovedResource& moved) {
+            on_buffer_moved(handle, moved.allocation, moved.buffer);
+        });
+}
+
+void ResourceRegistry::make_movable(ImageHandle handle, VkImageLayout layout, uint64_t ready_ticket, std::function<void(ImageHandle)> on_moved)
+{
+    ImageRecord* record = get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale image handle!");
+    }
+
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = record->type;
+    image_info.extent = record->extent;
+    image_info.mipLevels = record->mip_levels;
+    image_info.arrayLayers = record->array_layers;
+    image_info.format = record->format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.usage = record->usage;
+
+    m_image_listeners[handle.index()] = std::move(on_moved);
+    record->defrag_id = m_core_instance->defragmenter().register_image(
+        record->image, record->allocation, image_info, layout, ready_ticket,
+        [this, handle](const Defragmenter::MovedResource& moved) {
+            on_image_moved(handle, moved.allocation, moved.image);
+        });
+}
+
+void ResourceRegistry::set_ready_ticket(BufferHandle handle, uint64_t ready_ticket)
+{
+    BufferRecord* record = get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale buffer handle!");
+    }
+    m_core_instance->defragmenter().set_ready_ticket(record->defrag_id, ready_ticket);
+}
+
+//----------------------
+//  Lookup
+//----------------------
+BufferRecord* ResourceRegistry::get(BufferHandle handle)
+{
+    return m_buffers.get(handle);
+}
+
+ImageRecord* ResourceRegistry::get(ImageHandle handle)
+{
+    return m_images.get(handle);
+}
+
+VkBuffer ResourceRegistry::buffer(BufferHandle handle)
+{
+    BufferRecord* record = m_buffers.get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale buffer handle!");
+    }
+    return record->buffer;
+}
+
+VkImage ResourceRegistry::image(ImageHandle handle)
+{
+    ImageRecord* record = m_images.get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale image handle!");
+    }
+    return record->image;
+}
+
+VkImageView ResourceRegistry::view(ImageHandle handle)
+{
+    ImageRecord* record = m_images.get(handle);
+    if (record == nullptr) {
+        throw std::runtime_error("stale image handle!");
+    }
+    return record->view;
+}
+
+void ResourceRegistry::print_stats() const
+{
+    VkDeviceSize buffer_bytes = 0, image_bytes = 0;
+    for (const auto& record : m_buffers.records) buffer_bytes += record.allocation.size;
+    for (const auto& record : m_images.records) image_bytes += record.allocation.size;
+    printf("[Resources] %zu buffer(s) %.2f MB, %zu image(s) %.2f MB \n",
+        m_buffers.records.size(), buffer_bytes / (1024.0 * 1024.0),
+        m_images.records.size(), image_bytes / (1024.0 * 1024.0));
+}
+
+//----------------------
+//  Relocation
+//----------------------
+VkImageView ResourceRegistry::create_view(const ImageRecord& record)
+{
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = record.image;
+    viewInfo.viewType = record.type == VK_IMAGE_TYPE_3D ? VK_IMAGE_VIEW_TYPE_3D
+        : record.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = record.format;
+    viewInfo.subresourceRange.aspectMask = record.aspect;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = record.mip_levels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = record.array_layers;
+
+    VkImageView view;
+    if (vkCreateImageView(m_core_instance->get_device(), &viewInfo, m_core_instance->allocation_callbacks(), &view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image view!");
+    }
+    return view;
+}
+
+void ResourceRegistry::on_buffer_moved(BufferHandle handle, const MemoryAllocation& allocation, VkBuffer buffer)
+{
+    // The old buffer is retired by the defragmenter.
+    BufferRecord* record = m_buffers.get(handle);
+    record->buffer = buffer;
+    record->allocation = allocation;
+
+    if (m_buffer_listeners[handle.index()]) {
+        m_buffer_listeners[handle.index()](handle);
+    }
+}
+
+void ResourceRegistry::on_image_moved(ImageHandle handle, const MemoryAllocation& allocation, VkImage image)
+{
+    ImageRecord* record = m_images.get(handle);
+    record->image = image;
+    record->allocation = allocation;
+
+    // Frames in flight still use the old view, it goes before the old image (queued right after this).
+    VkDevice device = m_core_instance->get_device();
+    const VkAllocationCallbacks* callbacks = m_core_instance->allocation_callbacks();
+    VkImageView old_view = record->view;
+    m_core_instance->deletion_queue().push([device, old_view, callbacks]() {
+        vkDestroyImageView(device, old_view, callbacks);
+    });
+    record->view = create_view(*record);
+
+    if (m_image_listeners[handle.index()]) {
+        m_image_listeners[handle.index()](handle);
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "./core/memory_allocator.hpp"
+
+class CoreInstance;
+
+//----------------------------
+// Handles
+//----------------------------
+// 32 bit handle : [ generation : 12 | index : 20 ]. The generation of a slot is bumped every
+// time its resource is destroyed, so a handle kept after the destroy is detected as stale
+// instead of silently pointing to whatever reuses the slot. 0 is never handed out.
+template<typename Tag>
+struct ResourceHandle {
+	static constexpr uint32_t INDEX_BITS = 20;
+	static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static constexpr uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+
+	uint32_t value = 0;
+
+	inline bool		is_null() const { return value == 0; }
+	inline uint32_t	index() const { return value & INDEX_MASK; }
+	inline uint32_t	generation() const { return value >> INDEX_BITS; }
+	inline bool operator==(const ResourceHandle& other) const { return value == other.value; }
+	inline bool operator!=(const ResourceHandle& other) const { return value != other.value; }
+
+	static inline ResourceHandle make(uint32_t index, uint32_t generation) {
+		return ResourceHandle{ (generation << INDEX_BITS) | index };
+	}
+};
+using BufferHandle = ResourceHandle<struct BufferTag>;
+using ImageHandle = ResourceHandle<struct ImageTag>;
+
+//----------------------------
+// Records
+//----------------------------
+struct BufferRecord {
+	VkBuffer			buffer = VK_NULL_HANDLE;
+	MemoryAllocation	allocation;
+	VkDeviceSize		size = 0;
+	VkBufferUsageFlags	usage = 0;
+	uint32_t			defrag_id = UINT32_MAX;
+};
+
+struct ImageRecord {
+	VkImage				image = VK_NULL_HANDLE;
+	VkImageView			view = VK_NULL_HANDLE;
+	MemoryAllocation	allocation;
+	VkImageType			type = VK_IMAGE_TYPE_2D;
+	VkFormat			format = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags	usage = 0;
+	VkExtent3D			extent{};
+	uint32_t			mip_levels = 1;
+	uint32_t			array_layers = 1;
+	VkImageAspectFlags	aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	// Set that samples this image, kept up to date by its owner (may be VK_NULL_HANDLE).
+	VkDescriptorSet		descriptor_set = VK_NULL_HANDLE;
+	uint32_t			defrag_id = UINT32_MAX;
+};
+
+// Central owner of the GPU buffers and images.
+// Components keep 32 bit handles instead of raw Vulkan handles / pointers and look the
+// current VkBuffer / VkImage up when they record commands, so the registry is free to
+// relocate a resource (defragmentation, streaming) behind their back. Records are kept
+// densely packed, batch work walks a plain array.
+class ResourceRegistry {
+public:
+	ResourceRegistry() = default;
+	~ResourceRegistry();
+
+	void init(CoreInstance& core_instance);
+	void cleanup();
+
+	//--------------------
+	//  Create / destroy
+	//--------------------
+	BufferHandle	create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, const MemoryPolicy& memory_policy);
+	// Creates the image (optimal tiling, exclusive) and a view over all of its mips / layers.
+	ImageHandle		create_image(const VkImageCreateInfo& image_info, const MemoryPolicy& memory_policy,
+						VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+	// The handle becomes stale at once, the Vulkan objects go through the deletion queue.
+	void			destroy(BufferHandle handle);
+	void			destroy(ImageHandle handle);
+
+	// Hands the resource to the defragmenter once the upload of `ready_ticket` (StagingRing) is done.
+	// Buffers need the transfer src + dst usages. `on_moved` runs after the buffer has been
+	// replaced, e.g. to rewrite descriptor sets or pick up the new mapped pointer.
+	void			make_movable(BufferHandle handle, uint64_t ready_ticket,
+						std::function<void(BufferHandle)> on_moved = {});
+	// Images need the transfer src + dst usages, `layout` is the layout they stay in between frames.
+	// `on_moved` runs after the image and its view have been replaced, e.g. to rewrite descriptor sets.
+	void			make_movable(ImageHandle handle, VkImageLayout layout, uint64_t ready_ticket,
+						std::function<void(ImageHandle)> on_moved = {});
+	// A movable buffer written again (StagingRing) stays put until that upload has completed.
+	void			set_ready_ticket(BufferHandle handle, uint64_t ready_ticket);
+
+	//--------------------
+	//  Lookup
+	//--------------------
+	// nullptr for null / stale handles.
+	BufferRecord*	get(BufferHandle handle);
+	ImageRecord*	get(ImageHandle handle);
+	inline bool		is_valid(BufferHandle handle) { return get(handle) != nullptr; }
+	inline bool		is_valid(ImageHandle handle) { return get(handle) != nullptr; }
+	// Throw on stale handles.
+	VkBuffer		buffer(BufferHandle handle);
+	VkImage			image(ImageHandle handle);
+	VkImageView		view(ImageHandle handle);
+
+	// Dense arrays, valid until the next create / destroy.
+	inline const std::vector<BufferRecord>& buffers() const { return m_buffers.records; }
+	inline const std::vector<ImageRecord>& images() const { return m_images.records; }
+
+	void print_stats() const;
+
+private:
+	// Sparse slots → dense records. Removing a record moves the last one into its place.
+	template<typename Record, typename Handle>
+	struct Pool {
+		struct Slot {
+			uint32_t dense = UINT32_MAX;
+			uint32_t generation = 1;
+		};
+		std::vector<Slot>		slots;
+		std::vector<uint32_t>	free_slots;
+		std::vector<Record>		records;
+		std::vector<uint32_t>	record_slots;	// dense index → slot index
+
+		Handle	add(const Record& record);
+		Record*	get(Handle handle);
+		bool	remove(Handle handle, Record& removed);
+	};
+
+	CoreInstance*							m_core_instance = nullptr;
+	Pool<BufferRecord, BufferHandle>		m_buffers;
+	Pool<ImageRecord, ImageHandle>			m_images;
+	// Indexed by slot, kept out of the records so these stay small.
+	std::vector<std::function<void(BufferHandle)>>	m_buffer_listeners;
+	std::vector<std::function<void(ImageHandle)>>	m_image_listeners;
+
+	VkImageView create_view(const ImageRecord& record);
+	void		on_buffer_moved(BufferHandle handle, const MemoryAllocation& allocation, VkBuffer buffer);
+	void		on_image_moved(ImageHandle handle, const MemoryAllocation& allocation, VkImage image);
+};
@@ -0,0 +1,237 @@
+#include "simd_culler.hpp"
+#include "core/frustum_culler.hpp"
+#include <cfloat>
+#include <chrono>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_CULLER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles any intrinsic, the kernel is only called once the CPU has been checked.
+#define SIMD_CULLER_TARGET_AVX2
+#else
+#define SIMD_CULLER_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define SIMD_CULLER_X86 0
+#endif
+
+//----------------------
+//  CPU features
+//----------------------
+static bool cpu_has_avx2()
+{
+#if SIMD_CULLER_X86
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!fma || !osxsave || !avx) return false;
+    // The OS has to save the ymm registers.
+    if ((_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#else
+    return false;
+#endif
+}
+
+static inline uint32_t lowest_bit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+// Appends base + i for every bit i of `mask`.
+static inline uint32_t append_visible(uint32_t mask, uint32_t base, uint32_t* out)
+{
+    uint32_t count = 0;
+    while (mask != 0) {
+        out[count++] = base + lowest_bit(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+bool SimdCuller::is_supported(Kernel kernel)
+{
+    switch (kernel) {
+    case Kernel::SCALAR: return true;
+    case Kernel::SSE: return SIMD_CULLER_X86 != 0;      // part of x86-64
+    case Kernel::AVX2: return cpu_has_avx2();
+    }
+    return false;
+}
+
+const char* SimdCuller::kernel_name(Kernel kernel)
+{
+    const char* names[] = { "scalar", "sse", "avx2" };
+    return names[static_cast<int>(kernel)];
+}
+
+SimdCuller::SimdCuller()
+{
+    set_kernel(Kernel::AVX2);
+}
+
+void SimdCuller::set_kernel(Kernel kernel)
+{
+    while (!is_supported(kernel)) {
+        kernel = static_cast<Kernel>(static_cast<int>(kernel) - 1);
+    }
+    m_kernel = kernel;
+}
+
+//----------------------
+//  Objects
+//----------------------
+uint32_t SimdCuller::add(const glm::vec4& sphere)
+{
+    if (m_count == m_x.size()) {
+        // A whole block of lanes at a time, the padding never passes the test.
+        m_x.resize(m_x.size() + LANES, 0.0f);
+        m_y.resize(m_y.size() + LANES, 0.0f);
+        m_z.resize(m_z.size() + LANES, 0.0f);
+        m_radius.resize(m_radius.size() + LANES, -FLT_MAX);
+        m_visible.resize(m_x.size());
+    }
+    set_sphere(m_count, sphere);
+    return m_count++;
+}
+
+void SimdCuller::set_sphere(uint32_t id, const glm::vec4& sphere)
+{
+    m_x[id] = sphere.x;
+    m_y[id] = sphere.y;
+    m_z[id] = sphere.z;
+    m_radius[id] = sphere.w;
+}
+
+void SimdCuller::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_radius.clear();
+    m_visible.clear();
+    m_count = 0;
+    m_stats = {};
+}
+
+//----------------------
+//  Culling
+//----------------------
+uint32_t SimdCuller::cull(const glm::mat4& view_projection)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    glm::vec4 planes[6];
+    extract_frustum_planes(view_projection, planes);
+
+    uint32_t visible = 0;
+    switch (m_kernel) {
+    case Kernel::SCALAR: visible = cull_scalar(planes, m_visible.data()); break;
+    case Kernel::SSE: visible = cull_sse(planes, m_visible.data()); break;
+    case Kernel::AVX2: visible = cull_avx2(planes, m_visible.data()); break;
+    }
+
+    m_stats.tested = m_count;
+    m_stats.visible = visible;
+    m_stats.microseconds = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    return visible;
+}
+
+uint32_t SimdCuller::cull_scalar(const glm::vec4 planes[6], uint32_t* out) const
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < m_count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            inside = planes[p].x * m_x[i] + planes[p].y * m_y[i] + planes[p].z * m_z[i] + planes[p].w >= -m_radius[i];
+        }
+        if (inside) out[count++] = i;
+    }
+    return count;
+}
+
+uint32_t SimdCuller::cull_sse(const glm::vec4 planes[6], uint32_t* out) const
+{
+#if SIMD_CULLER_X86
+    __m128 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm_set1_ps(planes[p].x);
+        py[p] = _mm_set1_ps(planes[p].y);
+        pz[p] = _mm_set1_ps(planes[p].z);
+        pw[p] = _mm_set1_ps(planes[p].w);
+    }
+    const __m128 zero = _mm_setzero_ps();
+
+    uint32_t count = 0;
+    const uint32_t padded = static_cast<uint32_t>(m_x.size());
+    for (uint32_t base = 0; base < padded; base += 4) {
+        __m128 x = _mm_loadu_ps(&m_x[base]);
+        __m128 y = _mm_loadu_ps(&m_y[base]);
+        __m128 z = _mm_loadu_ps(&m_z[base]);
+        __m128 negative_radius = _mm_sub_ps(zero, _mm_loadu_ps(&m_radius[base]));
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                _mm_add_ps(_mm_mul_ps(pz[p], z), pw[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negative_radius));
+        }
+        count += append_visible(static_cast<uint32_t>(_mm_movemask_ps(inside)), base, out + count);
+    }
+    return count;
+#else
+    return cull_scalar(planes, out);
+#endif
+}
+
+#if SIMD_CULLER_X86
+SIMD_CULLER_TARGET_AVX2
+#endif
+uint32_t SimdCuller::cull_avx2(const glm::vec4 planes[6], uint32_t* out) const
+{
+#if SIMD_CULLER_X86
+    __m256 px[6], py[6], pz[6], pw[6];
+    for (int p = 0; p < 6; p++) {
+        px[p] = _mm256_set1_ps(planes[p].x);
+        py[p] = _mm256_set1_ps(planes[p].y);
+        pz[p] = _mm256_set1_ps(planes[p].z);
+        pw[p] = _mm256_set1_ps(planes[p].w);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+
+    uint32_t count = 0;
+    const uint32_t padded = static_cast<uint32_t>(m_x.size());
+    for (uint32_t base = 0; base < padded; base += LANES) {
+        __m256 x = _mm256_loadu_ps(&m_x[base]);
+        __m256 y = _mm256_loadu_ps(&m_y[base]);
+        __m256 z = _mm256_loadu_ps(&m_z[base]);
+        __m256 negative_radius = _mm256_sub_ps(zero, _mm256_loadu_ps(&m_radius[base]));
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_fmadd_ps(px[p], x, _mm256_fmadd_ps(py[p], y, _mm256_fmadd_ps(pz[p], z, pw[p])));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+        }
+        count += append_visible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), base, out + count);
+    }
+    return count;
+#else
+    return cull_scalar(planes, out);
+#endif
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+// CPU frustum culling for devices where the compute path (FrustumCuller) is not an option.
+// Bounding spheres are kept as SoA arrays (centers x / y / z, radii) padded to a multiple
+// of 8, so the kernels test 4 (SSE) or 8 (AVX2) spheres per instruction against each of the
+// six planes and write the ids of the visible ones to a compact list. The kernel is picked
+// from the CPU at construction, set_kernel() forces one to compare them.
+class SimdCuller {
+public:
+	enum class Kernel {
+		SCALAR,
+		SSE,	// 4 spheres per instruction
+		AVX2,	// 8 spheres per instruction, with FMA
+	};
+	struct Stats {
+		uint32_t	tested = 0;
+		uint32_t	visible = 0;
+		double		microseconds = 0.0;
+	};
+
+	SimdCuller();
+
+	//--------------------
+	//  Objects
+	//--------------------
+	// xyz center, w radius, in the space `view_projection` is applied to. Returns the id.
+	uint32_t		add(const glm::vec4& sphere);
+	void			set_sphere(uint32_t id, const glm::vec4& sphere);
+	void			clear();
+	inline uint32_t	size() const { return m_count; }
+
+	//--------------------
+	//  Culling
+	//--------------------
+	// Returns the number of spheres inside the frustum, their ids are in visible().
+	uint32_t		cull(const glm::mat4& view_projection);
+	// Ascending ids, valid until the next cull() / add().
+	inline const uint32_t*	visible() const { return m_visible.data(); }
+	inline uint32_t	visible_count() const { return m_stats.visible; }
+	inline const Stats&	last_stats() const { return m_stats; }
+
+	// Falls back to the best supported kernel when `kernel` is not.
+	void			set_kernel(Kernel kernel);
+	inline Kernel	kernel() const { return m_kernel; }
+	static bool		is_supported(Kernel kernel);
+	static const char* kernel_name(Kernel kernel);
+
+	static const uint32_t LANES = 8;	// padding of the arrays, the widest kernel
+
+private:
+	std::vector<float>		m_x;
+	std::vector<float>		m_y;
+	std::vector<float>		m_z;
+	std::vector<float>		m_radius;	// padding : -FLT_MAX, never visible
+	uint32_t				m_count = 0;
+
+	std::vector<uint32_t>	m_visible;	// sized like the arrays, the kernels write without checks
+	Kernel					m_kernel = Kernel::SCALAR;
+	Stats					m_stats;
+
+	uint32_t		cull_scalar(const glm::vec4 planes[6], uint32_t* out) const;
+	uint32_t		cull_sse(const glm::vec4 planes[6], uint32_t* out) const;
+	uint32_t		cull_avx2(const glm::vec4 planes[6], uint32_t* out) const;
+};
@@ -0,0 +1,355 @@
+#include "staging_ring.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+StagingRing::~StagingRing()
+{
+    cleanup();
+}
+
+void StagingRing::init(CoreInstance& core_instance, VkDeviceSize size)
+{
+    m_core_instance = &core_instance;
+
+    // vkCmdCopyBufferToImage needs the source offset to be a multiple of the texel size (and 4).
+    // Whole image copies are also valid on transfer only queues with a coarse minImageTransferGranularity.
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(core_instance.get_physical_device(), &properties);
+    m_alignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+    m_size = (size + m_alignment - 1) & ~(m_alignment - 1);
+
+    createBuffer(
+        core_instance,
+        m_size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        MemoryUsage::UPLOAD,
+        m_buffer,
+        m_allocation);
+
+    auto families = core_instance.get_queuefailmy_indexs();
+    m_graphic_family = families->graphic_queuefamily_index.value();
+    m_transfer_family = families->transfer_queuefamily_index.value();
+    m_dedicated_transfer = core_instance.has_dedicated_transfer_queue();
+    if (m_dedicated_transfer) {
+        m_transfer_context.init(core_instance, m_transfer_family, core_instance.transfer_queue());
+        m_copies = &m_transfer_context;
+    }
+    else {
+        m_copies = &core_instance.immediate();
+    }
+}
+
+void StagingRing::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    flush();
+    while (!m_in_flight.empty()) {
+        wait_oldest();
+    }
+    recycle_handoffs(true);
+
+    for (VkSemaphore semaphore : m_free_semaphores) {
+        vkDestroySemaphore(m_core_instance->get_device(), semaphore, m_core_instance->allocation_callbacks());
+    }
+    m_free_semaphores.clear();
+    m_transfer_context.cleanup();
+    destroyBuffer(*m_core_instance, m_buffer, m_allocation);
+    m_core_instance = nullptr;
+}
+
+uint64_t StagingRing::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    VkBuffer src_buffer;
+    VkDeviceSize src_offset;
+    void* dst_ptr;
+    reserve(size, src_buffer, src_offset, dst_ptr);
+    memcpy(dst_ptr, data, static_cast<size_t>(size));
+
+    VkCommandBuffer cmd = begin_batch();
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = src_offset;
+    copyRegion.dstOffset = dst_offset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(cmd, src_buffer, dst, 1, &copyRegion);
+
+    if (m_dedicated_transfer) {
+        VkBufferMemoryBarrier transfer{};
+        transfer.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        transfer.srcQueueFamilyIndex = m_transfer_family;
+        transfer.dstQueueFamilyIndex = m_graphic_family;
+        transfer.buffer = dst;
+        transfer.offset = dst_offset;
+        transfer.size = size;
+        m_buffer_transfers.push_back(transfer);
+    }
+    return m_recording.ticket;
+}
+
+uint64_t StagingRing::upload_image(VkImage dst, VkExtent3D extent, const void* data, VkDeviceSize size, VkImageLayout final_layout)
+{
+    VkBuffer src_buffer;
+    VkDeviceSize src_offset;
+    void* dst_ptr;
+    reserve(size, src_buffer, src_offset, dst_ptr);
+    memcpy(dst_ptr, data, static_cast<size_t>(size));
+
+    VkCommandBuffer cmd = begin_batch();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = dst;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // Undefined → transfer destination
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = src_offset;
+    region.bufferRowLength = 0;     // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = extent;
+    vkCmdCopyBufferToImage(cmd, src_buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // Transfer destination → final layout. On a dedicated transfer queue the layout
+    // change is part of the ownership transfer recorded at flush time.
+    if (m_dedicated_transfer) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = final_layout;
+        barrier.srcQueueFamilyIndex = m_transfer_family;
+        barrier.dstQueueFamilyIndex = m_graphic_family;
+        m_image_transfers.push_back(barrier);
+    }
+    else if (final_layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = final_layout;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    return m_recording.ticket;
+}
+
+void StagingRing::flush()
+{
+    if (!m_is_recording) return;
+
+    if (m_dedicated_transfer) {
+        submit_with_ownership_transfer();
+    }
+    else {
+        // The batch ends with a barrier, frames submitted after it see the copied
+        // resources without waiting on the CPU.
+        m_copies->submit();
+    }
+
+    m_recording.ring_end = m_head;
+    m_in_flight.push_back(std::move(m_recording));
+    m_recording = Batch{};
+    m_is_recording = false;
+}
+
+void StagingRing::submit_with_ownership_transfer()
+{
+    //----------------
+    //  Release (transfer queue)
+    //----------------
+    // The destination access of a release is ignored, the acquire below defines it.
+    for (auto& transfer : m_buffer_transfers) {
+        transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        transfer.dstAccessMask = 0;
+    }
+    for (auto& transfer : m_image_transfers) {
+        transfer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        transfer.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(m_copies->record(),
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0, 0, nullptr,
+        static_cast<uint32_t>(m_buffer_transfers.size()), m_buffer_transfers.data(),
+        static_cast<uint32_t>(m_image_transfers.size()), m_image_transfers.data());
+
+    recycle_handoffs(false);
+    Handoff handoff{};
+    if (!m_free_semaphores.empty()) {
+        handoff.semaphore = m_free_semaphores.back();
+        m_free_semaphores.pop_back();
+    }
+    else {
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(m_core_instance->get_device(), &semaphoreInfo, m_core_instance->allocation_callbacks(), &handoff.semaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create semaphore!");
+        }
+    }
+    m_copies->signal_semaphore(handoff.semaphore);
+    m_copies->submit();
+
+    //----------------
+    //  Acquire (graphic queue)
+    //----------------
+    // Same barriers again with the destination access, submitted ahead of the frame.
+    // Buffers may be read as geometry, by the culling compute pass or as indirect commands.
+    for (auto& transfer : m_buffer_transfers) {
+        transfer.srcAccessMask = 0;
+        transfer.dstAccessMask =
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+            VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    }
+    for (auto& transfer : m_image_transfers) {
+        transfer.srcAccessMask = 0;
+        transfer.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    const VkPipelineStageFlags consumer_stages =
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    // Only the consumer stages wait for the copies, the frame itself keeps going.
+    ImmediateContext& graphic = m_core_instance->immediate();
+    graphic.wait_semaphore(handoff.semaphore, consumer_stages);
+    vkCmdPipelineBarrier(graphic.record(),
+        consumer_stages, consumer_stages,
+        0, 0, nullptr,
+        static_cast<uint32_t>(m_buffer_transfers.size()), m_buffer_transfers.data(),
+        static_cast<uint32_t>(m_image_transfers.size()), m_image_transfers.data());
+    handoff.acquire_ticket = graphic.current_ticket();
+    graphic.submit();
+    m_handoffs.push_back(handoff);
+
+    m_buffer_transfers.clear();
+    m_image_transfers.clear();
+}
+
+void StagingRing::retire()
+{
+    while (!m_in_flight.empty() && m_copies->poll(m_in_flight.front().ticket)) {
+        release(m_in_flight.front());
+        m_in_flight.pop_front();
+    }
+    recycle_handoffs(false);
+}
+
+void StagingRing::wait(uint64_t ticket)
+{
+    if (m_is_recording && ticket >= m_recording.ticket) {
+        flush();
+    }
+    while (!is_complete(ticket) && !m_in_flight.empty()) {
+        wait_oldest();
+    }
+}
+
+VkCommandBuffer StagingRing::begin_batch()
+{
+    VkCommandBuffer cmd = m_copies->record();
+    // The shared context may have been submitted by someone else since the last upload,
+    // the ring space is then retired with the latest ticket.
+    m_recording.ticket = m_copies->current_ticket();
+    m_is_recording = true;
+    return cmd;
+}
+
+void StagingRing::reserve(VkDeviceSize size, VkBuffer& src_buffer, VkDeviceSize& src_offset, void*& dst_ptr)
+{
+    // Bigger than the whole ring: give this upload its own staging buffer,
+    // it is released together with the batch.
+    if (size > m_size) {
+        begin_batch();
+        TransientBuffer transient{};
+        createBuffer(
+            *m_core_instance,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            MemoryUsage::UPLOAD,
+            transient.buffer,
+            transient.allocation);
+        m_recording.transient_buffers.push_back(transient);
+
+        src_buffer = transient.buffer;
+        src_offset = 0;
+        dst_ptr = transient.allocation.mapped;
+        return;
+    }
+
+    while (true) {
+        uint64_t position = (m_head + m_alignment - 1) & ~(m_alignment - 1);
+        // Never split an upload at the end of the ring, skip to the start instead.
+        if (position % m_size + size > m_size) {
+            position += m_size - position % m_size;
+        }
+        if (position + size - m_tail <= m_size) {
+            m_head = position + size;
+            src_buffer = m_buffer;
+            src_offset = position % m_size;
+            dst_ptr = static_cast<char*>(m_allocation.mapped) + src_offset;
+            return;
+        }
+
+        // Ring is full, the space of the oldest batch has to come back first.
+        if (m_in_flight.empty() && m_is_recording) {
+            flush();
+        }
+        if (m_in_flight.empty()) {
+            // Nothing left on the GPU, restart at the beginning of the ring.
+            m_head = m_tail = position - position % m_size;
+            continue;
+        }
+        wait_oldest();
+    }
+}
+
+void StagingRing::wait_oldest()
+{
+    Batch& batch = m_in_flight.front();
+    m_copies->wait(batch.ticket);
+    release(batch);
+    m_in_flight.pop_front();
+}
+
+void StagingRing::release(Batch& batch)
+{
+    m_tail = batch.ring_end;
+    m_completed_ticket = batch.ticket;
+    for (auto& transient : batch.transient_buffers) {
+        destroyBuffer(*m_core_instance, transient.buffer, transient.allocation);
+    }
+    batch.transient_buffers.clear();
+}
+
+void StagingRing::recycle_handoffs(bool wait)
+{
+    ImmediateContext& graphic = m_core_instance->immediate();
+    while (!m_handoffs.empty()) {
+        const Handoff& handoff = m_handoffs.front();
+        if (wait) {
+            graphic.wait(handoff.acquire_ticket);
+        }
+        else if (!graphic.poll(handoff.acquire_ticket)) {
+            break;
+        }
+        m_free_semaphores.push_back(handoff.semaphore);
+        m_handoffs.pop_front();
+    }
+}
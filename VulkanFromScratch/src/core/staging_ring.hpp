@@ -0,0 +1,104 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include "./core/memory_allocator.hpp"
+#include "./core/immediate_context.hpp"
+
+class CoreInstance;
+
+// Shared upload path from the CPU to device local resources.
+// One persistently mapped staging buffer is used as a ring: upload_* copies the data
+// into the ring and records the GPU copy into an ImmediateContext batch, flush() submits it.
+// Ring space is retired once that batch's ticket has completed, so no resource has to keep
+// its own staging buffer alive.
+//
+// Without a dedicated transfer queue the copies share CoreInstance::immediate() with the
+// other one-shot commands. With one, the ring keeps its own ImmediateContext on that queue:
+// every destination is released to the graphic queue family and acquired again by
+// CoreInstance::immediate(), which waits on the batch's semaphore.
+class StagingRing {
+public:
+	StagingRing() = default;
+	~StagingRing();
+
+	// CoreInstance::immediate() has to be initialized first.
+	void init(CoreInstance& core_instance, VkDeviceSize size);
+	void cleanup();
+
+	//--------------------
+	//  Upload
+	//--------------------
+	// The destination has to be created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+	// Returns the ticket of the batch the copy was recorded into.
+	uint64_t upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+	// Copies tightly packed texels into mip 0 / layer 0 and leaves the image in `final_layout`.
+	// The image is expected to be in VK_IMAGE_LAYOUT_UNDEFINED (its content is discarded).
+	uint64_t upload_image(VkImage dst, VkExtent3D extent, const void* data, VkDeviceSize size,
+		VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// Submits everything recorded so far. Does nothing when the batch is empty.
+	// Call it before submitting the frame that uses the data: the graphic queue
+	// gets a barrier (or the ownership acquire) ahead of the frame, no CPU wait is needed.
+	void flush();
+	// Releases the ring space of every batch that has completed (does not block).
+	void retire();
+	// Blocks until the batch of `ticket` has finished on the GPU.
+	void wait(uint64_t ticket);
+	inline bool is_complete(uint64_t ticket) const { return ticket <= m_completed_ticket; }
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	inline VkDeviceSize capacity() const { return m_size; }
+	inline VkDeviceSize bytes_in_flight() const { return m_head - m_tail; }
+
+private:
+	struct TransientBuffer {
+		VkBuffer			buffer = VK_NULL_HANDLE;
+		MemoryAllocation	allocation;
+	};
+	// Ring space and transient buffers used by the uploads of one ticket.
+	struct Batch {
+		uint64_t			ticket = 0;
+		uint64_t			ring_end = 0;	// ring position to retire to once the ticket has completed
+		std::vector<TransientBuffer> transient_buffers;	// uploads larger than the ring
+	};
+	// Copies done → acquire may run. Reusable once the acquire's ticket has completed.
+	struct Handoff {
+		VkSemaphore			semaphore = VK_NULL_HANDLE;
+		uint64_t			acquire_ticket = 0;
+	};
+
+	CoreInstance*			m_core_instance = nullptr;
+	VkBuffer				m_buffer = VK_NULL_HANDLE;
+	MemoryAllocation		m_allocation;
+	VkDeviceSize			m_size = 0;
+	VkDeviceSize			m_alignment = 16;
+	// Monotonic positions, the physical offset is (position % m_size).
+	uint64_t				m_head = 0;
+	uint64_t				m_tail = 0;
+
+	bool					m_dedicated_transfer = false;
+	uint32_t				m_transfer_family = 0;
+	uint32_t				m_graphic_family = 0;
+	ImmediateContext		m_transfer_context;		// dedicated transfer queue only
+	ImmediateContext*		m_copies = nullptr;		// context the copies are recorded into
+	// Queue family ownership transfers of the batch being recorded.
+	std::vector<VkBufferMemoryBarrier>	m_buffer_transfers;
+	std::vector<VkImageMemoryBarrier>	m_image_transfers;
+	Batch					m_recording;
+	bool					m_is_recording = false;
+	std::deque<Batch>		m_in_flight;
+	std::deque<Handoff>		m_handoffs;
+	std::vector<VkSemaphore> m_free_semaphores;
+	uint64_t				m_completed_ticket = 0;
+
+	void		submit_with_ownership_transfer();
+	VkCommandBuffer begin_batch();
+	// Returns the source buffer / offset for `size` bytes, waiting for old batches if the ring is full.
+	void		reserve(VkDeviceSize size, VkBuffer& src_buffer, VkDeviceSize& src_offset, void*& dst_ptr);
+	void		wait_oldest();
+	void		release(Batch& batch);
+	void		recycle_handoffs(bool wait);
+};
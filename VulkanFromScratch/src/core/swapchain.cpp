@@ -1,9 +1,10 @@
 #include "swapchain.hpp"
 #include <stdexcept>
 #include <iostream>
+#include <cstdio>
 
 SwapChain::SwapChain(CoreInstance& core_instance, const unsigned int w, const unsigned int h) : 
-	m_core_instance{ core_instance },m_width{ w }, m_height{h}
+	m_core_instance{ core_instance },m_width{ w }, m_height{h}, m_window_extent{ w, h }
 {
 	//---------------------------
 	// 	   Get Support
@@ -22,7 +23,43 @@ SwapChain::SwapChain(CoreInstance& core_instance, const unsigned int w, const un
 
 SwapChain::~SwapChain()
 {
-	vkDestroySwapchainKHR(m_core_instance.get_device(), m_swapchain, nullptr);
+	vkDestroySwapchainKHR(m_core_instance.get_device(), m_swapchain, m_core_instance.allocation_callbacks());
+}
+
+bool SwapChain::window_resized() const
+{
+	int w = 0, h = 0;
+	glfwGetFramebufferSize(&m_core_instance.window(), &w, &h);
+	return static_cast<uint32_t>(w) != m_window_extent.width || static_cast<uint32_t>(h) != m_window_extent.height;
+}
+
+void SwapChain::recreate()
+{
+	// A minimized window has a zero sized framebuffer, there is nothing to present to.
+	int w = 0, h = 0;
+	glfwGetFramebufferSize(&m_core_instance.window(), &w, &h);
+	while (w == 0 || h == 0) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(&m_core_instance.window(), &w, &h);
+	}
+	m_window_extent = VkExtent2D{ static_cast<uint32_t>(w), static_cast<uint32_t>(h) };
+
+	// The frames in flight still render to (and present) the old images.
+	vkDeviceWaitIdle(m_core_instance.get_device());
+	destroy_image_views();
+
+	query_support();
+	VkSurfaceFormatKHR  surface_format = choose_swap_surface_format(m_support_details.formats);
+	VkPresentModeKHR  present_mode = choose_swap_present_mode(m_support_details.presentModes);
+	VkExtent2D  extent = choose_swap_extent(m_support_details.capabilities, m_window_extent.width, m_window_extent.height);
+
+	// Handed to the new swap chain as oldSwapchain, destroyed once it is retired.
+	VkSwapchainKHR old_swapchain = m_swapchain;
+	create_swap_chain(surface_format, present_mode, extent);
+	vkDestroySwapchainKHR(m_core_instance.get_device(), old_swapchain, m_core_instance.allocation_callbacks());
+	create_images();
+	create_image_view();
+	printf("[SwapChain] recreated at %ux%u \n", m_width, m_height);
 }
 
 void SwapChain::create_swap_chain(const VkSurfaceFormatKHR& surface_format, const VkPresentModeKHR& present_mode, const VkExtent2D& extent)
@@ -39,6 +76,8 @@ void SwapChain::create_swap_chain(const VkSurfaceFormatKHR& surface_format, cons
 	m_swapChain_images.resize(m_image_count);
 	m_swapChain_image_format = surface_format.format;
 	m_swapChain_extent = extent;
+	m_width = extent.width;
+	m_height = extent.height;
 
 	//---------------------------
 	// 	   Create Info
@@ -82,11 +121,13 @@ void SwapChain::create_swap_chain(const VkSurfaceFormatKHR& surface_format, cons
 	createInfo.presentMode = present_mode;
 	//we don't care about the color of pixels that are obscured, for example because another window is in front of them.
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Null on the first creation. On a recreation, lets the presentation engine hand the
+	// resources of the old swap chain over.
+	createInfo.oldSwapchain = m_swapchain;
 
 
 	try {
-		if (vkCreateSwapchainKHR(m_core_instance.get_device(), &createInfo, nullptr, &m_swapchain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(m_core_instance.get_device(), &createInfo, m_core_instance.allocation_callbacks(), &m_swapchain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
 		}
 	}
@@ -206,7 +247,7 @@ void SwapChain::create_image_view()
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(m_core_instance.get_device(), &createInfo, nullptr, &m_swapChain_image_views[i]) != VK_SUCCESS) {
+		if (vkCreateImageView(m_core_instance.get_device(), &createInfo, m_core_instance.allocation_callbacks(), &m_swapChain_image_views[i]) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image views!");
 		}
 	}
@@ -224,15 +265,21 @@ void SwapChain::create_images()
 
 }
 
-void SwapChain::clean()
+void SwapChain::destroy_image_views()
 {
 	for (auto imageView : m_swapChain_image_views) {
-		vkDestroyImageView(m_core_instance.get_device(), imageView, nullptr);
+		vkDestroyImageView(m_core_instance.get_device(), imageView, m_core_instance.allocation_callbacks());
 	}
+	m_swapChain_image_views.clear();
+}
+
+void SwapChain::clean()
+{
+	destroy_image_views();
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		vkDestroySemaphore(	m_core_instance.get_device(), m_imageAvailableSemaphores[i], nullptr);
-		vkDestroySemaphore(	m_core_instance.get_device(), m_renderFinishedSemaphores[i], nullptr);
-		vkDestroyFence(		m_core_instance.get_device(), m_inFlightFences[i], nullptr);	
+		vkDestroySemaphore(	m_core_instance.get_device(), m_imageAvailableSemaphores[i], m_core_instance.allocation_callbacks());
+		vkDestroySemaphore(	m_core_instance.get_device(), m_renderFinishedSemaphores[i], m_core_instance.allocation_callbacks());
+		vkDestroyFence(		m_core_instance.get_device(), m_inFlightFences[i], m_core_instance.allocation_callbacks());	
 	}
 
 	// command buffers are freed for us when we free the command pool.
@@ -253,9 +300,9 @@ void SwapChain::create_syncobjects()
 	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Default is signaled. The first vkWaitforfence will not wait.
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-		if (vkCreateSemaphore(m_core_instance.get_device(), &semaphoreInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(m_core_instance.get_device(), &semaphoreInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(m_core_instance.get_device(), &fenceInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS) {
+		if (vkCreateSemaphore(m_core_instance.get_device(), &semaphoreInfo, m_core_instance.allocation_callbacks(), &m_imageAvailableSemaphores[i]) != VK_SUCCESS ||
+			vkCreateSemaphore(m_core_instance.get_device(), &semaphoreInfo, m_core_instance.allocation_callbacks(), &m_renderFinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateFence(m_core_instance.get_device(), &fenceInfo, m_core_instance.allocation_callbacks(), &m_inFlightFences[i]) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create semaphores!");
 		}
 	}
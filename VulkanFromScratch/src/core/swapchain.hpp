@@ -31,6 +31,13 @@ public :
     inline const VkSemaphore get_avaliable_semaphore(){ return m_imageAvailableSemaphores[m_currentFrame]; }  // todo: auto fence pool
     inline const VkSemaphore get_finish_semaphore() { return m_renderFinishedSemaphores[m_currentFrame]; }  // todo: auto fence pool
 
+    // The window's framebuffer no longer matches the size the swap chain was created for.
+    bool window_resized() const;
+    // Waits for the device (and for a minimized window to come back), then replaces the swap
+    // chain and its image views at the window's size. Framebuffers on the old views are left
+    // to the caller (Renderer::recreate_swapchain).
+    void recreate();
+
     //VkSemaphore m_imageAvailableSemaphore;
     //VkSemaphore m_renderFinishedSemaphore;
     //VkFence m_inFlightFence;
@@ -38,15 +45,17 @@ public :
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
     std::vector<VkFence> m_inFlightFences;
 
-    void update_frame_count() { (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT; };
+    // Moves to the next frame in flight : its fence, semaphores, command buffer and ring regions.
+    void update_frame_count() { m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT; };
 private:
-    const unsigned int m_width;
-    const unsigned int m_height;
+    unsigned int m_width;
+    unsigned int m_height;
+    VkExtent2D                  m_window_extent;    // framebuffer size asked for, before clamping
     CoreInstance&               m_core_instance;
     SwapChainSupportDetails     m_support_details{};
     uint32_t                    m_image_count;
     uint32_t                    m_currentFrame = 0;
-    VkSwapchainKHR              m_swapchain;
+    VkSwapchainKHR              m_swapchain = VK_NULL_HANDLE;
     //-----------------
     //   Images
     //-----------------
@@ -60,6 +69,7 @@ private:
     void query_support();
     void create_images();
     void create_image_view();
+    void destroy_image_views();
     void clean();
     void create_syncobjects();
     VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -67,6 +77,5 @@ private:
     VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities, const unsigned int w, const unsigned int h);
 };
 
-// ToDo:
-//  * Swap chain recreation
+// Swap chain recreation
 //      https://vulkan-tutorial.com/en/Drawing_a_triangle/Swap_chain_recreation
\ No newline at end of file
@@ -24,26 +24,18 @@ public:
 
 
     void updateUniformBuffer(uint32_t currentImage);
+    // proj * view * model of the uniform, what the culling of IndirectDrawList tests against.
+    glm::mat4 view_projection() const;
     void bind(VkCommandBuffer& cmdbuffer, unsigned int currentFrame , VkPipelineLayout& pipeline_layout);
 
-    VkDescriptorSetLayout      m_descriptorSetLayout;
     VkDescriptorSetLayout      get_descriptorset_layout() override;
     void                       update(FrameUpdateData& updateData) override;
 private:
     void cleanup();
+    UniformBufferObject make_uniform() const;
 
     CoreInstance& m_core_instance;
-    void createDescriptorSetLayout();
-    void createUniformBuffers();
-    void createDescriptorPool();
-    void createDescriptorSets();
-    //VkPipelineLayout            m_pipelineLayout;
-    VkDescriptorPool            m_descriptorPool;
-    std::vector<VkDescriptorSet> m_descriptorSets;
-    
-    std::vector<VkBuffer>       m_uniformBuffers;
-    std::vector<VkDeviceMemory> m_uniformBuffersMemory;
-    std::vector<void*>          m_uniformBuffersMapped;
-
-    int MAX_FRAMES_IN_FLIGHT = 2; //temp
+    // The uniform data lives in CoreInstance::uniform_ring(), one slice per frame.
+    // All transform objects share the ring's dynamic descriptor set of the frame.
+    uint32_t                    m_dynamic_offset = 0;
 };
\ No newline at end of file
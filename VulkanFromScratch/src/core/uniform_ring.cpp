@@ -0,0 +1,174 @@
+#include "uniform_ring.hpp"
+#include "core/core_fwd.h"
+#include <stdexcept>
+
+UniformRing::~UniformRing()
+{
+    cleanup();
+}
+
+void UniformRing::init(CoreInstance& core_instance, uint32_t frame_count, VkDeviceSize frame_size)
+{
+    m_core_instance = &core_instance;
+
+    // Every dynamic offset has to be a multiple of minUniformBufferOffsetAlignment.
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(core_instance.get_physical_device(), &properties);
+    m_alignment = properties.limits.minUniformBufferOffsetAlignment;
+    m_frame_size = (frame_size + m_alignment - 1) & ~(m_alignment - 1);
+
+    // ReBAR memory when available. Transfer usages for the defragmenter's copy,
+    // the content only matters for the frames in flight which keep the old buffer.
+    auto& resources = core_instance.resources();
+    m_buffer = resources.create_buffer(
+        m_frame_size * frame_count,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        MemoryUsage::DYNAMIC);
+    m_mapped = resources.get(m_buffer)->allocation.mapped;
+    resources.make_movable(m_buffer, 0, [this](BufferHandle) { on_moved(); });
+
+    m_frame_sets.resize(frame_count);
+    createDescriptorSetLayout();
+    createDescriptorPool(frame_count);
+    begin_frame(0);
+}
+
+void UniformRing::cleanup()
+{
+    if (m_core_instance == nullptr) return;
+
+    // Descriptor sets are freed together with the pool.
+    vkDestroyDescriptorPool(m_core_instance->get_device(), m_descriptorPool, m_core_instance->allocation_callbacks());
+    vkDestroyDescriptorSetLayout(m_core_instance->get_device(), m_descriptorSetLayout, m_core_instance->allocation_callbacks());
+    m_core_instance->resources().destroy(m_buffer);
+    m_buffer = {};
+    m_mapped = nullptr;
+    m_frame_sets.clear();
+    m_core_instance = nullptr;
+}
+
+void UniformRing::begin_frame(uint32_t frame)
+{
+    m_frame = frame;
+    m_frame_begin = m_frame_size * frame;
+    m_head = m_frame_begin;
+    // The buffer has moved since this frame was last recorded, its fence has signaled
+    // so its sets can be rewritten.
+    if (m_frame_sets[frame].buffer != m_core_instance->resources().buffer(m_buffer)) {
+        rewrite_frame_sets(frame);
+    }
+}
+
+UniformRing::Allocation UniformRing::allocate(VkDeviceSize size)
+{
+    VkDeviceSize offset = (m_head + m_alignment - 1) & ~(m_alignment - 1);
+    if (offset + size > m_frame_begin + m_frame_size) {
+        throw std::runtime_error("uniform ring is full for this frame!");
+    }
+    m_head = offset + size;
+
+    Allocation allocation{};
+    allocation.data = static_cast<char*>(m_mapped) + offset;
+    allocation.offset = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+VkDescriptorSet UniformRing::get_descriptor_set(VkDeviceSize range)
+{
+    FrameSets& frame_sets = m_frame_sets[m_frame];
+    auto it = frame_sets.sets.find(range);
+    if (it != frame_sets.sets.end()) {
+        return it->second;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(m_core_instance->get_device(), &allocInfo, &set) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+    frame_sets.buffer = m_core_instance->resources().buffer(m_buffer);
+    write_descriptor_set(set, frame_sets.buffer, range);
+    frame_sets.sets[range] = set;
+    return set;
+}
+
+void UniformRing::write_descriptor_set(VkDescriptorSet set, VkBuffer buffer, VkDeviceSize range)
+{
+    // The offset stays 0 here, the real position is given as dynamic offset at bind time.
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = range;
+
+    VkWriteDescriptorSet descriptorWrite{};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = set;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrite.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(m_core_instance->get_device(), 1, &descriptorWrite, 0, nullptr);
+}
+
+void UniformRing::rewrite_frame_sets(uint32_t frame)
+{
+    FrameSets& frame_sets = m_frame_sets[frame];
+    frame_sets.buffer = m_core_instance->resources().buffer(m_buffer);
+    for (const auto& entry : frame_sets.sets) {
+        write_descriptor_set(entry.second, frame_sets.buffer, entry.first);
+    }
+}
+
+void UniformRing::on_moved()
+{
+    // Moves happen in Defragmenter::step(), after begin_frame() and before anything is
+    // written for this frame : its sets are free, the other frames catch up in begin_frame().
+    m_mapped = m_core_instance->resources().get(m_buffer)->allocation.mapped;
+    rewrite_frame_sets(m_frame);
+}
+
+void UniformRing::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding uboLayoutBinding{};
+    uboLayoutBinding.binding = 0;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    uboLayoutBinding.descriptorCount = 1;
+    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &uboLayoutBinding;
+
+    if (vkCreateDescriptorSetLayout(
+        m_core_instance->get_device(),
+        &layoutInfo, m_core_instance->allocation_callbacks(), &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+}
+
+void UniformRing::createDescriptorPool(uint32_t frame_count)
+{
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSize.descriptorCount = MAX_DESCRIPTOR_SETS * frame_count;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = MAX_DESCRIPTOR_SETS * frame_count;
+
+    if (vkCreateDescriptorPool(
+        m_core_instance->get_device(),
+        &poolInfo, m_core_instance->allocation_callbacks(), &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include "./core/resource_registry.hpp"
+
+class CoreInstance;
+
+// Per frame linear allocator for transient uniform data.
+// Every frame in flight owns one region of a single persistently mapped buffer.
+// Objects bump-allocate an aligned slice each frame and bind the shared
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC set with the returned offset,
+// so per-object constants no longer need their own buffer / memory / descriptor set.
+// The buffer belongs to CoreInstance::resources() and may be moved by the defragmenter
+// between frames, so every frame in flight has its own sets : a move only rewrites the
+// sets of frames the GPU is done with.
+class UniformRing {
+public:
+	UniformRing() = default;
+	~UniformRing();
+
+	struct Allocation {
+		void*		data = nullptr;		// write the constants here
+		uint32_t	offset = 0;			// dynamic offset for vkCmdBindDescriptorSets
+	};
+
+	// CoreInstance::resources() has to be initialized first.
+	void init(CoreInstance& core_instance, uint32_t frame_count, VkDeviceSize frame_size);
+	void cleanup();
+
+	// Call once the fence of `frame` has signaled, everything allocated
+	// for that frame the last time around is free again.
+	void		begin_frame(uint32_t frame);
+	Allocation	allocate(VkDeviceSize size);
+
+	//--------------------
+	//  Get / set
+	//--------------------
+	// One set per distinct range and frame, all sets point at the same ring buffer.
+	// Look it up every frame (after begin_frame), the set changes with the frame.
+	VkDescriptorSet get_descriptor_set(VkDeviceSize range);
+	inline VkDescriptorSetLayout get_descriptorset_layout() const { return m_descriptorSetLayout; }
+	inline VkDeviceSize bytes_used() const { return m_head - m_frame_begin; }
+
+	static const uint32_t MAX_DESCRIPTOR_SETS = 16;
+
+private:
+	// Sets of one frame in flight and the buffer they were written with.
+	struct FrameSets {
+		std::map<VkDeviceSize, VkDescriptorSet> sets;
+		VkBuffer			buffer = VK_NULL_HANDLE;
+	};
+
+	CoreInstance*			m_core_instance = nullptr;
+	BufferHandle			m_buffer;
+	void*					m_mapped = nullptr;
+	VkDeviceSize			m_frame_size = 0;
+	VkDeviceSize			m_alignment = 1;
+	VkDeviceSize			m_frame_begin = 0;
+	VkDeviceSize			m_head = 0;
+	uint32_t				m_frame = 0;
+
+	VkDescriptorSetLayout	m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool		m_descriptorPool = VK_NULL_HANDLE;
+	std::vector<FrameSets>	m_frame_sets;
+
+	void createDescriptorSetLayout();
+	void createDescriptorPool(uint32_t frame_count);
+	void write_descriptor_set(VkDescriptorSet set, VkBuffer buffer, VkDeviceSize range);
+	void rewrite_frame_sets(uint32_t frame);
+	void on_moved();
+};
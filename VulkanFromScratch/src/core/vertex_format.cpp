@@ -0,0 +1,233 @@
+#include "vertex_format.hpp"
+#include "core/core_fwd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+const char* vertex_format_name(VertexFormat format)
+{
+    switch (format) {
+    case VertexFormat::FULL: return "full";
+    case VertexFormat::PACKED_SNORM16: return "snorm16";
+    case VertexFormat::PACKED_HALF: return "half";
+    }
+    return "unknown";
+}
+
+uint32_t vertex_stride(VertexFormat format)
+{
+    return format == VertexFormat::FULL ? sizeof(Model::Vertex) : sizeof(PackedVertex);
+}
+
+VertexInputDescription vertex_input_description(VertexFormat format)
+{
+    // Same locations for every format, the input assembler does the decode
+    // (snorm / half / unorm → float), the shader only applies VertexDequantization.
+    switch (format) {
+    case VertexFormat::PACKED_SNORM16: return VertexInputDescription::of<PackedVertexSnorm16, InstanceData>();
+    case VertexFormat::PACKED_HALF: return VertexInputDescription::of<PackedVertexHalf, InstanceData>();
+    default: return VertexInputDescription::of<Model::Vertex, InstanceData>();
+    }
+}
+
+InstanceData InstanceData::from_matrix(const glm::mat4& model)
+{
+    // glm is column major, model[column][row]
+    InstanceData instance;
+    instance.model_row0 = glm::vec4(model[0][0], model[1][0], model[2][0], model[3][0]);
+    instance.model_row1 = glm::vec4(model[0][1], model[1][1], model[2][1], model[3][1]);
+    instance.model_row2 = glm::vec4(model[0][2], model[1][2], model[2][2], model[3][2]);
+    return instance;
+}
+
+VkPushConstantRange vertex_push_constant_range()
+{
+    VkPushConstantRange range{};
+    range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    range.offset = 0;
+    range.size = sizeof(VertexDequantization);
+    return range;
+}
+
+//----------------------
+//  Encoding
+//----------------------
+// Round to nearest even, overflow goes to infinity.
+uint16_t float_to_half(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t result;
+    if (bits >= (127u + 16u) << 23) {
+        // Inf / NaN (or too large)
+        result = bits > (255u << 23) ? 0x7E00 : 0x7C00;
+    }
+    else if (bits < (113u << 23)) {
+        // Subnormal or zero : let the float adder do the rounding.
+        const uint32_t magic_bits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+        float magic, f;
+        memcpy(&magic, &magic_bits, 4);
+        memcpy(&f, &bits, 4);
+        f += magic;
+        memcpy(&bits, &f, 4);
+        result = static_cast<uint16_t>(bits - magic_bits);
+    }
+    else {
+        uint32_t mantissa_odd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xFFF + mantissa_odd;
+        result = static_cast<uint16_t>(bits >> 13);
+    }
+    return static_cast<uint16_t>(result | (sign >> 16));
+}
+
+float half_to_float(uint16_t value)
+{
+    const uint32_t shifted_exponent = 0x7C00u << 13;
+    uint32_t bits = (value & 0x7FFFu) << 13;
+    uint32_t exponent = bits & shifted_exponent;
+    bits += (127u - 15u) << 23;
+
+    float result;
+    if (exponent == shifted_exponent) {
+        bits += (128u - 16u) << 23;     // Inf / NaN
+        memcpy(&result, &bits, 4);
+    }
+    else if (exponent == 0) {
+        // Subnormal : renormalize through the float unit.
+        bits += 1u << 23;
+        const uint32_t magic_bits = 113u << 23;
+        float magic;
+        memcpy(&magic, &magic_bits, 4);
+        memcpy(&result, &bits, 4);
+        result -= magic;
+    }
+    else {
+        memcpy(&result, &bits, 4);
+    }
+    return (value & 0x8000u) ? -result : result;
+}
+
+static inline uint16_t float_to_snorm16(float value)
+{
+    float clamped = std::min(std::max(value, -1.0f), 1.0f);
+    return static_cast<uint16_t>(static_cast<int16_t>(std::lround(clamped * 32767.0f)));
+}
+
+static inline float snorm16_to_float(uint16_t value)
+{
+    // Vulkan : -32768 and -32767 both map to -1
+    return std::max(static_cast<int16_t>(value) / 32767.0f, -1.0f);
+}
+
+static inline uint8_t float_to_unorm8(float value)
+{
+    return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+VertexDequantization make_dequantization(const glm::vec3& bounds_min, const glm::vec3& bounds_max)
+{
+    VertexDequantization dequantization;
+    for (int axis = 0; axis < 3; axis++) {
+        float half_extent = (bounds_max[axis] - bounds_min[axis]) * 0.5f;
+        dequantization.offset[axis] = (bounds_max[axis] + bounds_min[axis]) * 0.5f;
+        // Flat axis : every position encodes to 0
+        dequantization.scale[axis] = half_extent > 0.0f ? half_extent : 1.0f;
+    }
+    return dequantization;
+}
+
+glm::mat4 dequantization_matrix(const VertexDequantization& dequantization)
+{
+    glm::mat4 matrix(1.0f);
+    for (int axis = 0; axis < 3; axis++) {
+        matrix[axis][axis] = dequantization.scale[axis];
+        matrix[3][axis] = dequantization.offset[axis];
+    }
+    return matrix;
+}
+
+PackedVertex pack_vertex(VertexFormat format, const VertexDequantization& dequantization,
+    const glm::vec3& position, const glm::vec3& color, const glm::vec2& texCoord)
+{
+    PackedVertex packed{};
+    for (int axis = 0; axis < 3; axis++) {
+        float normalized = (position[axis] - dequantization.offset[axis]) / dequantization.scale[axis];
+        packed.position[axis] = format == VertexFormat::PACKED_SNORM16
+            ? float_to_snorm16(normalized) : float_to_half(normalized);
+    }
+    packed.position[3] = format == VertexFormat::PACKED_SNORM16 ? float_to_snorm16(1.0f) : float_to_half(1.0f);
+    packed.color[0] = float_to_unorm8(color.x);
+    packed.color[1] = float_to_unorm8(color.y);
+    packed.color[2] = float_to_unorm8(color.z);
+    packed.color[3] = 255;
+    packed.texCoord[0] = float_to_half(texCoord.x);
+    packed.texCoord[1] = float_to_half(texCoord.y);
+    return packed;
+}
+
+glm::vec3 unpack_position(VertexFormat format, const VertexDequantization& dequantization, const PackedVertex& vertex)
+{
+    glm::vec3 position;
+    for (int axis = 0; axis < 3; axis++) {
+        float normalized = format == VertexFormat::PACKED_SNORM16
+            ? snorm16_to_float(vertex.position[axis]) : half_to_float(vertex.position[axis]);
+        position[axis] = normalized * dequantization.scale[axis] + dequantization.offset[axis];
+    }
+    return position;
+}
+
+glm::vec2 unpack_texcoord(const PackedVertex& vertex)
+{
+    return glm::vec2(half_to_float(vertex.texCoord[0]), half_to_float(vertex.texCoord[1]));
+}
+
+//----------------------
+//  Indices
+//----------------------
+uint32_t index_size_for(uint32_t vertex_count)
+{
+    if (vertex_count <= 0x100u) return 1;
+    if (vertex_count <= 0x10000u) return 2;
+    return 4;
+}
+
+VkIndexType index_type_of(uint32_t index_size)
+{
+    switch (index_size) {
+    case 1: return VK_INDEX_TYPE_UINT8_EXT;
+    case 2: return VK_INDEX_TYPE_UINT16;
+    case 4: return VK_INDEX_TYPE_UINT32;
+    }
+    throw std::runtime_error("failed to find index type, invalid index size!");
+}
+
+template<typename Src, typename Dst>
+static void convert_indices(const Src* src, Dst* dst, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<Dst>(src[i]);
+    }
+}
+
+template<typename Src>
+static void convert_indices(const Src* src, void* dst, uint32_t dst_size, uint32_t count)
+{
+    switch (dst_size) {
+    case 1: convert_indices(src, static_cast<uint8_t*>(dst), count); break;
+    case 2: convert_indices(src, static_cast<uint16_t*>(dst), count); break;
+    default: convert_indices(src, static_cast<uint32_t*>(dst), count); break;
+    }
+}
+
+void convert_indices(const void* src, uint32_t src_size, void* dst, uint32_t dst_size, uint32_t count)
+{
+    switch (src_size) {
+    case 1: convert_indices(static_cast<const uint8_t*>(src), dst, dst_size, count); break;
+    case 2: convert_indices(static_cast<const uint16_t*>(src), dst, dst_size, count); break;
+    default: convert_indices(static_cast<const uint32_t*>(src), dst, dst_size, count); break;
+    }
+}
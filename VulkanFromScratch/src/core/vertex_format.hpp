@@ -0,0 +1,109 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include <glm.hpp>
+#include "vertex_layout.hpp"
+
+// Vertex buffer layouts a pipeline / model can be built with.
+enum class VertexFormat : uint32_t {
+	FULL,			// Model::Vertex : float position, color and uv (32 bytes)
+	PACKED_SNORM16,	// PackedVertex, snorm16 position
+	PACKED_HALF,	// PackedVertex, half float position
+};
+
+// 16 bytes. The position is stored relative to the mesh bounds, see VertexDequantization.
+struct PackedVertex {
+	uint16_t	position[4];	// snorm16 or half, w is padding
+	uint8_t		color[4];		// unorm8, a = 255
+	uint16_t	texCoord[2];	// half
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// Typed views of PackedVertex, their field types give the attribute formats.
+struct PackedVertexSnorm16 {
+	snorm16x4	position;
+	unorm8x4	color;
+	half2		texCoord;
+};
+struct PackedVertexHalf {
+	half4		position;
+	unorm8x4	color;
+	half2		texCoord;
+};
+static_assert(sizeof(PackedVertexSnorm16) == sizeof(PackedVertex) && sizeof(PackedVertexHalf) == sizeof(PackedVertex)
+	&& offsetof(PackedVertexSnorm16, color) == offsetof(PackedVertex, color)
+	&& offsetof(PackedVertexHalf, texCoord) == offsetof(PackedVertex, texCoord),
+	"the typed views must match PackedVertex");
+
+template<>
+struct VertexLayoutOf<PackedVertexSnorm16> {
+	using type = VertexLayout<PackedVertexSnorm16, VK_VERTEX_INPUT_RATE_VERTEX,
+		VERTEX_ATTRIBUTE(PackedVertexSnorm16, position, 0),
+		VERTEX_ATTRIBUTE(PackedVertexSnorm16, color, 1),
+		VERTEX_ATTRIBUTE(PackedVertexSnorm16, texCoord, 2)>;
+};
+template<>
+struct VertexLayoutOf<PackedVertexHalf> {
+	using type = VertexLayout<PackedVertexHalf, VK_VERTEX_INPUT_RATE_VERTEX,
+		VERTEX_ATTRIBUTE(PackedVertexHalf, position, 0),
+		VERTEX_ATTRIBUTE(PackedVertexHalf, color, 1),
+		VERTEX_ATTRIBUTE(PackedVertexHalf, texCoord, 2)>;
+};
+
+// Per instance stream (binding 1), written to CoreInstance::instance_ring() every frame.
+// Rows of the affine model matrix, the shader rebuilds the mat4.
+struct InstanceData {
+	glm::vec4	model_row0;
+	glm::vec4	model_row1;
+	glm::vec4	model_row2;
+
+	static InstanceData from_matrix(const glm::mat4& model);
+};
+template<>
+struct VertexLayoutOf<InstanceData> {
+	using type = VertexLayout<InstanceData, VK_VERTEX_INPUT_RATE_INSTANCE,
+		VERTEX_ATTRIBUTE(InstanceData, model_row0, 3),
+		VERTEX_ATTRIBUTE(InstanceData, model_row1, 4),
+		VERTEX_ATTRIBUTE(InstanceData, model_row2, 5)>;
+};
+
+// Pushed to the vertex shader with every model : position = decoded * scale + offset.
+// Identity for VertexFormat::FULL.
+struct VertexDequantization {
+	glm::vec4	scale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+	glm::vec4	offset = glm::vec4(0.0f);
+};
+
+const char*		vertex_format_name(VertexFormat format);
+uint32_t		vertex_stride(VertexFormat format);
+// Compile time generated descriptions of the format's vertex type (binding 0) and InstanceData (binding 1).
+VertexInputDescription	vertex_input_description(VertexFormat format);
+// Push constant range of the graphic pipelines (VertexDequantization).
+VkPushConstantRange	vertex_push_constant_range();
+
+//----------------------------
+// Encoding
+//----------------------------
+uint16_t	float_to_half(float value);
+float		half_to_float(uint16_t value);
+
+// Maps the bounds onto [-1, 1] on every axis.
+VertexDequantization	make_dequantization(const glm::vec3& bounds_min, const glm::vec3& bounds_max);
+// The same transform as a matrix, to fold it into an instance transform.
+glm::mat4		dequantization_matrix(const VertexDequantization& dequantization);
+PackedVertex	pack_vertex(VertexFormat format, const VertexDequantization& dequantization,
+					const glm::vec3& position, const glm::vec3& color, const glm::vec2& texCoord);
+// What the vertex shader sees, used to measure the quantization error.
+glm::vec3		unpack_position(VertexFormat format, const VertexDequantization& dequantization, const PackedVertex& vertex);
+glm::vec2		unpack_texcoord(const PackedVertex& vertex);
+
+//----------------------------
+// Indices
+//----------------------------
+// Narrowest index width (1, 2 or 4 bytes) that addresses `vertex_count` vertices. Primitive
+// restart is off in every pipeline, so the all ones value is a regular index.
+uint32_t		index_size_for(uint32_t vertex_count);
+VkIndexType		index_type_of(uint32_t index_size);
+// Copies `count` indices from one width to another, the values have to fit.
+void			convert_indices(const void* src, uint32_t src_size, void* dst, uint32_t dst_size, uint32_t count);
@@ -0,0 +1,185 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <glm.hpp>
+
+//----------------------------
+// Packed field types
+//----------------------------
+// The C++ type of a vertex field decides its VkFormat, raw integers would be ambiguous.
+struct snorm16x4	{ uint16_t v[4]; };
+struct half4		{ uint16_t v[4]; };
+struct half2		{ uint16_t v[2]; };
+struct unorm8x4		{ uint8_t v[4]; };
+
+//----------------------------
+// Field traits
+//----------------------------
+// format : VkFormat of the attribute
+// shader_type : scalar type the vertex shader reads (float for float / norm formats)
+template<typename T> struct always_false : std::false_type {};
+
+template<typename T>
+struct VertexFieldTraits {
+	static_assert(always_false<T>::value, "no VkFormat is known for this vertex field type");
+};
+#define VERTEX_FIELD_TRAITS(Type, Format, ShaderType) \
+	template<> struct VertexFieldTraits<Type> { \
+		static constexpr VkFormat format = Format; \
+		using shader_type = ShaderType; \
+	}
+VERTEX_FIELD_TRAITS(float,		VK_FORMAT_R32_SFLOAT,			float);
+VERTEX_FIELD_TRAITS(glm::vec2,	VK_FORMAT_R32G32_SFLOAT,		float);
+VERTEX_FIELD_TRAITS(glm::vec3,	VK_FORMAT_R32G32B32_SFLOAT,		float);
+VERTEX_FIELD_TRAITS(glm::vec4,	VK_FORMAT_R32G32B32A32_SFLOAT,	float);
+VERTEX_FIELD_TRAITS(uint32_t,	VK_FORMAT_R32_UINT,				uint32_t);
+VERTEX_FIELD_TRAITS(snorm16x4,	VK_FORMAT_R16G16B16A16_SNORM,	float);
+VERTEX_FIELD_TRAITS(half4,		VK_FORMAT_R16G16B16A16_SFLOAT,	float);
+VERTEX_FIELD_TRAITS(half2,		VK_FORMAT_R16G16_SFLOAT,		float);
+VERTEX_FIELD_TRAITS(unorm8x4,	VK_FORMAT_R8G8B8A8_UNORM,		float);
+#undef VERTEX_FIELD_TRAITS
+
+//----------------------------
+// Layout
+//----------------------------
+template<uint32_t Location, typename Field, uint32_t Offset>
+struct VertexAttribute {
+	static constexpr uint32_t location = Location;
+	static constexpr uint32_t offset = Offset;
+	static constexpr VkFormat format = VertexFieldTraits<Field>::format;
+	using shader_type = typename VertexFieldTraits<Field>::shader_type;
+};
+// Location, type and offset all come from the member, it is only named once.
+#define VERTEX_ATTRIBUTE(Vertex, member, location) \
+	VertexAttribute<location, decltype(Vertex::member), static_cast<uint32_t>(offsetof(Vertex, member))>
+
+// Binding / attribute descriptions of a vertex struct, built at compile time.
+// A vertex type gets one through a VertexLayoutOf specialization, see Model::Vertex.
+template<typename Vertex, VkVertexInputRate InputRate, typename... Attributes>
+struct VertexLayout {
+	using vertex_type = Vertex;
+	static constexpr uint32_t stride = sizeof(Vertex);
+	static constexpr uint32_t attribute_count = sizeof...(Attributes);
+
+	static constexpr VkVertexInputBindingDescription binding_description(uint32_t binding = 0)
+	{
+		return VkVertexInputBindingDescription{ binding, stride, InputRate };
+	}
+	static constexpr std::array<VkVertexInputAttributeDescription, attribute_count> attribute_descriptions(uint32_t binding = 0)
+	{
+		return { { VkVertexInputAttributeDescription{ Attributes::location, binding, Attributes::format, Attributes::offset }... } };
+	}
+
+	// True when an attribute at `Location` feeds a shader input of scalar type `ShaderType`.
+	template<uint32_t Location, typename ShaderType>
+	static constexpr bool provides()
+	{
+		return ((Attributes::location == Location && std::is_same<typename Attributes::shader_type, ShaderType>::value) || ...);
+	}
+};
+
+template<typename Vertex>
+struct VertexLayoutOf {
+	static_assert(always_false<Vertex>::value, "the vertex type has no VertexLayoutOf specialization");
+};
+
+//----------------------------
+// Shader interface
+//----------------------------
+// Vertex inputs of a shader, written next to the pipeline that loads it. Vulkan converts
+// between component counts, but the scalar type has to match and every input needs a source.
+template<uint32_t Location, typename ShaderType>
+struct ShaderInput {
+	static constexpr uint32_t location = Location;
+	using shader_type = ShaderType;
+};
+
+template<typename... Inputs>
+struct ShaderInputs {
+	// Every input is fed by one of the bound layouts.
+	template<typename... Layouts>
+	static constexpr bool fed_by()
+	{
+		return (is_fed<Inputs, Layouts...>() && ...);
+	}
+
+private:
+	template<typename Input, typename... Layouts>
+	static constexpr bool is_fed()
+	{
+		return (Layouts::template provides<Input::location, typename Input::shader_type>() || ...);
+	}
+};
+
+// Locations have to be unique over all the bindings of a pipeline.
+template<typename... Layouts>
+constexpr bool has_unique_locations()
+{
+	constexpr uint32_t count = (Layouts::attribute_count + ...);
+	std::array<VkVertexInputAttributeDescription, count> attributes{};
+	uint32_t next = 0;
+	auto append = [&](const auto& layout_attributes) {
+		for (const auto& attribute : layout_attributes) attributes[next++] = attribute;
+	};
+	(append(Layouts::attribute_descriptions()), ...);
+	for (uint32_t i = 0; i < count; i++) {
+		for (uint32_t j = i + 1; j < count; j++) {
+			if (attributes[i].location == attributes[j].location) return false;
+		}
+	}
+	return true;
+}
+
+// Compile time check that the vertex types, bound in order from binding 0, can feed
+// `Inputs`. Fails the build otherwise.
+template<typename Inputs, typename... Vertices>
+constexpr bool check_vertex_inputs()
+{
+	static_assert(has_unique_locations<typename VertexLayoutOf<Vertices>::type...>(), "two vertex attributes share a location");
+	static_assert(Inputs::template fed_by<typename VertexLayoutOf<Vertices>::type...>(), "the vertex layout does not match the shader inputs");
+	return true;
+}
+
+// What a pipeline needs, pointing to the layouts' static arrays.
+struct VertexInputDescription {
+	static constexpr uint32_t MAX_BINDINGS = 2;
+
+	VkVertexInputBindingDescription				bindings[MAX_BINDINGS];
+	uint32_t									binding_count;
+	const VkVertexInputAttributeDescription*	attributes;
+	uint32_t									attribute_count;
+
+	// One binding per vertex type, in order.
+	template<typename... Vertices>
+	static VertexInputDescription of()
+	{
+		static_assert(sizeof...(Vertices) <= MAX_BINDINGS, "too many vertex bindings");
+		static constexpr auto attribute_array = attribute_descriptions<typename VertexLayoutOf<Vertices>::type...>();
+
+		VertexInputDescription description{};
+		uint32_t binding = 0;
+		((description.bindings[binding] = VertexLayoutOf<Vertices>::type::binding_description(binding), binding++), ...);
+		description.binding_count = binding;
+		description.attributes = attribute_array.data();
+		description.attribute_count = static_cast<uint32_t>(attribute_array.size());
+		return description;
+	}
+
+private:
+	template<typename... Layouts>
+	static constexpr auto attribute_descriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, (Layouts::attribute_count + ...)> attributes{};
+		uint32_t next = 0;
+		uint32_t binding = 0;
+		auto append = [&](const auto& layout_attributes) {
+			for (const auto& attribute : layout_attributes) attributes[next++] = attribute;
+			binding++;
+		};
+		(append(Layouts::attribute_descriptions(binding)), ...);
+		return attributes;
+	}
+};
@@ -0,0 +1,201 @@
+#include "hlod_builder.hpp"
+#include "mesh_optimizer.hpp"
+#include "core/indirect_draw.hpp"
+#include <map>
+#include <tuple>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+
+// FNV-1a, 64 bits
+static const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+//----------------------
+//  Clustering
+//----------------------
+std::vector<HlodCluster> HlodBuilder::cluster(const std::vector<HlodSource>& sources, float cell_size,
+    const std::string& name, VertexFormat format)
+{
+    if (cell_size <= 0.0f) {
+        throw std::runtime_error("failed to cluster hlod sources, the cell size has to be positive!");
+    }
+
+    // World bounding sphere and signature of every source. The cells are ordered, the same
+    // scene always gives the same clusters.
+    std::vector<glm::vec4> spheres(sources.size());
+    std::vector<uint64_t> signatures(sources.size());
+    std::map<std::tuple<int, int, int>, std::vector<uint32_t>> cells;
+    for (uint32_t i = 0; i < sources.size(); i++) {
+        const HlodSource& source = sources[i];
+        MappedMesh mapped;
+        MeshCache::load(source.path, mapped, format);
+        const MeshCacheHeader& header = mapped.header();
+        glm::vec3 lo(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+        glm::vec3 hi(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+        glm::vec3 center = glm::vec3(source.transform * glm::vec4((lo + hi) * 0.5f, 1.0f));
+        spheres[i] = glm::vec4(center, glm::length(hi - lo) * 0.5f * max_scale(source.transform));
+
+        uint64_t hash = hash_bytes(HASH_SEED, source.path.data(), source.path.size());
+        hash = hash_bytes(hash, &source.transform, sizeof(source.transform));
+        hash = hash_bytes(hash, &header.source_size, sizeof(header.source_size));
+        signatures[i] = hash_bytes(hash, &header.source_time, sizeof(header.source_time));
+
+        glm::vec3 cell = center / cell_size;
+        cells[std::make_tuple(static_cast<int>(std::floor(cell.x)), static_cast<int>(std::floor(cell.y)), static_cast<int>(std::floor(cell.z)))].push_back(i);
+    }
+
+    std::vector<HlodCluster> clusters;
+    for (const auto& cell : cells) {
+        if (cell.second.size() < MIN_MEMBERS) continue;
+        HlodCluster cluster;
+        cluster.members = cell.second;
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        uint64_t hash = HASH_SEED;
+        for (uint32_t member : cluster.members) {
+            lo = glm::min(lo, glm::vec3(spheres[member]) - glm::vec3(spheres[member].w));
+            hi = glm::max(hi, glm::vec3(spheres[member]) + glm::vec3(spheres[member].w));
+            hash = hash_bytes(hash, &signatures[member], sizeof(uint64_t));
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t member : cluster.members) {
+            radius = std::max(radius, glm::length(glm::vec3(spheres[member]) - center) + spheres[member].w);
+        }
+        cluster.sphere = glm::vec4(center, radius);
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".hlod_%016llx", static_cast<unsigned long long>(hash));
+        cluster.proxy_path = name + suffix;
+        clusters.push_back(std::move(cluster));
+    }
+
+    size_t clustered = 0;
+    for (const HlodCluster& cluster : clusters) clustered += cluster.members.size();
+    printf("[HLOD] %zu source(s), %zu in %zu cluster(s) of %.1f units \n", sources.size(), clustered, clusters.size(), cell_size);
+    return clusters;
+}
+
+//----------------------
+//  Proxy
+//----------------------
+// Appends the source in world space, at its coarsest level still under `max_error`.
+static void append_member(const MappedMesh& mapped, const glm::mat4& transform, float max_error, MeshData& merged)
+{
+    const uint32_t base = static_cast<uint32_t>(merged.vertices.size());
+    const VertexFormat format = mapped.vertex_format();
+    const VertexDequantization dequantization = mapped.dequantization();
+    for (uint32_t i = 0; i < mapped.vertex_count(); i++) {
+        Model::Vertex vertex;
+        if (format == VertexFormat::FULL) {
+            vertex = static_cast<const Model::Vertex*>(mapped.vertex_data())[i];
+        }
+        else {
+            const PackedVertex& packed = static_cast<const PackedVertex*>(mapped.vertex_data())[i];
+            vertex.pos = unpack_position(format, dequantization, packed);
+            vertex.color = glm::vec3(packed.color[0], packed.color[1], packed.color[2]) / 255.0f;
+            vertex.texCoord = unpack_texcoord(packed);
+        }
+        vertex.pos = glm::vec3(transform * glm::vec4(vertex.pos, 1.0f));
+        merged.vertices.push_back(vertex);
+    }
+
+    const float scale = max_scale(transform);
+    uint32_t level = 0;
+    while (level + 1 < mapped.lod_count() && mapped.lods()[level + 1].error * scale <= max_error) level++;
+    const MeshLod& lod = mapped.lods()[level];
+    std::vector<uint32_t> indices(lod.index_count);
+    convert_indices(static_cast<const uint8_t*>(mapped.index_data()) + static_cast<size_t>(lod.first_index) * mapped.index_size(),
+        mapped.index_size(), indices.data(), sizeof(uint32_t), lod.index_count);
+
+    // A mirroring transform turns the triangles around, the winding is swapped back.
+    const bool mirrored = glm::dot(glm::cross(glm::vec3(transform[0]), glm::vec3(transform[1])), glm::vec3(transform[2])) < 0.0f;
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        merged.indices.push_back(base + indices[t]);
+        merged.indices.push_back(base + indices[t + (mirrored ? 2 : 1)]);
+        merged.indices.push_back(base + indices[t + (mirrored ? 1 : 2)]);
+    }
+}
+
+// Drops the vertices no triangle uses, then sets the bounds and the single submesh.
+static void compact_vertices(MeshData& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Model::Vertex> vertices;
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+
+    mesh.bounds_min = glm::vec3(FLT_MAX);
+    mesh.bounds_max = glm::vec3(-FLT_MAX);
+    for (const Model::Vertex& vertex : mesh.vertices) {
+        mesh.bounds_min = glm::min(mesh.bounds_min, vertex.pos);
+        mesh.bounds_max = glm::max(mesh.bounds_max, vertex.pos);
+    }
+    SubMesh submesh;
+    submesh.index_count = static_cast<uint32_t>(mesh.indices.size());
+    submesh.bounds_min = mesh.bounds_min;
+    submesh.bounds_max = mesh.bounds_max;
+    mesh.submeshes.assign(1, submesh);
+}
+
+bool HlodBuilder::build(const std::vector<HlodSource>& sources, const HlodCluster& cluster, VertexFormat format)
+{
+    const std::string path = MeshCache::cache_path(cluster.proxy_path, format);
+    {
+        MappedMesh existing;
+        if (existing.open(path, format)) return false;
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // The members' LODs already under the error are taken as they are, the merged mesh only
+    // simplifies what they could not (the gaps between objects, tiny parts).
+    const float max_error = cluster.sphere.w * 2.0f * MAX_RELATIVE_ERROR;
+    MeshData merged;
+    uint64_t full_triangles = 0;
+    for (uint32_t member : cluster.members) {
+        MappedMesh mapped;
+        MeshCache::load(sources[member].path, mapped, format);
+        full_triangles += mapped.lods()[0].index_count / 3;
+        append_member(mapped, sources[member].transform, max_error, merged);
+    }
+    const size_t merged_triangles = merged.indices.size() / 3;
+
+    std::vector<uint32_t> simplified;
+    size_t target = static_cast<size_t>(full_triangles * PROXY_RATIO) * 3;
+    float error = MeshSimplifier::simplify(merged, merged.indices.data(), merged.indices.size(), target, max_error, simplified);
+    merged.indices.swap(simplified);
+    if (merged.indices.empty()) {
+        throw std::runtime_error("failed to build hlod proxy, nothing left to draw!");
+    }
+    compact_vertices(merged);
+
+    // From here on the proxy is a mesh like any other.
+    MeshOptimizer::optimize(merged);
+    std::vector<Meshlet> meshlets;
+    MeshletBuilder::build(merged, meshlets);
+    std::vector<MeshLod> lods;
+    MeshSimplifier::build_lods(merged, lods);
+    MeshCache::write(path, merged, meshlets, lods, cluster.proxy_path, format);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("[HLOD] %s : %zu member(s), %llu -> %zu -> %u triangles (error %.2e) in %.2f ms \n",
+        path.c_str(), cluster.members.size(), static_cast<unsigned long long>(full_triangles), merged_triangles,
+        lods[0].index_count / 3, error, ms);
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "helper/mesh_cache.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <glm.hpp>
+
+// One static object of the scene : a mesh source and its world transform.
+struct HlodSource {
+	std::string	path;
+	glm::mat4	transform{ 1.0f };
+};
+
+// Sources merged into one proxy, see HlodBuilder.
+struct HlodCluster {
+	std::vector<uint32_t>	members;			// into the sources
+	glm::vec4				sphere{ 0.0f };		// world bounding sphere of the members
+	std::string				proxy_path;			// source path of the proxy, for Model / MeshCache
+};
+
+// Offline hierarchical LOD. Static objects are grouped by the cell of a regular grid their
+// bounds' center falls in, and each group is merged into one proxy mesh in world space,
+// simplified well past the members' own LODs (see IndirectDrawList::add_hlod).
+// A proxy is written to the mesh cache like an imported mesh but has no source file, so
+// Model maps it as a shipped cache. Its name hashes the members' paths, transforms and
+// source signatures : an edited scene gets new proxies instead of stale ones.
+// Every model samples the texture bound by the renderer, the proxies keep the members' UVs.
+class HlodBuilder {
+public:
+	static const uint32_t MIN_MEMBERS = 2;
+	// Triangles of a proxy / triangles of its members at LOD 0.
+	static constexpr float PROXY_RATIO = 0.1f;
+	// Simplification stops at this error, relative to the diagonal of the cluster.
+	static constexpr float MAX_RELATIVE_ERROR = 0.02f;
+
+	// Maps (importing when needed) the cache of every source for its bounds. Cells with less
+	// than MIN_MEMBERS sources get no cluster. `name` prefixes the proxy paths.
+	static std::vector<HlodCluster> cluster(const std::vector<HlodSource>& sources, float cell_size,
+		const std::string& name, VertexFormat format = VertexFormat::FULL);
+	// Writes the proxy cache of `cluster` unless it is already there. Returns true when built.
+	static bool build(const std::vector<HlodSource>& sources, const HlodCluster& cluster,
+		VertexFormat format = VertexFormat::FULL);
+};
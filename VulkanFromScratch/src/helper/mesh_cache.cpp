@@ -0,0 +1,292 @@
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// The submesh section is the SubMesh array itself.
+static_assert(sizeof(SubMesh) == 32, "SubMesh is stored as is in the mesh cache");
+
+static inline uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+//----------------------
+//  MappedMesh
+//----------------------
+MappedMesh::~MappedMesh()
+{
+    close();
+}
+
+bool MappedMesh::open(const std::string& path, VertexFormat format)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    // The whole file is copied out once, front to back.
+    madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+    m_fd = fd;
+    m_size = static_cast<size_t>(info.st_size);
+#endif
+    m_data = static_cast<const uint8_t*>(data);
+
+    //----------------
+    //  Validate
+    //----------------
+    const MeshCacheHeader& h = header();
+    bool valid = m_size >= sizeof(MeshCacheHeader)
+        && h.magic == MESH_CACHE_MAGIC
+        && h.version == MESH_CACHE_VERSION
+        && h.vertex_format == static_cast<uint32_t>(format)
+        && h.vertex_stride == vertex_stride(format)
+        && h.index_size == index_size_for(h.vertex_count)
+        && h.file_size == m_size
+        && h.vertex_offset + static_cast<uint64_t>(h.vertex_count) * h.vertex_stride <= m_size
+        && h.index_offset + static_cast<uint64_t>(h.index_count) * h.index_size <= m_size
+        && h.submesh_offset + static_cast<uint64_t>(h.submesh_count) * sizeof(SubMesh) <= m_size
+        && h.meshlet_offset + static_cast<uint64_t>(h.meshlet_count) * sizeof(Meshlet) <= m_size
+        && h.lod_count > 0
+        && h.lod_offset + static_cast<uint64_t>(h.lod_count) * sizeof(MeshLod) <= m_size;
+    if (!valid) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+VertexDequantization MappedMesh::dequantization() const
+{
+    VertexDequantization dequantization;
+    for (int axis = 0; axis < 3; axis++) {
+        dequantization.scale[axis] = header().dequantization_scale[axis];
+        dequantization.offset[axis] = header().dequantization_offset[axis];
+    }
+    return dequantization;
+}
+
+void MappedMesh::close()
+{
+    if (m_data == nullptr) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_file = nullptr;
+    m_mapping = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+    ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+//----------------------
+//  MeshCache
+//----------------------
+std::string MeshCache::cache_path(const std::string& source_path, VertexFormat format)
+{
+    if (format == VertexFormat::FULL) return source_path + ".meshcache";
+    return source_path + "." + vertex_format_name(format) + ".meshcache";
+}
+
+// Encodes the vertices and prints how far the decoded attributes are from the source.
+static void pack_mesh(const MeshData& mesh, VertexFormat format, const VertexDequantization& dequantization,
+    std::vector<PackedVertex>& packed)
+{
+    packed.resize(mesh.vertices.size());
+    double position_max = 0.0, position_sum = 0.0, texcoord_max = 0.0, color_max = 0.0;
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Model::Vertex& vertex = mesh.vertices[i];
+        packed[i] = pack_vertex(format, dequantization, vertex.pos, vertex.color, vertex.texCoord);
+
+        double error = glm::length(unpack_position(format, dequantization, packed[i]) - vertex.pos);
+        position_max = std::max(position_max, error);
+        position_sum += error * error;
+        glm::vec2 texcoord_error = unpack_texcoord(packed[i]) - vertex.texCoord;
+        texcoord_max = std::max<double>(texcoord_max, std::max(std::fabs(texcoord_error.x), std::fabs(texcoord_error.y)));
+        for (int c = 0; c < 3; c++) {
+            color_max = std::max<double>(color_max, std::fabs(packed[i].color[c] / 255.0f - vertex.color[c]));
+        }
+    }
+
+    double diagonal = glm::length(mesh.bounds_max - mesh.bounds_min);
+    double position_rms = mesh.vertices.empty() ? 0.0 : std::sqrt(position_sum / mesh.vertices.size());
+    printf("[Mesh] %s vertices : %u -> %u bytes, position error max %.3e (%.5f%% of the diagonal) rms %.3e, uv max %.3e, color max %.4f \n",
+        vertex_format_name(format), static_cast<uint32_t>(sizeof(Model::Vertex)), static_cast<uint32_t>(sizeof(PackedVertex)),
+        position_max, diagonal > 0.0 ? position_max / diagonal * 100.0 : 0.0, position_rms, texcoord_max, color_max);
+}
+
+static bool source_signature(const std::string& source_path, uint64_t& size, int64_t& time)
+{
+    std::error_code error;
+    size = static_cast<uint64_t>(std::filesystem::file_size(source_path, error));
+    if (error) return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(source_path, error).time_since_epoch().count());
+    return !error;
+}
+
+void MeshCache::write(const std::string& path, const MeshData& mesh, const std::vector<Meshlet>& meshlets,
+    const std::vector<MeshLod>& lods, const std::string& source_path, VertexFormat format)
+{
+    const void* vertex_data = mesh.vertices.data();
+    std::vector<PackedVertex> packed;
+    VertexDequantization dequantization;
+    if (format != VertexFormat::FULL) {
+        dequantization = make_dequantization(mesh.bounds_min, mesh.bounds_max);
+        pack_mesh(mesh, format, dequantization, packed);
+        vertex_data = packed.data();
+    }
+
+    const uint32_t index_size = index_size_for(static_cast<uint32_t>(mesh.vertices.size()));
+    const void* index_data = mesh.indices.data();
+    std::vector<uint8_t> narrowed;
+    if (index_size != sizeof(uint32_t)) {
+        narrowed.resize(mesh.indices.size() * index_size);
+        convert_indices(mesh.indices.data(), sizeof(uint32_t), narrowed.data(), index_size, static_cast<uint32_t>(mesh.indices.size()));
+        index_data = narrowed.data();
+    }
+
+    MeshCacheHeader header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertex_stride = vertex_stride(format);
+    header.vertex_format = static_cast<uint32_t>(format);
+    header.index_size = index_size;
+    header.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    header.index_count = static_cast<uint32_t>(mesh.indices.size());
+    header.submesh_count = static_cast<uint32_t>(mesh.submeshes.size());
+    header.meshlet_count = static_cast<uint32_t>(meshlets.size());
+    header.lod_count = static_cast<uint32_t>(lods.size());
+    header.vertex_offset = align_up(sizeof(MeshCacheHeader), MESH_CACHE_SECTION_ALIGNMENT);
+    header.index_offset = align_up(header.vertex_offset + mesh.vertices.size() * header.vertex_stride, MESH_CACHE_SECTION_ALIGNMENT);
+    header.submesh_offset = align_up(header.index_offset + mesh.indices.size() * index_size, MESH_CACHE_SECTION_ALIGNMENT);
+    header.meshlet_offset = align_up(header.submesh_offset + mesh.submeshes.size() * sizeof(SubMesh), MESH_CACHE_SECTION_ALIGNMENT);
+    header.lod_offset = align_up(header.meshlet_offset + meshlets.size() * sizeof(Meshlet), MESH_CACHE_SECTION_ALIGNMENT);
+    header.file_size = header.lod_offset + lods.size() * sizeof(MeshLod);
+    source_signature(source_path, header.source_size, header.source_time);
+    memcpy(header.bounds_min, &mesh.bounds_min, sizeof(header.bounds_min));
+    memcpy(header.bounds_max, &mesh.bounds_max, sizeof(header.bounds_max));
+    for (int axis = 0; axis < 3; axis++) {
+        header.dequantization_scale[axis] = dequantization.scale[axis];
+        header.dequantization_offset[axis] = dequantization.offset[axis];
+    }
+
+    // Written next to the final file and renamed, a crash never leaves a half written cache.
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to write mesh cache!");
+        }
+        auto write_section = [&](uint64_t offset, const void* data, size_t size) {
+            static const char padding[MESH_CACHE_SECTION_ALIGNMENT] = {};
+            file.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(file.tellp())));
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_section(header.vertex_offset, vertex_data, mesh.vertices.size() * header.vertex_stride);
+        write_section(header.index_offset, index_data, mesh.indices.size() * index_size);
+        write_section(header.submesh_offset, mesh.submeshes.data(), mesh.submeshes.size() * sizeof(SubMesh));
+        write_section(header.meshlet_offset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+        write_section(header.lod_offset, lods.data(), lods.size() * sizeof(MeshLod));
+        if (!file.good()) {
+            throw std::runtime_error("failed to write mesh cache!");
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        throw std::runtime_error("failed to write mesh cache!");
+    }
+}
+
+bool MeshCache::load(const std::string& source_path, MappedMesh& mapped, VertexFormat format)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string path = cache_path(source_path, format);
+
+    // A cache without its source (shipped on its own) is always taken.
+    uint64_t source_size = 0;
+    int64_t source_time = 0;
+    bool has_source = source_signature(source_path, source_size, source_time);
+    if (mapped.open(path, format)) {
+        if (!has_source || (mapped.header().source_size == source_size && mapped.header().source_time == source_time)) {
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            printf("[Mesh] %s : cache mapped, %.2f MB in %.2f ms \n", path.c_str(), mapped.size() / (1024.0 * 1024.0), ms);
+            return false;
+        }
+        mapped.close();
+    }
+
+    //----------------
+    //  Rebuild
+    //----------------
+    {
+        // Optimized, clustered and simplified once here, the cache keeps the reordered buffers,
+        // the meshlets and the LODs. Both follow the optimized order of LOD 0, the LODs'
+        // indices are appended after it.
+        MeshData mesh = MeshImporter::load(source_path);
+        MeshOptimizer::optimize(mesh);
+        std::vector<Meshlet> meshlets;
+        MeshletBuilder::build(mesh, meshlets);
+        std::vector<MeshLod> lods;
+        MeshSimplifier::build_lods(mesh, lods);
+        write(path, mesh, meshlets, lods, source_path, format);
+    }
+    if (!mapped.open(path, format)) {
+        throw std::runtime_error("failed to map mesh cache!");
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "helper/mesh_importer.hpp"
+#include "helper/meshlet_builder.hpp"
+#include "helper/mesh_simplifier.hpp"
+#include <string>
+#include <cstdint>
+
+//----------------------------
+// File layout
+//----------------------------
+// [ header | vertices | indices | submeshes | meshlets | lods ], every section starts on a SECTION_ALIGNMENT
+// boundary of the file. The mapping itself is page aligned, so the sections can be handed
+// to the staging ring (or a host visible buffer) as they are.
+static const uint32_t MESH_CACHE_MAGIC = 0x4D534656;	// "VFSM"
+// Bump when the header, the vertex layout or the section layout changes.
+// 2 : index / vertex order optimized by MeshOptimizer.
+// 3 : vertex format + dequantization transform.
+// 4 : indices stored with index_size_for(vertex_count) bytes.
+// 5 : meshlets built by MeshletBuilder.
+// 6 : LOD chain built by MeshSimplifier, the levels follow LOD 0 in the index section.
+static const uint32_t MESH_CACHE_VERSION = 6;
+static const uint64_t MESH_CACHE_SECTION_ALIGNMENT = 256;
+
+struct MeshCacheHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	vertex_stride;		// vertex_stride(vertex_format) of the writer
+	uint32_t	index_size;			// 1, 2 or 4, index_size_for(vertex_count)
+	uint32_t	vertex_count;
+	uint32_t	index_count;		// every LOD
+	uint32_t	submesh_count;
+	uint32_t	vertex_format;		// VertexFormat
+	uint32_t	meshlet_count;		// of LOD 0
+	uint32_t	lod_count;
+	uint64_t	vertex_offset;
+	uint64_t	index_offset;
+	uint64_t	submesh_offset;
+	uint64_t	meshlet_offset;
+	uint64_t	lod_offset;
+	uint64_t	file_size;
+	// Size and write time of the imported file, a cache that does not match is rebuilt.
+	uint64_t	source_size;
+	int64_t		source_time;
+	float		bounds_min[3];
+	float		bounds_max[3];
+	// Packed formats : position = decoded * scale + offset
+	float		dequantization_scale[3];
+	float		dequantization_offset[3];
+};
+
+// Read only view of a mesh cache file. The pointers stay valid until close().
+class MappedMesh {
+public:
+	MappedMesh() = default;
+	~MappedMesh();
+	MappedMesh(const MappedMesh&) = delete;
+	MappedMesh& operator=(const MappedMesh&) = delete;
+
+	// False when the file is missing, truncated or written for another version / vertex format.
+	bool open(const std::string& path, VertexFormat format);
+	void close();
+
+	inline bool						is_open() const { return m_data != nullptr; }
+	inline const MeshCacheHeader&	header() const { return *reinterpret_cast<const MeshCacheHeader*>(m_data); }
+	// Model::Vertex or PackedVertex, see vertex_format()
+	inline const void*				vertex_data() const { return m_data + header().vertex_offset; }
+	inline uint32_t					vertex_count() const { return header().vertex_count; }
+	inline VkDeviceSize				vertex_data_size() const { return static_cast<VkDeviceSize>(header().vertex_count) * header().vertex_stride; }
+	inline VertexFormat				vertex_format() const { return static_cast<VertexFormat>(header().vertex_format); }
+	VertexDequantization			dequantization() const;
+	// uint8_t, uint16_t or uint32_t, see index_size()
+	inline const void*				index_data() const { return m_data + header().index_offset; }
+	inline uint32_t					index_count() const { return header().index_count; }
+	inline uint32_t					index_size() const { return header().index_size; }
+	inline VkDeviceSize				index_data_size() const { return static_cast<VkDeviceSize>(header().index_count) * header().index_size; }
+	inline const SubMesh*			submeshes() const { return reinterpret_cast<const SubMesh*>(m_data + header().submesh_offset); }
+	inline uint32_t					submesh_count() const { return header().submesh_count; }
+	inline const Meshlet*			meshlets() const { return reinterpret_cast<const Meshlet*>(m_data + header().meshlet_offset); }
+	inline uint32_t					meshlet_count() const { return header().meshlet_count; }
+	inline const MeshLod*			lods() const { return reinterpret_cast<const MeshLod*>(m_data + header().lod_offset); }
+	inline uint32_t					lod_count() const { return header().lod_count; }
+	inline size_t					size() const { return m_size; }
+
+private:
+	const uint8_t*	m_data = nullptr;
+	size_t			m_size = 0;
+#ifdef _WIN32
+	void*			m_file = nullptr;
+	void*			m_mapping = nullptr;
+#else
+	int				m_fd = -1;
+#endif
+};
+
+// Binary mesh cache next to the source asset ("<source>[.<format>].meshcache"), one file
+// per vertex format. Text formats are only parsed when the cache is missing or out of date.
+class MeshCache {
+public:
+	static std::string cache_path(const std::string& source_path, VertexFormat format);
+
+	// Packed formats are encoded here, the quantization error is printed.
+	// The indices are narrowed to the smallest width the vertex count allows.
+	static void write(const std::string& path, const MeshData& mesh, const std::vector<Meshlet>& meshlets,
+		const std::vector<MeshLod>& lods, const std::string& source_path, VertexFormat format);
+	// Maps the cache of `source_path`, importing the source and writing the cache first
+	// when needed. Returns true when the source had to be imported.
+	static bool load(const std::string& source_path, MappedMesh& mapped, VertexFormat format = VertexFormat::FULL);
+};
@@ -0,0 +1,930 @@
+#include "mesh_importer.hpp"
+#include <fstream>
+#include <stdexcept>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cfloat>
+#include <string_view>
+#include <algorithm>
+
+//----------------------
+//  Welding
+//----------------------
+static inline uint64_t mix_hash(uint64_t h)
+{
+    // splitmix64 finalizer
+    h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27; h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+static inline uint64_t hash_vertex(const Model::Vertex& vertex)
+{
+    uint32_t words[sizeof(Model::Vertex) / 4];
+    memcpy(words, &vertex, sizeof(words));
+    uint64_t h = 0;
+    for (uint32_t word : words) h = mix_hash(h ^ word);
+    return h;
+}
+
+// Open addressing (linear probing) table of vertex indices. The keys are not stored
+// here, `equals(index)` compares the candidate against the vertex already at `index`.
+class WeldTable {
+public:
+    // Returns the index of the equal vertex, or `next_index` when the vertex is new
+    // (the caller then appends it, indices have to be handed out in order).
+    template<typename Equals>
+    uint32_t insert(uint64_t hash, uint32_t next_index, Equals&& equals)
+    {
+        if ((m_hashes.size() + 1) * 2 > m_slots.size()) grow();
+
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            uint32_t index = m_slots[i];
+            if (index == EMPTY) {
+                m_slots[i] = next_index;
+                m_hashes.push_back(hash);
+                return next_index;
+            }
+            if (m_hashes[index] == hash && equals(index)) return index;
+        }
+    }
+
+private:
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+    std::vector<uint32_t> m_slots;
+    std::vector<uint64_t> m_hashes;     // by vertex index
+
+    void grow()
+    {
+        m_slots.assign(std::max<size_t>(1024, m_slots.size() * 2), EMPTY);
+        size_t mask = m_slots.size() - 1;
+        for (uint32_t index = 0; index < m_hashes.size(); index++) {
+            size_t i = m_hashes[index] & mask;
+            while (m_slots[i] != EMPTY) i = (i + 1) & mask;
+            m_slots[i] = index;
+        }
+    }
+};
+
+// Closes the submesh that starts at `first_index`, empty ones are dropped.
+static void end_submesh(MeshData& mesh, uint32_t first_index)
+{
+    uint32_t count = static_cast<uint32_t>(mesh.indices.size()) - first_index;
+    if (count == 0) return;
+    SubMesh submesh;
+    submesh.first_index = first_index;
+    submesh.index_count = count;
+    mesh.submeshes.push_back(submesh);
+}
+
+static void compute_bounds(MeshData& mesh)
+{
+    for (SubMesh& submesh : mesh.submeshes) {
+        glm::vec3 bounds_min(FLT_MAX), bounds_max(-FLT_MAX);
+        for (uint32_t i = submesh.first_index; i < submesh.first_index + submesh.index_count; i++) {
+            const glm::vec3& pos = mesh.vertices[mesh.indices[i]].pos;
+            bounds_min = glm::min(bounds_min, pos);
+            bounds_max = glm::max(bounds_max, pos);
+        }
+        submesh.bounds_min = bounds_min;
+        submesh.bounds_max = bounds_max;
+
+        if (&submesh == &mesh.submeshes.front()) {
+            mesh.bounds_min = bounds_min;
+            mesh.bounds_max = bounds_max;
+        }
+        mesh.bounds_min = glm::min(mesh.bounds_min, bounds_min);
+        mesh.bounds_max = glm::max(mesh.bounds_max, bounds_max);
+    }
+}
+
+static void print_import_stats(const std::string& path, const MeshData& mesh, const MeshImportStats& stats)
+{
+    printf("[Mesh] %s : %.2f MB in %.1f ms (%.1f MB/s, %.2f M vertices/s), %llu -> %zu vertices, %llu triangles \n",
+        path.c_str(), stats.file_bytes / (1024.0 * 1024.0), stats.seconds * 1000.0,
+        stats.mb_per_second(), stats.vertices_per_second() / 1e6,
+        (unsigned long long)stats.source_vertices, mesh.vertices.size(), (unsigned long long)stats.triangles);
+}
+
+MeshData MeshImporter::load(const std::string& path, MeshImportStats* stats)
+{
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "obj") return load_obj(path, stats);
+    if (extension == "gltf" || extension == "glb") return load_gltf(path, stats);
+    throw std::runtime_error("failed to import mesh, unsupported format: " + path);
+}
+
+//----------------------
+//  OBJ
+//----------------------
+// Only v / vt / f matter for Model::Vertex, everything else (normals, groups, materials) is skipped.
+// "v x y z r g b" (vertex colors) is supported, the color defaults to white.
+struct ObjParser {
+    std::vector<glm::vec3>  positions;
+    std::vector<glm::vec3>  colors;
+    std::vector<glm::vec2>  texcoords;
+
+    MeshData&               mesh;
+    MeshImportStats&        stats;
+    WeldTable               weld;
+    std::vector<uint64_t>   keys;       // (position, texcoord) of every unique vertex
+    std::vector<uint32_t>   polygon;    // vertex indices of the face being read
+    uint32_t                submesh_start = 0;
+
+    ObjParser(MeshData& _mesh, MeshImportStats& _stats) : mesh{ _mesh }, stats{ _stats } {}
+
+    static inline const char* skip_spaces(const char* it, const char* end)
+    {
+        while (it < end && (*it == ' ' || *it == '\t')) it++;
+        return it;
+    }
+
+    static inline const char* read_float(const char* it, const char* end, float& value)
+    {
+        it = skip_spaces(it, end);
+        // from_chars does not take a leading '+'
+        if (it < end && *it == '+') it++;
+        auto result = std::from_chars(it, end, value);
+        if (result.ec != std::errc()) {
+            throw std::runtime_error("failed to import obj, bad number!");
+        }
+        return result.ptr;
+    }
+
+    // OBJ indices start at 1, negative ones count back from the last element.
+    static inline uint32_t resolve_index(int64_t index, size_t count)
+    {
+        int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(count) + index;
+        if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(count)) {
+            throw std::runtime_error("failed to import obj, index out of range!");
+        }
+        return static_cast<uint32_t>(resolved);
+    }
+
+    uint32_t weld_corner(uint32_t position, uint32_t texcoord)
+    {
+        stats.source_vertices++;
+        uint64_t key = (static_cast<uint64_t>(position) << 32) | texcoord;
+        uint32_t next = static_cast<uint32_t>(mesh.vertices.size());
+        uint32_t index = weld.insert(mix_hash(key), next,
+            [&](uint32_t other) { return keys[other] == key; });
+
+        if (index == next) {
+            Model::Vertex vertex{};
+            vertex.pos = positions[position];
+            vertex.color = position < colors.size() ? colors[position] : glm::vec3(1.0f);
+            if (texcoord != UINT32_MAX) {
+                // OBJ has its origin at the bottom left, Vulkan samples from the top left.
+                vertex.texCoord = glm::vec2(texcoords[texcoord].x, 1.0f - texcoords[texcoord].y);
+            }
+            mesh.vertices.push_back(vertex);
+            keys.push_back(key);
+        }
+        return index;
+    }
+
+    void parse_face(const char* it, const char* end)
+    {
+        polygon.clear();
+        while ((it = skip_spaces(it, end)) < end) {
+            // v, v/vt, v//vn or v/vt/vn
+            int64_t position = 0, texcoord = 0;
+            auto result = std::from_chars(it, end, position);
+            if (result.ec != std::errc()) {
+                throw std::runtime_error("failed to import obj, bad face!");
+            }
+            it = result.ptr;
+            if (it < end && *it == '/') {
+                it++;
+                if (it < end && *it != '/') {
+                    result = std::from_chars(it, end, texcoord);
+                    it = result.ptr;
+                }
+                if (it < end && *it == '/') {
+                    int64_t normal;
+                    it = std::from_chars(it + 1, end, normal).ptr;
+                }
+            }
+            polygon.push_back(weld_corner(
+                resolve_index(position, positions.size()),
+                texcoord != 0 ? resolve_index(texcoord, texcoords.size()) : UINT32_MAX));
+        }
+
+        // Fan triangulation, faces are expected to be convex.
+        for (size_t i = 2; i < polygon.size(); i++) {
+            mesh.indices.push_back(polygon[0]);
+            mesh.indices.push_back(polygon[i - 1]);
+            mesh.indices.push_back(polygon[i]);
+            stats.triangles++;
+        }
+    }
+
+    void parse_line(const char* it, const char* end)
+    {
+        it = skip_spaces(it, end);
+        if (end - it < 2) return;
+
+        if (it[0] == 'v' && (it[1] == ' ' || it[1] == '\t')) {
+            glm::vec3 position;
+            it = read_float(it + 1, end, position.x);
+            it = read_float(it, end, position.y);
+            it = read_float(it, end, position.z);
+            positions.push_back(position);
+
+            if (skip_spaces(it, end) < end) {
+                glm::vec3 color;
+                it = read_float(it, end, color.x);
+                it = read_float(it, end, color.y);
+                it = read_float(it, end, color.z);
+                colors.resize(positions.size(), glm::vec3(1.0f));
+                colors.back() = color;
+            }
+        }
+        else if (it[0] == 'v' && it[1] == 't') {
+            glm::vec2 texcoord;
+            it = read_float(it + 2, end, texcoord.x);
+            texcoord.y = 0.0f;
+            if (skip_spaces(it, end) < end) read_float(it, end, texcoord.y);
+            texcoords.push_back(texcoord);
+        }
+        else if (it[0] == 'f' && (it[1] == ' ' || it[1] == '\t')) {
+            parse_face(it + 1, end);
+        }
+        else if ((it[0] == 'o' || it[0] == 'g') && (it[1] == ' ' || it[1] == '\t')) {
+            // Every object / group is drawable on its own.
+            end_submesh(mesh, submesh_start);
+            submesh_start = static_cast<uint32_t>(mesh.indices.size());
+        }
+    }
+};
+
+MeshData MeshImporter::load_obj(const std::string& path, MeshImportStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    MeshData mesh;
+    MeshImportStats local_stats;
+    ObjParser parser(mesh, local_stats);
+
+    //----------------
+    //  Stream the text
+    //----------------
+    // Whole lines are parsed out of the read buffer, the partial last line is moved to
+    // the front before the next read. The buffer only grows for lines longer than itself.
+    std::vector<char> buffer(READ_CHUNK_SIZE);
+    size_t pending = 0;
+    bool eof = false;
+    while (!eof) {
+        if (pending == buffer.size()) buffer.resize(buffer.size() * 2);
+        file.read(buffer.data() + pending, buffer.size() - pending);
+        size_t read = static_cast<size_t>(file.gcount());
+        local_stats.file_bytes += read;
+        eof = read == 0;
+
+        const char* begin = buffer.data();
+        const char* end = begin + pending + read;
+        const char* line = begin;
+        for (;;) {
+            const char* newline = static_cast<const char*>(memchr(line, '\n', end - line));
+            if (newline == nullptr) {
+                // The last line of the file has no line break.
+                if (eof && line < end) newline = end;
+                else break;
+            }
+            const char* line_end = newline;
+            if (line_end > line && line_end[-1] == '\r') line_end--;
+            const char* comment = static_cast<const char*>(memchr(line, '#', line_end - line));
+            parser.parse_line(line, comment ? comment : line_end);
+            line = newline + 1;
+            if (line >= end) break;
+        }
+        pending = line < end ? static_cast<size_t>(end - line) : 0;
+        memmove(buffer.data(), line, pending);
+    }
+    end_submesh(mesh, parser.submesh_start);
+    compute_bounds(mesh);
+
+    local_stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    print_import_stats(path, mesh, local_stats);
+    if (stats) *stats = local_stats;
+    return mesh;
+}
+
+//----------------------
+//  JSON
+//----------------------
+// Small DOM for the glTF header. The binary payload never goes through it
+// (except data uris, which are decoded once and dropped).
+struct JsonValue {
+    enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+    Type                    type = NUL;
+    bool                    boolean = false;
+    double                  number = 0.0;
+    std::string             string;
+    std::vector<JsonValue>  items;
+    std::vector<std::string> keys;  // OBJECT : keys[i] → items[i]
+
+    const JsonValue* find(const char* key) const
+    {
+        if (type != OBJECT) return nullptr;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (keys[i] == key) return &items[i];
+        }
+        return nullptr;
+    }
+    JsonValue* find(const char* key)
+    {
+        return const_cast<JsonValue*>(static_cast<const JsonValue&>(*this).find(key));
+    }
+    double number_or(const char* key, double fallback) const
+    {
+        const JsonValue* value = find(key);
+        return value && value->type == NUMBER ? value->number : fallback;
+    }
+    size_t size() const { return type == ARRAY ? items.size() : 0; }
+    const JsonValue& operator[](size_t i) const
+    {
+        if (type != ARRAY || i >= items.size()) {
+            throw std::runtime_error("failed to import gltf, index out of range!");
+        }
+        return items[i];
+    }
+};
+
+struct JsonParser {
+    const char* it;
+    const char* end;
+
+    void fail() { throw std::runtime_error("failed to import gltf, malformed json!"); }
+
+    void skip_spaces()
+    {
+        while (it < end && (*it == ' ' || *it == '\t' || *it == '\n' || *it == '\r')) it++;
+    }
+
+    void expect(char c)
+    {
+        skip_spaces();
+        if (it >= end || *it != c) fail();
+        it++;
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        std::string result;
+        while (it < end && *it != '"') {
+            if (*it != '\\') { result += *it++; continue; }
+            if (++it >= end) fail();
+            switch (*it++) {
+            case 'n': result += '\n'; break;
+            case 't': result += '\t'; break;
+            case 'r': result += '\r'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'u': {
+                if (end - it < 4) fail();
+                uint32_t code = static_cast<uint32_t>(strtoul(std::string(it, 4).c_str(), nullptr, 16));
+                it += 4;
+                // UTF-8, surrogate pairs are not joined (names only, never used to look data up)
+                if (code < 0x80) result += static_cast<char>(code);
+                else if (code < 0x800) {
+                    result += static_cast<char>(0xC0 | (code >> 6));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                else {
+                    result += static_cast<char>(0xE0 | (code >> 12));
+                    result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                    result += static_cast<char>(0x80 | (code & 0x3F));
+                }
+                break;
+            }
+            default: result += it[-1]; break;
+            }
+        }
+        if (it >= end) fail();
+        it++;
+        return result;
+    }
+
+    JsonValue parse_value()
+    {
+        skip_spaces();
+        if (it >= end) fail();
+
+        JsonValue value;
+        switch (*it) {
+        case '{':
+            value.type = JsonValue::OBJECT;
+            it++;
+            skip_spaces();
+            if (it < end && *it == '}') { it++; break; }
+            for (;;) {
+                value.keys.push_back(parse_string());
+                expect(':');
+                value.items.push_back(parse_value());
+                skip_spaces();
+                if (it < end && *it == ',') { it++; continue; }
+                expect('}');
+                break;
+            }
+            break;
+        case '[':
+            value.type = JsonValue::ARRAY;
+            it++;
+            skip_spaces();
+            if (it < end && *it == ']') { it++; break; }
+            for (;;) {
+                value.items.push_back(parse_value());
+                skip_spaces();
+                if (it < end && *it == ',') { it++; continue; }
+                expect(']');
+                break;
+            }
+            break;
+        case '"':
+            value.type = JsonValue::STRING;
+            value.string = parse_string();
+            break;
+        case 't': case 'f':
+            value.type = JsonValue::BOOLEAN;
+            value.boolean = *it == 't';
+            it += value.boolean ? 4 : 5;
+            break;
+        case 'n':
+            it += 4;
+            break;
+        default: {
+            value.type = JsonValue::NUMBER;
+            char* number_end;
+            // The document is null terminated (std::string), strtod cannot run past it.
+            value.number = strtod(it, &number_end);
+            if (number_end == it) fail();
+            it = number_end;
+            break;
+        }
+        }
+        if (it > end) fail();
+        return value;
+    }
+};
+
+//----------------------
+//  glTF
+//----------------------
+static const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+// A glTF buffer is either a byte range of a file (.bin, or the BIN chunk of a .glb)
+// read on demand, or a decoded data uri.
+struct GltfBuffer {
+    std::string             path;
+    uint64_t                file_offset = 0;
+    uint64_t                byte_length = 0;
+    std::vector<uint8_t>    data;
+    std::ifstream           file;
+
+    void read(uint64_t offset, uint64_t size, uint8_t* dst, MeshImportStats& stats)
+    {
+        if (offset + size > byte_length) {
+            throw std::runtime_error("failed to import gltf, accessor out of buffer range!");
+        }
+        if (!data.empty()) {
+            memcpy(dst, data.data() + offset, size);
+            return;
+        }
+        if (!file.is_open()) {
+            file.open(path, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("failed to open file!");
+            }
+        }
+        file.seekg(static_cast<std::streamoff>(file_offset + offset));
+        file.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(size));
+        if (static_cast<uint64_t>(file.gcount()) != size) {
+            throw std::runtime_error("failed to import gltf, buffer file is truncated!");
+        }
+        stats.file_bytes += size;
+    }
+};
+
+static int base64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+static void decode_base64(std::string_view text, std::vector<uint8_t>& out)
+{
+    out.clear();
+    out.reserve(text.size() / 4 * 3);
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (char c : text) {
+        int value = base64_value(c);
+        if (value < 0) continue;    // padding / line breaks
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            out.push_back(static_cast<uint8_t>(bits >> bit_count));
+        }
+    }
+}
+
+// Reads the elements of one accessor as floats, READ_CHUNK_SIZE elements at a time.
+struct GltfAccessorReader {
+    GltfBuffer*     buffer = nullptr;
+    uint64_t        offset = 0;         // of element 0 in the buffer
+    uint32_t        stride = 0;
+    uint32_t        count = 0;
+    uint32_t        components = 0;
+    uint32_t        component_type = 0;
+    bool            normalized = false;
+    std::vector<uint8_t> scratch;
+
+    static uint32_t component_size(uint32_t type)
+    {
+        switch (type) {
+        case 5120: case 5121: return 1;     // BYTE, UNSIGNED_BYTE
+        case 5122: case 5123: return 2;     // SHORT, UNSIGNED_SHORT
+        case 5125: case 5126: return 4;     // UNSIGNED_INT, FLOAT
+        }
+        throw std::runtime_error("failed to import gltf, unknown component type!");
+    }
+
+    static uint32_t component_count(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        throw std::runtime_error("failed to import gltf, unsupported accessor type: " + type);
+    }
+
+    inline uint32_t element_size() const { return components * component_size(component_type); }
+
+    // Loads elements [first, first + n) into the scratch buffer.
+    const uint8_t* fetch(uint32_t first, uint32_t n, MeshImportStats& stats)
+    {
+        uint64_t size = static_cast<uint64_t>(n - 1) * stride + element_size();
+        scratch.resize(size);
+        buffer->read(offset + static_cast<uint64_t>(first) * stride, size, scratch.data(), stats);
+        return scratch.data();
+    }
+
+    float read_component(const uint8_t* src, uint32_t c) const
+    {
+        switch (component_type) {
+        case 5126: { float v; memcpy(&v, src + c * 4, 4); return v; }
+        case 5120: { int8_t v = static_cast<int8_t>(src[c]); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case 5121: { uint8_t v = src[c]; return normalized ? v / 255.0f : v; }
+        case 5122: { int16_t v; memcpy(&v, src + c * 2, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+        case 5123: { uint16_t v; memcpy(&v, src + c * 2, 2); return normalized ? v / 65535.0f : v; }
+        case 5125: { uint32_t v; memcpy(&v, src + c * 4, 4); return static_cast<float>(v); }
+        }
+        return 0.0f;
+    }
+
+    uint32_t read_index(const uint8_t* src) const
+    {
+        switch (component_type) {
+        case 5121: return src[0];
+        case 5123: { uint16_t v; memcpy(&v, src, 2); return v; }
+        case 5125: { uint32_t v; memcpy(&v, src, 4); return v; }
+        }
+        throw std::runtime_error("failed to import gltf, bad index component type!");
+    }
+};
+
+struct GltfImporter {
+    JsonValue               document;
+    std::vector<GltfBuffer> buffers;
+    MeshData&               mesh;
+    MeshImportStats&        stats;
+    WeldTable               weld;
+    std::vector<uint32_t>   remap;      // primitive vertex → welded vertex
+
+    GltfImporter(MeshData& _mesh, MeshImportStats& _stats) : mesh{ _mesh }, stats{ _stats } {}
+
+    void load_document(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file!");
+        }
+
+        // .glb : 12 byte header, then the JSON chunk and an optional BIN chunk.
+        uint32_t header[3] = {};
+        file.read(reinterpret_cast<char*>(header), sizeof(header));
+        std::string json;
+        uint64_t bin_offset = 0, bin_length = 0;
+        if (file.gcount() == sizeof(header) && header[0] == GLB_MAGIC) {
+            if (header[1] != 2) {
+                throw std::runtime_error("failed to import gltf, only glTF 2.0 is supported!");
+            }
+            uint64_t position = sizeof(header);
+            while (position + 8 <= header[2]) {
+                uint32_t chunk[2];
+                file.seekg(static_cast<std::streamoff>(position));
+                file.read(reinterpret_cast<char*>(chunk), sizeof(chunk));
+                if (chunk[1] == GLB_CHUNK_JSON) {
+                    json.resize(chunk[0]);
+                    file.read(json.data(), chunk[0]);
+                }
+                else if (chunk[1] == GLB_CHUNK_BIN) {
+                    bin_offset = position + 8;
+                    bin_length = chunk[0];
+                }
+                position += 8 + ((chunk[0] + 3u) & ~3u);
+            }
+            stats.file_bytes += json.size() + 20;
+        }
+        else {
+            file.seekg(0, std::ios::end);
+            json.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(json.data(), json.size());
+            stats.file_bytes += json.size();
+        }
+
+        JsonParser parser{ json.data(), json.data() + json.size() };
+        document = parser.parse_value();
+        json.clear();
+        json.shrink_to_fit();
+
+        //----------------
+        //  Buffers
+        //----------------
+        std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        JsonValue* buffer_list = document.find("buffers");
+        size_t buffer_count = buffer_list ? buffer_list->size() : 0;
+        buffers = std::vector<GltfBuffer>(buffer_count);
+        for (size_t i = 0; i < buffer_count; i++) {
+            JsonValue& desc = buffer_list->items[i];
+            GltfBuffer& buffer = buffers[i];
+            buffer.byte_length = static_cast<uint64_t>(desc.number_or("byteLength", 0));
+
+            JsonValue* uri = desc.find("uri");
+            if (uri == nullptr) {
+                // The first buffer of a .glb refers to its BIN chunk.
+                if (i != 0 || bin_length == 0) {
+                    throw std::runtime_error("failed to import gltf, buffer without uri!");
+                }
+                buffer.path = path;
+                buffer.file_offset = bin_offset;
+                buffer.byte_length = std::min(buffer.byte_length, bin_length);
+            }
+            else if (uri->string.compare(0, 5, "data:") == 0) {
+                size_t comma = uri->string.find(',');
+                if (comma == std::string::npos || uri->string.rfind(";base64", comma) == std::string::npos) {
+                    throw std::runtime_error("failed to import gltf, unsupported data uri!");
+                }
+                decode_base64(std::string_view(uri->string).substr(comma + 1), buffer.data);
+                stats.file_bytes += uri->string.size();
+                // The text form is not needed anymore.
+                uri->string.clear();
+                uri->string.shrink_to_fit();
+                if (buffer.data.size() < buffer.byte_length) {
+                    throw std::runtime_error("failed to import gltf, data uri is too short!");
+                }
+            }
+            else {
+                buffer.path = directory + uri->string;
+            }
+        }
+    }
+
+    GltfAccessorReader make_reader(uint32_t accessor_index)
+    {
+        const JsonValue* accessors = document.find("accessors");
+        if (accessors == nullptr) {
+            throw std::runtime_error("failed to import gltf, no accessors!");
+        }
+        const JsonValue& accessor = (*accessors)[accessor_index];
+        if (accessor.find("sparse")) {
+            throw std::runtime_error("failed to import gltf, sparse accessors are not supported!");
+        }
+        const JsonValue* view_index = accessor.find("bufferView");
+        if (view_index == nullptr) {
+            throw std::runtime_error("failed to import gltf, accessor without buffer view!");
+        }
+        const JsonValue& view = (*document.find("bufferViews"))[static_cast<size_t>(view_index->number)];
+
+        GltfAccessorReader reader;
+        reader.buffer = &buffers.at(static_cast<size_t>(view.number_or("buffer", 0)));
+        reader.offset = static_cast<uint64_t>(view.number_or("byteOffset", 0) + accessor.number_or("byteOffset", 0));
+        reader.count = static_cast<uint32_t>(accessor.number_or("count", 0));
+        reader.component_type = static_cast<uint32_t>(accessor.number_or("componentType", 0));
+        reader.components = GltfAccessorReader::component_count(accessor.find("type") ? accessor.find("type")->string : "");
+        const JsonValue* normalized = accessor.find("normalized");
+        reader.normalized = normalized && normalized->boolean;
+        reader.stride = static_cast<uint32_t>(view.number_or("byteStride", 0));
+        if (reader.stride == 0) reader.stride = reader.element_size();
+        return reader;
+    }
+
+    void import_primitive(const JsonValue& primitive, const glm::mat4& transform)
+    {
+        // TRIANGLES only (default mode), points / lines / strips are skipped.
+        if (primitive.number_or("mode", 4) != 4) return;
+        const JsonValue* attributes = primitive.find("attributes");
+        const JsonValue* position_attribute = attributes ? attributes->find("POSITION") : nullptr;
+        if (position_attribute == nullptr) return;
+
+        GltfAccessorReader positions = make_reader(static_cast<uint32_t>(position_attribute->number));
+        GltfAccessorReader texcoords, colors;
+        const JsonValue* texcoord_attribute = attributes->find("TEXCOORD_0");
+        const JsonValue* color_attribute = attributes->find("COLOR_0");
+        if (texcoord_attribute) texcoords = make_reader(static_cast<uint32_t>(texcoord_attribute->number));
+        if (color_attribute) colors = make_reader(static_cast<uint32_t>(color_attribute->number));
+        if (positions.components < 3 || (texcoords.buffer && (texcoords.components < 2 || texcoords.count < positions.count))
+            || (colors.buffer && (colors.components < 3 || colors.count < positions.count))) {
+            throw std::runtime_error("failed to import gltf, bad vertex attributes!");
+        }
+        if (positions.count == 0) return;
+        uint32_t submesh_start = static_cast<uint32_t>(mesh.indices.size());
+
+        //----------------
+        //  Vertices
+        //----------------
+        // Welded chunk by chunk, `remap` maps the primitive's vertices to the output.
+        remap.resize(positions.count);
+        for (uint32_t first = 0; first < positions.count; first += static_cast<uint32_t>(MeshImporter::READ_CHUNK_SIZE)) {
+            uint32_t n = std::min<uint32_t>(static_cast<uint32_t>(MeshImporter::READ_CHUNK_SIZE), positions.count - first);
+            const uint8_t* position_src = positions.fetch(first, n, stats);
+            const uint8_t* texcoord_src = texcoords.buffer ? texcoords.fetch(first, n, stats) : nullptr;
+            const uint8_t* color_src = colors.buffer ? colors.fetch(first, n, stats) : nullptr;
+
+            for (uint32_t i = 0; i < n; i++) {
+                Model::Vertex vertex{};
+                const uint8_t* p = position_src + static_cast<size_t>(i) * positions.stride;
+                glm::vec4 position = transform * glm::vec4(
+                    positions.read_component(p, 0), positions.read_component(p, 1), positions.read_component(p, 2), 1.0f);
+                vertex.pos = glm::vec3(position.x, position.y, position.z);
+                vertex.color = glm::vec3(1.0f);
+                if (color_src) {
+                    const uint8_t* c = color_src + static_cast<size_t>(i) * colors.stride;
+                    vertex.color = glm::vec3(colors.read_component(c, 0), colors.read_component(c, 1), colors.read_component(c, 2));
+                }
+                if (texcoord_src) {
+                    const uint8_t* t = texcoord_src + static_cast<size_t>(i) * texcoords.stride;
+                    vertex.texCoord = glm::vec2(texcoords.read_component(t, 0), texcoords.read_component(t, 1));
+                }
+
+                uint32_t next = static_cast<uint32_t>(mesh.vertices.size());
+                uint32_t index = weld.insert(hash_vertex(vertex), next, [&](uint32_t other) {
+                    return memcmp(&mesh.vertices[other], &vertex, sizeof(Model::Vertex)) == 0;
+                });
+                if (index == next) mesh.vertices.push_back(vertex);
+                remap[first + i] = index;
+            }
+        }
+
+        //----------------
+        //  Indices
+        //----------------
+        const JsonValue* indices_accessor = primitive.find("indices");
+        if (indices_accessor == nullptr) {
+            // Non indexed : every 3 vertices make a triangle.
+            uint32_t count = positions.count - positions.count % 3;
+            for (uint32_t i = 0; i < count; i++) mesh.indices.push_back(remap[i]);
+            stats.source_vertices += count;
+            stats.triangles += count / 3;
+            end_submesh(mesh, submesh_start);
+            return;
+        }
+
+        GltfAccessorReader indices = make_reader(static_cast<uint32_t>(indices_accessor->number));
+        uint32_t count = indices.count - indices.count % 3;
+        for (uint32_t first = 0; first < count; first += static_cast<uint32_t>(MeshImporter::READ_CHUNK_SIZE)) {
+            uint32_t n = std::min<uint32_t>(static_cast<uint32_t>(MeshImporter::READ_CHUNK_SIZE), count - first);
+            const uint8_t* src = indices.fetch(first, n, stats);
+            for (uint32_t i = 0; i < n; i++) {
+                uint32_t index = indices.read_index(src + static_cast<size_t>(i) * indices.stride);
+                if (index >= positions.count) {
+                    throw std::runtime_error("failed to import gltf, index out of range!");
+                }
+                mesh.indices.push_back(remap[index]);
+            }
+        }
+        stats.source_vertices += count;
+        stats.triangles += count / 3;
+        end_submesh(mesh, submesh_start);
+    }
+
+    void import_mesh(uint32_t mesh_index, const glm::mat4& transform)
+    {
+        const JsonValue* meshes = document.find("meshes");
+        if (meshes == nullptr) return;
+        const JsonValue* primitives = (*meshes)[mesh_index].find("primitives");
+        for (size_t i = 0; primitives && i < primitives->size(); i++) {
+            import_primitive((*primitives)[i], transform);
+        }
+    }
+
+    static glm::mat4 local_transform(const JsonValue& node)
+    {
+        glm::mat4 result(1.0f);
+        const JsonValue* matrix = node.find("matrix");
+        if (matrix && matrix->size() == 16) {
+            // Column major, like glm
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 4; r++) result[c][r] = static_cast<float>((*matrix)[c * 4 + r].number);
+            }
+            return result;
+        }
+
+        auto read = [&](const char* key, float* out, size_t n) {
+            const JsonValue* value = node.find(key);
+            if (value && value->size() == n) {
+                for (size_t i = 0; i < n; i++) out[i] = static_cast<float>((*value)[i].number);
+            }
+        };
+        float t[3] = { 0, 0, 0 }, r[4] = { 0, 0, 0, 1 }, s[3] = { 1, 1, 1 };
+        read("translation", t, 3);
+        read("rotation", r, 4);
+        read("scale", s, 3);
+
+        // T * R * S, the rotation is a unit quaternion (x, y, z, w).
+        float x = r[0], y = r[1], z = r[2], w = r[3];
+        result[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0) * s[0];
+        result[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0) * s[1];
+        result[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0) * s[2];
+        result[3] = glm::vec4(t[0], t[1], t[2], 1);
+        return result;
+    }
+
+    void import_node(uint32_t node_index, const glm::mat4& parent, uint32_t depth)
+    {
+        // Guards against cyclic (invalid) hierarchies.
+        if (depth > 64) {
+            throw std::runtime_error("failed to import gltf, node hierarchy is too deep!");
+        }
+        const JsonValue& node = (*document.find("nodes"))[node_index];
+        glm::mat4 transform = parent * local_transform(node);
+
+        const JsonValue* mesh_index = node.find("mesh");
+        if (mesh_index) import_mesh(static_cast<uint32_t>(mesh_index->number), transform);
+
+        const JsonValue* children = node.find("children");
+        for (size_t i = 0; children && i < children->size(); i++) {
+            import_node(static_cast<uint32_t>((*children)[i].number), transform, depth + 1);
+        }
+    }
+
+    void import_scene()
+    {
+        const JsonValue* scenes = document.find("scenes");
+        if (scenes == nullptr || scenes->size() == 0) {
+            // No scene : the meshes are taken as they are.
+            const JsonValue* meshes = document.find("meshes");
+            for (size_t i = 0; meshes && i < meshes->size(); i++) {
+                import_mesh(static_cast<uint32_t>(i), glm::mat4(1.0f));
+            }
+            return;
+        }
+
+        const JsonValue& scene = (*scenes)[static_cast<size_t>(document.number_or("scene", 0))];
+        const JsonValue* nodes = scene.find("nodes");
+        for (size_t i = 0; nodes && i < nodes->size(); i++) {
+            import_node(static_cast<uint32_t>((*nodes)[i].number), glm::mat4(1.0f), 0);
+        }
+    }
+};
+
+MeshData MeshImporter::load_gltf(const std::string& path, MeshImportStats* stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    MeshData mesh;
+    MeshImportStats local_stats;
+    GltfImporter importer(mesh, local_stats);
+    importer.load_document(path);
+    importer.import_scene();
+    compute_bounds(mesh);
+
+    local_stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    print_import_stats(path, mesh, local_stats);
+    if (stats) *stats = local_stats;
+    return mesh;
+}
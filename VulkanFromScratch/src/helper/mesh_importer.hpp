@@ -0,0 +1,50 @@
+#pragma once
+#include "core/core_fwd.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Index range of one OBJ object / group or one glTF primitive.
+struct SubMesh {
+	uint32_t	first_index = 0;
+	uint32_t	index_count = 0;
+	glm::vec3	bounds_min = glm::vec3(0.0f);
+	glm::vec3	bounds_max = glm::vec3(0.0f);
+};
+
+// Welded triangle list, already in the layout of the vertex buffer.
+struct MeshData {
+	std::vector<Model::Vertex>	vertices;
+	std::vector<uint32_t>		indices;
+	std::vector<SubMesh>		submeshes;
+	glm::vec3					bounds_min = glm::vec3(0.0f);
+	glm::vec3					bounds_max = glm::vec3(0.0f);
+};
+
+struct MeshImportStats {
+	uint64_t	file_bytes = 0;			// text + binary buffers read
+	uint64_t	source_vertices = 0;	// face corners before welding
+	uint64_t	triangles = 0;
+	double		seconds = 0.0;
+
+	inline double mb_per_second() const { return seconds > 0.0 ? file_bytes / (1024.0 * 1024.0) / seconds : 0.0; }
+	inline double vertices_per_second() const { return seconds > 0.0 ? source_vertices / seconds : 0.0; }
+};
+
+// Loads OBJ and glTF 2.0 (.gltf with embedded / external buffers, .glb) meshes.
+// The source is streamed: OBJ text goes through a fixed size read buffer and glTF
+// accessors are read chunk by chunk from their buffer, so a large file is never
+// resident next to its parsed copy. Identical vertices are welded through a hash
+// table, the output only holds unique vertices.
+class MeshImporter {
+public:
+	// Picks the parser from the extension. Throws on unsupported or malformed files.
+	static MeshData load(const std::string& path, MeshImportStats* stats = nullptr);
+
+	static MeshData load_obj(const std::string& path, MeshImportStats* stats = nullptr);
+	// Every triangle primitive of the default scene, with the node transforms applied.
+	static MeshData load_gltf(const std::string& path, MeshImportStats* stats = nullptr);
+
+	// Size of the OBJ read buffer / number of glTF elements read at once.
+	static constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+};
@@ -0,0 +1,291 @@
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
+
+//----------------------
+//  Cache model
+//----------------------
+// FIFO post transform cache. A vertex stays a hit while less than CACHE_SIZE misses
+// happened since it was loaded, so only the load time of every vertex is needed.
+struct CacheSimulator {
+    std::vector<uint32_t>   loaded_at;
+    uint32_t                time = MeshOptimizer::CACHE_SIZE + 1;
+
+    explicit CacheSimulator(size_t vertex_count) : loaded_at(vertex_count, 0) {}
+
+    inline bool is_hit(uint32_t vertex) const { return time - loaded_at[vertex] <= MeshOptimizer::CACHE_SIZE; }
+
+    // Returns the number of misses (0 - 3).
+    inline uint32_t access_triangle(const uint32_t* triangle)
+    {
+        uint32_t misses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (!is_hit(triangle[i])) {
+                loaded_at[triangle[i]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+};
+
+void MeshOptimizer::analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+    float& acmr, float& atvr)
+{
+    CacheSimulator cache(vertex_count);
+    std::vector<uint8_t> used(vertex_count, 0);
+    size_t misses = 0, unique = 0;
+    for (size_t i = 0; i + 2 < index_count; i += 3) {
+        misses += cache.access_triangle(indices + i);
+        for (int c = 0; c < 3; c++) {
+            unique += used[indices[i + c]] == 0;
+            used[indices[i + c]] = 1;
+        }
+    }
+    acmr = index_count >= 3 ? static_cast<float>(misses) / (index_count / 3) : 0.0f;
+    atvr = unique > 0 ? static_cast<float>(misses) / unique : 0.0f;
+}
+
+//----------------------
+//  Vertex cache : Tipsify
+//----------------------
+// Fans around one vertex at a time and picks the next one among the vertices just emitted,
+// preferring the oldest that will still be in the cache once its remaining triangles are out.
+// Indices are local (0 .. vertex_count - 1, all referenced). The start triangle of every run
+// that began at a dead end is written to `hard_boundaries`.
+static void tipsify(uint32_t* indices, size_t index_count, uint32_t vertex_count, std::vector<uint32_t>& hard_boundaries)
+{
+    const uint32_t cache_size = MeshOptimizer::CACHE_SIZE;
+    size_t triangle_count = index_count / 3;
+
+    // Vertex → triangles
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (size_t i = 0; i < index_count; i++) live[indices[i]]++;
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + live[v];
+    std::vector<uint32_t> adjacency(index_count);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < index_count; i++) adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint8_t> emitted(triangle_count, 0);
+    std::vector<uint32_t> output;
+    dead_end.reserve(index_count);
+    output.reserve(index_count);
+
+    uint32_t time = cache_size + 1;
+    uint32_t scan = 0;      // next vertex to try once the dead end stack is empty
+    int64_t fanning = 0;
+    hard_boundaries.push_back(0);
+
+    while (fanning >= 0) {
+        candidates.clear();
+        for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            uint32_t triangle = adjacency[a];
+            if (emitted[triangle]) continue;
+            emitted[triangle] = 1;
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[triangle * 3 + c];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+            }
+        }
+
+        //----------------
+        //  Next fanning vertex
+        //----------------
+        int64_t next = -1;
+        int64_t best_priority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) continue;
+            int64_t priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size) priority = time - cache_time[v];
+            if (priority > best_priority) {
+                best_priority = priority;
+                next = v;
+            }
+        }
+        if (next < 0) {
+            // Dead end : latest emitted vertex with triangles left, else the next one in order.
+            while (!dead_end.empty() && next < 0) {
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0) next = v;
+            }
+            while (next < 0 && scan < vertex_count) {
+                if (live[scan] > 0) next = scan;
+                scan++;
+            }
+            if (next >= 0) hard_boundaries.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+        fanning = next;
+    }
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+}
+
+//----------------------
+//  Overdraw : cluster sort
+//----------------------
+// Sander et al. : the cache optimized order is cut where the running ACMR gets back close
+// to the cluster's own, then the clusters are drawn from the most outward facing to the
+// most inward facing (a view independent approximation of front to back).
+static uint32_t sort_clusters(uint32_t* indices, size_t index_count, const std::vector<glm::vec3>& positions,
+    const std::vector<uint32_t>& hard_boundaries)
+{
+    uint32_t triangle_count = static_cast<uint32_t>(index_count / 3);
+
+    //----------------
+    //  Soft boundaries
+    //----------------
+    std::vector<uint32_t> clusters;
+    CacheSimulator cache(positions.size());
+    for (size_t h = 0; h < hard_boundaries.size(); h++) {
+        uint32_t start = hard_boundaries[h];
+        uint32_t end = h + 1 < hard_boundaries.size() ? hard_boundaries[h + 1] : triangle_count;
+        if (start >= end) continue;
+
+        CacheSimulator cluster_cache(positions.size());
+        uint32_t cluster_misses = 0;
+        for (uint32_t t = start; t < end; t++) cluster_misses += cluster_cache.access_triangle(indices + t * 3);
+        float threshold = MeshOptimizer::OVERDRAW_THRESHOLD * cluster_misses / (end - start);
+
+        clusters.push_back(start);
+        uint32_t running_misses = 0, running_triangles = 0;
+        for (uint32_t t = start; t < end; t++) {
+            running_misses += cache.access_triangle(indices + t * 3);
+            running_triangles++;
+            if (t + 1 < end && running_misses <= threshold * running_triangles) {
+                clusters.push_back(t + 1);
+                running_misses = 0;
+                running_triangles = 0;
+            }
+        }
+    }
+    if (clusters.size() <= 1) return static_cast<uint32_t>(clusters.size());
+
+    //----------------
+    //  Sort
+    //----------------
+    struct Cluster {
+        uint32_t    start, end;
+        glm::vec3   centroid;
+        glm::vec3   normal;     // area weighted
+        float       area;
+        float       key;
+    };
+    std::vector<Cluster> sorted(clusters.size());
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        Cluster& cluster = sorted[c];
+        cluster.start = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+        cluster.centroid = glm::vec3(0.0f);
+        cluster.normal = glm::vec3(0.0f);
+        cluster.area = 0.0f;
+        for (uint32_t t = cluster.start; t < cluster.end; t++) {
+            const glm::vec3& a = positions[indices[t * 3 + 0]];
+            const glm::vec3& b = positions[indices[t * 3 + 1]];
+            const glm::vec3& d = positions[indices[t * 3 + 2]];
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float area = glm::length(normal);
+            cluster.normal += normal;
+            cluster.centroid += (a + b + d) * (area / 3.0f);
+            cluster.area += area;
+        }
+        mesh_centroid += cluster.centroid;
+        mesh_area += cluster.area;
+        if (cluster.area > 0.0f) cluster.centroid /= cluster.area;
+    }
+    if (mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+    for (Cluster& cluster : sorted) {
+        float length = glm::length(cluster.normal);
+        cluster.key = length > 0.0f ? glm::dot(cluster.centroid - mesh_centroid, cluster.normal / length) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+    std::vector<uint32_t> output;
+    output.reserve(index_count);
+    for (const Cluster& cluster : sorted) {
+        output.insert(output.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+    }
+    memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+    return static_cast<uint32_t>(clusters.size());
+}
+
+//----------------------
+//  Vertex fetch
+//----------------------
+// Renumbers the vertices in the order the index buffer first uses them.
+// Vertices no triangle refers to are dropped.
+static void optimize_vertex_fetch(MeshData& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Model::Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == UINT32_MAX) {
+            remap[index] = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void MeshOptimizer::optimize(MeshData& mesh, MeshOptimizeStats* stats)
+{
+    MeshOptimizeStats local_stats;
+    analyze_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(),
+        local_stats.acmr_before, local_stats.atvr_before);
+
+    // Submeshes are optimized on their own, with compact local vertex numbers so the
+    // work stays proportional to the submesh and not to the whole vertex buffer.
+    std::vector<uint32_t> to_local(mesh.vertices.size(), UINT32_MAX);
+    std::vector<uint32_t> to_global;
+    std::vector<uint32_t> local_indices;
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> hard_boundaries;
+    for (const SubMesh& submesh : mesh.submeshes) {
+        uint32_t* indices = mesh.indices.data() + submesh.first_index;
+        local_indices.resize(submesh.index_count - submesh.index_count % 3);
+        if (local_indices.empty()) continue;
+        for (size_t i = 0; i < local_indices.size(); i++) {
+            uint32_t& local = to_local[indices[i]];
+            if (local == UINT32_MAX) {
+                local = static_cast<uint32_t>(to_global.size());
+                to_global.push_back(indices[i]);
+                positions.push_back(mesh.vertices[indices[i]].pos);
+            }
+            local_indices[i] = local;
+        }
+
+        tipsify(local_indices.data(), local_indices.size(), static_cast<uint32_t>(to_global.size()), hard_boundaries);
+        local_stats.clusters += sort_clusters(local_indices.data(), local_indices.size(), positions, hard_boundaries);
+
+        for (size_t i = 0; i < local_indices.size(); i++) indices[i] = to_global[local_indices[i]];
+        for (uint32_t global : to_global) to_local[global] = UINT32_MAX;
+        to_global.clear();
+        positions.clear();
+        hard_boundaries.clear();
+    }
+
+    optimize_vertex_fetch(mesh);
+
+    analyze_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size(),
+        local_stats.acmr_after, local_stats.atvr_after);
+    printf("[Mesh] optimized : ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %u cluster(s) \n",
+        local_stats.acmr_before, local_stats.acmr_after,
+        local_stats.atvr_before, local_stats.atvr_after, local_stats.clusters);
+    if (stats) *stats = local_stats;
+}
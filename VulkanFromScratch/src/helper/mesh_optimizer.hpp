@@ -0,0 +1,31 @@
+#pragma once
+#include "helper/mesh_importer.hpp"
+#include <cstdint>
+
+struct MeshOptimizeStats {
+	// Average cache miss ratio (misses / triangle, 0.5 at best) and average
+	// transformed vertex ratio (misses / vertex, 1.0 at best), FIFO of CACHE_SIZE.
+	float		acmr_before = 0.0f;
+	float		acmr_after = 0.0f;
+	float		atvr_before = 0.0f;
+	float		atvr_after = 0.0f;
+	uint32_t	clusters = 0;
+};
+
+// Import time reordering, the draw calls stay exactly the same.
+// Per submesh :
+//  1. Tipsify (Sander et al. 2007) orders the triangles for the post transform vertex cache.
+//  2. The result is cut into clusters that keep a near optimal ACMR, the clusters are sorted
+//     so that outward facing ones come first and hide what is drawn after them (overdraw).
+// Then the vertices are renumbered in first use order, the vertex fetch walks the buffer forward.
+class MeshOptimizer {
+public:
+	static const uint32_t CACHE_SIZE = 16;
+	// A cluster is cut as soon as its running ACMR is within this factor of the whole cluster's.
+	static constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+	static void optimize(MeshData& mesh, MeshOptimizeStats* stats = nullptr);
+
+	static void analyze_vertex_cache(const uint32_t* indices, size_t index_count, size_t vertex_count,
+		float& acmr, float& atvr);
+};
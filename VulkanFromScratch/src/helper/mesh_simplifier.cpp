@@ -0,0 +1,253 @@
+#include "mesh_simplifier.hpp"
+#include "helper/mesh_importer.hpp"
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <cmath>
+#include <cstdio>
+
+static_assert(sizeof(MeshLod) == 16, "MeshLod is stored as is in the mesh cache");
+
+//----------------------
+//  Quadrics
+//----------------------
+// Squared distances to a set of planes, weighted by the triangle areas :
+// Q(p) = p.A.p + 2 b.p + c. Divided by the summed weight it is a mean squared distance.
+struct Quadric {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    // n . p + d = 0, `n` normalized
+    void add_plane(const glm::vec3& n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+        b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+        c += w * d * d;
+        weight += w;
+    }
+    Quadric& operator+=(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+        b0 += q.b0; b1 += q.b1; b2 += q.b2;
+        c += q.c;
+        weight += q.weight;
+        return *this;
+    }
+    double error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(r, 0.0) / weight : 0.0;
+    }
+};
+
+//----------------------
+//  Simplification
+//----------------------
+float MeshSimplifier::simplify(const MeshData& mesh, const uint32_t* indices, size_t index_count,
+    size_t target_index_count, float max_error, std::vector<uint32_t>& result)
+{
+    const uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    result.assign(indices, indices + (index_count - index_count % 3));
+    auto position = [&](uint32_t vertex) -> const glm::vec3& { return mesh.vertices[vertex].pos; };
+
+    // Vertices sharing a position (attribute seams) get the same canonical vertex and are locked.
+    std::vector<uint32_t> canonical(vertex_count);
+    std::vector<uint8_t> locked(vertex_count, 0);
+    {
+        std::vector<uint32_t> sorted(vertex_count);
+        std::iota(sorted.begin(), sorted.end(), 0);
+        std::sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) {
+            const glm::vec3& pa = position(a);
+            const glm::vec3& pb = position(b);
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            return pa.z < pb.z;
+        });
+        for (uint32_t i = 0; i < vertex_count;) {
+            uint32_t j = i + 1;
+            while (j < vertex_count && position(sorted[j]) == position(sorted[i])) j++;
+            for (uint32_t k = i; k < j; k++) {
+                canonical[sorted[k]] = sorted[i];
+                locked[sorted[k]] = j - i > 1;
+            }
+            i = j;
+        }
+    }
+
+    // Border and non manifold edges (not shared by exactly two triangles) lock their ends.
+    // Seam vertices already are, the other ones are their own canonical vertex.
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(result.size());
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = canonical[result[t + e]];
+                uint32_t b = canonical[result[t + (e + 1) % 3]];
+                if (a == b) continue;
+                edges.push_back(static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i]) j++;
+            if (j - i != 2) {
+                locked[static_cast<uint32_t>(edges[i] >> 32)] = 1;
+                locked[static_cast<uint32_t>(edges[i])] = 1;
+            }
+            i = j;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertex_count);
+    for (size_t t = 0; t < result.size(); t += 3) {
+        const glm::vec3& a = position(result[t]);
+        glm::vec3 normal = glm::cross(position(result[t + 1]) - a, position(result[t + 2]) - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue;
+        normal /= length;
+        for (int c = 0; c < 3; c++) {
+            quadrics[canonical[result[t + c]]].add_plane(normal, -glm::dot(normal, a), length * 0.5);
+        }
+    }
+
+    struct Candidate {
+        float		error;
+        uint32_t	from;
+        uint32_t	to;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<uint32_t> offsets(vertex_count + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> collapse_to(vertex_count);
+    std::vector<uint8_t> touched(vertex_count);
+    float result_error = 0.0f;
+
+    // Moving `from` onto `to` keeps every remaining triangle around `from` facing the same way.
+    // Returns the number of triangles removed, 0 when the collapse is rejected.
+    auto check_collapse = [&](uint32_t from, uint32_t to) -> uint32_t {
+        uint32_t removed = 0;
+        for (uint32_t k = offsets[from]; k < offsets[from + 1]; k++) {
+            const uint32_t* triangle = &result[adjacency[k] * 3];
+            if (canonical[triangle[0]] == canonical[to] || canonical[triangle[1]] == canonical[to] || canonical[triangle[2]] == canonical[to]) {
+                removed++;
+                continue;
+            }
+            glm::vec3 p[3], moved[3];
+            for (int c = 0; c < 3; c++) {
+                p[c] = position(triangle[c]);
+                moved[c] = triangle[c] == from ? position(to) : p[c];
+            }
+            glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            float before_length = glm::length(before);
+            float after_length = glm::length(after);
+            if (before_length <= 0.0f) continue;
+            if (after_length <= before_length * 1e-6f || glm::dot(before, after) < 0.25f * before_length * after_length) return 0;
+        }
+        return removed;
+    };
+
+    const size_t target_triangles = target_index_count / 3;
+    while (result.size() / 3 > target_triangles) {
+        // Vertex → triangles
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t index : result) offsets[index + 1]++;
+        for (uint32_t v = 0; v < vertex_count; v++) offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) adjacency[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        candidates.clear();
+        for (size_t t = 0; t < result.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                uint32_t ends[2] = { result[t + e], result[t + (e + 1) % 3] };
+                for (int d = 0; d < 2; d++) {
+                    uint32_t from = ends[d], to = ends[1 - d];
+                    if (locked[from] || canonical[from] == canonical[to]) continue;
+                    Quadric q = quadrics[canonical[from]];
+                    q += quadrics[canonical[to]];
+                    candidates.push_back({ static_cast<float>(std::sqrt(q.error(position(to)))), from, to });
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.error < b.error; });
+
+        std::iota(collapse_to.begin(), collapse_to.end(), 0);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t triangles = result.size() / 3;
+        uint32_t collapses = 0;
+        for (const Candidate& candidate : candidates) {
+            if (candidate.error > max_error || triangles <= target_triangles) break;
+            if (touched[canonical[candidate.from]] || touched[canonical[candidate.to]]) continue;
+            uint32_t removed = check_collapse(candidate.from, candidate.to);
+            if (removed == 0) continue;
+
+            collapse_to[candidate.from] = candidate.to;
+            quadrics[canonical[candidate.to]] += quadrics[canonical[candidate.from]];
+            // The one ring of `from` moved, its collapses are left to the next pass.
+            for (uint32_t k = offsets[candidate.from]; k < offsets[candidate.from + 1]; k++) {
+                const uint32_t* triangle = &result[adjacency[k] * 3];
+                for (int c = 0; c < 3; c++) touched[canonical[triangle[c]]] = 1;
+            }
+            triangles -= removed;
+            result_error = std::max(result_error, candidate.error);
+            collapses++;
+        }
+        if (collapses == 0) break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < result.size(); t += 3) {
+            uint32_t a = collapse_to[result[t]], b = collapse_to[result[t + 1]], c = collapse_to[result[t + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c]) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+    return result_error;
+}
+
+//----------------------
+//  LOD chain
+//----------------------
+void MeshSimplifier::build_lods(MeshData& mesh, std::vector<MeshLod>& lods)
+{
+    lods.clear();
+    MeshLod full;
+    full.index_count = static_cast<uint32_t>(mesh.indices.size());
+    lods.push_back(full);
+
+    const float max_error = glm::length(mesh.bounds_max - mesh.bounds_min) * MAX_RELATIVE_ERROR;
+    std::vector<uint32_t> previous(mesh.indices);
+    std::vector<uint32_t> simplified;
+    while (lods.size() < MAX_LODS) {
+        size_t target = static_cast<size_t>(previous.size() / 3 * LOD_RATIO) * 3;
+        float error = simplify(mesh, previous.data(), previous.size(), target, max_error, simplified);
+        if (simplified.empty() || simplified.size() > previous.size() * MIN_REDUCTION) break;
+
+        MeshLod lod;
+        lod.first_index = static_cast<uint32_t>(mesh.indices.size());
+        lod.index_count = static_cast<uint32_t>(simplified.size());
+        lod.error = lods.back().error + error;
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        lods.push_back(lod);
+        previous.swap(simplified);
+    }
+
+    std::string levels;
+    for (const MeshLod& lod : lods) {
+        char level[64];
+        snprintf(level, sizeof(level), " %u (%.2e)", lod.index_count / 3, lod.error);
+        levels += level;
+    }
+    printf("[Mesh] %zu LOD(s), triangles (error) :%s \n", lods.size(), levels.c_str());
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct MeshData;
+
+// One level of detail : a range of the mesh's index buffer, over the same vertices as LOD 0.
+// Stored as is in the mesh cache.
+struct MeshLod {
+	uint32_t	first_index = 0;
+	uint32_t	index_count = 0;
+	float		error = 0.0f;		// bound of the distance to LOD 0, in the units of the vertices
+	uint32_t	pad = 0;
+};
+
+// Import time LOD chain through quadric error edge collapses (Garland / Heckbert 1997).
+// A vertex is only ever collapsed onto one of its neighbours, so every level indexes the
+// vertex buffer of LOD 0 and no attribute is interpolated. Vertices on a border, on an
+// attribute seam (several vertices at one position) or on a non manifold edge never move.
+// Collapses run in passes : all candidate edges are sorted by error and taken in order,
+// skipping the ones next to a collapse of the same pass and the ones flipping a triangle.
+class MeshSimplifier {
+public:
+	static const uint32_t MAX_LODS = 6;			// LOD 0 included
+	static constexpr float LOD_RATIO = 0.5f;	// triangles of a level / triangles of the previous one
+	// A level keeping more than this of the previous one ends the chain.
+	static constexpr float MIN_REDUCTION = 0.85f;
+	// Collapses are stopped at this error, relative to the diagonal of the bounds.
+	static constexpr float MAX_RELATIVE_ERROR = 0.05f;
+
+	// Simplifies the triangle list `indices` (over mesh.vertices) to `target_index_count`, or
+	// as close as `max_error` allows. Returns the largest collapse error, as a distance.
+	static float simplify(const MeshData& mesh, const uint32_t* indices, size_t index_count,
+		size_t target_index_count, float max_error, std::vector<uint32_t>& result);
+
+	// Appends the levels to mesh.indices. `lods` gets every level, LOD 0 being the indices
+	// the mesh had. Every level is simplified from the previous one, its error is the sum.
+	static void build_lods(MeshData& mesh, std::vector<MeshLod>& lods);
+};
@@ -0,0 +1,131 @@
+#include "meshlet_builder.hpp"
+#include "helper/mesh_importer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static_assert(sizeof(Meshlet) == 64, "Meshlet is stored as is in the mesh cache");
+
+//----------------------
+//  Bounds
+//----------------------
+// Sphere around the box of the vertices, then the cone of the triangle normals.
+static void compute_bounds(const MeshData& mesh, Meshlet& meshlet)
+{
+    const uint32_t* indices = mesh.indices.data() + meshlet.first_index;
+    const uint32_t index_count = meshlet.triangle_count * 3;
+
+    glm::vec3 lo = mesh.vertices[indices[0]].pos;
+    glm::vec3 hi = lo;
+    for (uint32_t i = 1; i < index_count; i++) {
+        const glm::vec3& p = mesh.vertices[indices[i]].pos;
+        lo = glm::vec3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+        hi = glm::vec3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < index_count; i++) {
+        radius = std::max(radius, glm::length(mesh.vertices[indices[i]].pos - meshlet.center));
+    }
+    meshlet.radius = radius;
+
+    // Counter clockwise triangles face cross(b - a, c - a). Degenerate ones face nowhere.
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+    glm::vec3 axis(0.0f);
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        const glm::vec3& a = mesh.vertices[indices[i]].pos;
+        glm::vec3 normal = glm::cross(mesh.vertices[indices[i + 1]].pos - a, mesh.vertices[indices[i + 2]].pos - a);
+        float length = glm::length(normal);
+        normals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f));
+        axis += normals.back();
+    }
+    float axis_length = glm::length(axis);
+    meshlet.cone_cutoff = 2.0f;
+    if (axis_length <= 0.0f) return;
+    axis /= axis_length;
+
+    float min_dot = 1.0f;
+    for (const glm::vec3& normal : normals) {
+        if (normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f) min_dot = std::min(min_dot, glm::dot(normal, axis));
+    }
+    if (min_dot <= MeshletBuilder::MIN_CONE_DOT) return;
+
+    // The apex has to be behind every triangle's plane : dot(n, apex - p) <= 0 for a vertex p.
+    // With apex = center - axis * t, that is t >= dot(n, center - p) / dot(n, axis).
+    float t = 0.0f;
+    for (uint32_t i = 0; i < index_count; i += 3) {
+        const glm::vec3& normal = normals[i / 3];
+        float along = glm::dot(normal, axis);
+        if (along <= 0.0f) continue;    // degenerate
+        t = std::max(t, glm::dot(normal, meshlet.center - mesh.vertices[indices[i]].pos) / along);
+    }
+    meshlet.cone_axis = axis;
+    meshlet.cone_apex = meshlet.center - axis * t;
+    // Seen from inside the cone of half angle 90° - acos(min_dot) behind the apex, every normal
+    // points away : the cutoff is the cosine of that angle.
+    meshlet.cone_cutoff = std::sqrt(std::max(1.0f - min_dot * min_dot, 0.0f));
+}
+
+//----------------------
+//  Clustering
+//----------------------
+void MeshletBuilder::build(const MeshData& mesh, std::vector<Meshlet>& meshlets, MeshletStats* stats)
+{
+    meshlets.clear();
+    // Meshlet each vertex was last counted in, +1 (0 : never).
+    std::vector<uint32_t> seen_in(mesh.vertices.size(), 0);
+    uint64_t vertex_total = 0, triangle_total = 0;
+
+    for (const SubMesh& submesh : mesh.submeshes) {
+        const uint32_t end = submesh.first_index + submesh.index_count - submesh.index_count % 3;
+        Meshlet current;
+        current.first_index = submesh.first_index;
+        auto flush = [&]() {
+            if (current.triangle_count == 0) return;
+            compute_bounds(mesh, current);
+            vertex_total += current.vertex_count;
+            triangle_total += current.triangle_count;
+            meshlets.push_back(current);
+        };
+
+        // Vertices of triangle `i` not counted in the meshlet `stamp` yet.
+        auto new_vertices_of = [&](uint32_t i, uint32_t stamp) {
+            uint32_t count = 0;
+            for (int c = 0; c < 3; c++) {
+                uint32_t vertex = mesh.indices[i + c];
+                bool repeated = (c > 0 && mesh.indices[i] == vertex) || (c > 1 && mesh.indices[i + 1] == vertex);
+                count += seen_in[vertex] != stamp && !repeated;
+            }
+            return count;
+        };
+
+        for (uint32_t i = submesh.first_index; i < end; i += 3) {
+            uint32_t stamp = static_cast<uint32_t>(meshlets.size()) + 1;
+            uint32_t new_vertices = new_vertices_of(i, stamp);
+            if (current.triangle_count == MAX_TRIANGLES || current.vertex_count + new_vertices > MAX_VERTICES) {
+                flush();
+                current = Meshlet();
+                current.first_index = i;
+                stamp = static_cast<uint32_t>(meshlets.size()) + 1;
+                new_vertices = new_vertices_of(i, stamp);
+            }
+            for (int c = 0; c < 3; c++) seen_in[mesh.indices[i + c]] = stamp;
+            current.vertex_count += new_vertices;
+            current.triangle_count++;
+        }
+        flush();
+    }
+
+    MeshletStats local_stats;
+    local_stats.meshlets = static_cast<uint32_t>(meshlets.size());
+    local_stats.with_cone = static_cast<uint32_t>(std::count_if(meshlets.begin(), meshlets.end(),
+        [](const Meshlet& meshlet) { return meshlet.has_cone(); }));
+    if (!meshlets.empty()) {
+        local_stats.average_vertices = static_cast<float>(vertex_total) / meshlets.size();
+        local_stats.average_triangles = static_cast<float>(triangle_total) / meshlets.size();
+    }
+    printf("[Mesh] %u meshlet(s), %.1f vertices %.1f triangles on average, %u with a normal cone \n",
+        local_stats.meshlets, local_stats.average_vertices, local_stats.average_triangles, local_stats.with_cone);
+    if (stats) *stats = local_stats;
+}
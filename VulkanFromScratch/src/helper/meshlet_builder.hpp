@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <glm.hpp>
+
+struct MeshData;
+
+// Cluster of at most MeshletBuilder::MAX_VERTICES / MAX_TRIANGLES, a contiguous range of the
+// mesh's index buffer so it can be drawn on its own. Stored as is in the mesh cache.
+struct Meshlet {
+	glm::vec3	center = glm::vec3(0.0f);		// bounding sphere, same space as the vertices
+	float		radius = 0.0f;
+	// Normal cone : the whole meshlet faces away from any point p where
+	// dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff.
+	glm::vec3	cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float		cone_cutoff = 2.0f;				// >= 1 : the normals spread too much, no cone
+	glm::vec3	cone_apex = glm::vec3(0.0f);
+	uint32_t	first_index = 0;				// into the mesh's index buffer
+	uint32_t	triangle_count = 0;
+	uint32_t	vertex_count = 0;				// unique vertices referenced
+	uint32_t	pad[2] = {};
+
+	inline bool has_cone() const { return cone_cutoff < 1.0f; }
+};
+
+struct MeshletStats {
+	uint32_t	meshlets = 0;
+	uint32_t	with_cone = 0;
+	float		average_vertices = 0.0f;
+	float		average_triangles = 0.0f;
+};
+
+// Import time clustering for per meshlet culling (see IndirectDrawList::enable_cluster_culling).
+// Triangles are taken in index buffer order, which MeshOptimizer already made local, and a
+// meshlet is cut as soon as the next triangle would go over one of the limits. Meshlets never
+// cross a submesh. The index buffer is left untouched.
+class MeshletBuilder {
+public:
+	static const uint32_t MAX_VERTICES = 64;
+	static const uint32_t MAX_TRIANGLES = 124;
+	// Below this, the normals of the meshlet span more than a hemisphere minus a margin and
+	// the cone would almost never cull anything.
+	static constexpr float MIN_CONE_DOT = 0.1f;
+
+	static void build(const MeshData& mesh, std::vector<Meshlet>& meshlets, MeshletStats* stats = nullptr);
+};
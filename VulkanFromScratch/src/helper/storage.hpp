@@ -5,28 +5,15 @@
 #include <stdexcept>
 
 
-uint32_t findMemoryType(const VkPhysicalDevice& physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
-
-
+// Buffers no longer own a VkDeviceMemory, they are bound to a sub allocation of
+// CoreInstance::allocator(). Host visible allocations are persistently mapped (allocation.mapped).
 void createBuffer(
-    VkDevice device,
-    VkPhysicalDevice physical_device,
+    CoreInstance& core_instance,
     VkDeviceSize size, 
     VkBufferUsageFlags usage, 
-    VkMemoryPropertyFlags properties, 
+    const MemoryPolicy& memory_policy, 
     VkBuffer& buffer, 
-    VkDeviceMemory& bufferMemory) {
+    MemoryAllocation& allocation) {
 
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -34,65 +21,43 @@ void createBuffer(
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    if (vkCreateBuffer(core_instance.get_device(), &bufferInfo, core_instance.allocation_callbacks(), &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create buffer!");
     }
 
     VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physical_device, memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
-    }
+    vkGetBufferMemoryRequirements(core_instance.get_device(), buffer, &memRequirements);
 
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    allocation = core_instance.allocator().allocate(memRequirements, memory_policy, true);
+    vkBindBufferMemory(core_instance.get_device(), buffer, allocation.memory, allocation.offset);
 }
 
-
-VkCommandBuffer beginSingleTimeCommands(VkDevice device , VkCommandPool cmd_pool) {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = cmd_pool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    return commandBuffer;
+void destroyBuffer(CoreInstance& core_instance, VkBuffer& buffer, MemoryAllocation& allocation) {
+    vkDestroyBuffer(core_instance.get_device(), buffer, core_instance.allocation_callbacks());
+    core_instance.allocator().free(allocation);
+    buffer = VK_NULL_HANDLE;
 }
 
-void endSingleTimeCommands(CoreInstance& core_instance, VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
+void createImage(
+    CoreInstance& core_instance,
+    const VkImageCreateInfo& imageInfo,
+    const MemoryPolicy& memory_policy,
+    VkImage& image,
+    MemoryAllocation& allocation) {
 
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkCreateImage(core_instance.get_device(), &imageInfo, core_instance.allocation_callbacks(), &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
 
-    vkQueueSubmit(core_instance.graphic_queue(), 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(core_instance.graphic_queue());
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(core_instance.get_device(), image, &memRequirements);
 
-    vkFreeCommandBuffers(core_instance.get_device(), core_instance.cmd_pool(), 1, &commandBuffer);
+    allocation = core_instance.allocator().allocate(memRequirements, memory_policy, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
+    vkBindImageMemory(core_instance.get_device(), image, allocation.memory, allocation.offset);
 }
 
-void copyBuffer(CoreInstance& core_instance ,VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(core_instance.get_device() , core_instance.cmd_pool());
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(core_instance,commandBuffer);
+void destroyImage(CoreInstance& core_instance, VkImage& image, MemoryAllocation& allocation) {
+    vkDestroyImage(core_instance.get_device(), image, core_instance.allocation_callbacks());
+    core_instance.allocator().free(allocation);
+    image = VK_NULL_HANDLE;
 }
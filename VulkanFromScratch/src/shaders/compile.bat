@@ -1,3 +1,6 @@
 D:\VulkabSDK\Bin\glslc.exe simple_shader.frag -o simple_shader.frag.spv
 D:\VulkabSDK\Bin\glslc.exe simple_shader.vert -o simple_shader.vert.spv
+D:\VulkabSDK\Bin\glslc.exe frustum_cull.comp -o frustum_cull.comp.spv
+D:\VulkabSDK\Bin\glslc.exe occlusion_cull.comp -o occlusion_cull.comp.spv
+D:\VulkabSDK\Bin\glslc.exe depth_pyramid.comp -o depth_pyramid.comp.spv
 pause
\ No newline at end of file
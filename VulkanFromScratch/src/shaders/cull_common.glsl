@@ -0,0 +1,46 @@
+// Shared by the culling shaders, see FrustumCuller.
+
+// Bounding sphere and normal cone in the space of the list's transforms.
+struct CullObject {
+    vec4 sphere;        // xyz center, w radius
+    vec4 cone;          // xyz axis, w cutoff (>= 1 : no cone)
+    vec4 cone_apex;     // xyz
+    uint command;       // source command
+    uint batch;
+    uint batch_first;   // first command of the batch
+    uint pad;
+};
+// VkDrawIndexedIndirectCommand
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int  vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects { CullObject objects[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Commands { DrawCommand commands[]; };
+layout(std430, set = 0, binding = 2) writeonly buffer CulledCommands { DrawCommand culled[]; };
+// Cleared before the dispatch. batch_counts feed vkCmdDrawIndexedIndirectCount.
+layout(std430, set = 0, binding = 3) buffer Counters {
+    uint visible_total;
+    uint occluded_total;
+    uint late_total;    // drawn by the late phase of the occlusion culling
+    uint counters_pad;
+    uint batch_counts[];
+};
+
+bool sphere_in_frustum(vec4 planes[6], vec4 sphere) {
+    bool visible = true;
+    for (int p = 0; p < 6; p++) {
+        visible = visible && dot(planes[p].xyz, sphere.xyz) + planes[p].w >= -sphere.w;
+    }
+    return visible;
+}
+
+// Every triangle of the object faces away from `eye` (w 0 : no camera position).
+bool cone_culled(CullObject object, vec4 eye) {
+    return eye.w != 0.0 && object.cone.w < 1.0 &&
+        dot(normalize(object.cone_apex.xyz - eye.xyz), object.cone.xyz) >= object.cone.w;
+}
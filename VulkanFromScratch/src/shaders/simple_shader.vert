@@ -6,14 +6,26 @@ layout(set = 0 ,binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// Packed vertex formats store the position relative to the mesh bounds.
+layout(push_constant) uniform VertexDequantization {
+    vec4 scale;
+    vec4 offset;
+} dequantization;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inUv;
+// Per instance (binding 1) : rows of the affine model matrix, see InstanceData.
+layout(location = 3) in vec4 inModelRow0;
+layout(location = 4) in vec4 inModelRow1;
+layout(location = 5) in vec4 inModelRow2;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    vec3 position = inPosition * dequantization.scale.xyz + dequantization.offset.xyz;
+    mat4 instance = transpose(mat4(inModelRow0, inModelRow1, inModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+    gl_Position = ubo.proj * ubo.view * ubo.model * instance * vec4(position, 1.0);
     //gl_Position =  vec4(inPosition, 1.0);
     fragTexCoord = inUv;
     fragColor = inColor;
@@ -1,7 +1,75 @@
 #pragma once
 #include "core/core_fwd.h"
 #include "helper/storage.hpp"
-int main() {
+#include "helper/hlod_builder.hpp"
+#include "bench/bench.hpp"
+#include <memory>
+#include <string>
+#include <cstring>
+
+//-----------------------------------------
+// Indirect scene (--scene indirect):
+// layers of copies of `model` drawn by one IndirectDrawList, with frustum and occlusion culling
+// (the upper layers hide the lower ones), per meshlet culling, LOD selection and HLOD proxies
+// for the groups far from the camera. `proxies` keeps the proxy models alive.
+//-----------------------------------------
+static const uint32_t INDIRECT_GRID = 16;
+static const uint32_t INDIRECT_LAYERS = 3;
+static const float INDIRECT_SPACING = 0.75f;
+static const float INDIRECT_LAYER_GAP = 0.4f;
+static const float INDIRECT_HLOD_CELL = 3.0f;
+static const float INDIRECT_HLOD_DISTANCE = 4.0f;
+
+static std::unique_ptr<IndirectDrawList> create_indirect_scene(CoreInstance& core, Renderer& renderer, VkPipeline pipeline,
+	Model& model, const std::string& model_path, const glm::mat4& view_projection, std::vector<std::unique_ptr<Model>>& proxies)
+{
+	std::vector<HlodSource> sources;
+	const float half = (INDIRECT_GRID - 1) * INDIRECT_SPACING * 0.5f;
+	for (uint32_t layer = 0; layer < INDIRECT_LAYERS; layer++) {
+		for (uint32_t y = 0; y < INDIRECT_GRID; y++) {
+			for (uint32_t x = 0; x < INDIRECT_GRID; x++) {
+				HlodSource source;
+				source.path = model_path;
+				source.transform = glm::translate(glm::mat4(1.0f),
+					glm::vec3(x * INDIRECT_SPACING - half, y * INDIRECT_SPACING - half, -(layer * INDIRECT_LAYER_GAP)));
+				sources.push_back(source);
+			}
+		}
+	}
+	std::vector<HlodCluster> clusters = HlodBuilder::cluster(sources, INDIRECT_HLOD_CELL, model_path);
+
+	for (const HlodCluster& cluster : clusters) {
+		HlodBuilder::build(sources, cluster);
+		proxies.push_back(std::make_unique<Model>(core, pipeline, cluster.proxy_path));
+	}
+
+	// Every draw may be split into the meshlets of its model.
+	uint32_t max_commands = static_cast<uint32_t>(sources.size()) * std::max(static_cast<uint32_t>(model.meshlets().size()), 1u);
+	for (const auto& proxy : proxies) max_commands += std::max(static_cast<uint32_t>(proxy->meshlets().size()), 1u);
+	auto list = std::make_unique<IndirectDrawList>(core, static_cast<uint32_t>(sources.size() + proxies.size()), max_commands);
+	for (const HlodSource& source : sources) list->add(model, source.transform);
+	// The sources were added first, their indices are the draw ids.
+	for (size_t i = 0; i < clusters.size(); i++) list->add_hlod(*proxies[i], clusters[i].members, INDIRECT_HLOD_DISTANCE);
+
+	list->set_view_projection(view_projection);
+	if (list->path() != IndirectDrawList::Path::DIRECT) {
+		list->enable_occlusion_culling(renderer, view_projection);
+		list->enable_cluster_culling();
+	}
+	list->enable_lod_selection(static_cast<float>(renderer.extent().height));
+	return list;
+}
+
+int main(int argc, char** argv) {
+	// --scene model (default) : the textured model, --scene indirect : see create_indirect_scene.
+	// --bench <name> : runs the benchmark instead, see src/bench/bench.hpp.
+	std::string scene = "model";
+	std::string bench;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) scene = argv[++i];
+		else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) bench = argv[++i];
+	}
+	if (!bench.empty() && run_cpu_benchmark(bench)) return 0;
 
 	DisplayWindow main_window {};
 	CoreInstance coreInstance{ *main_window.get_window() };	
@@ -18,14 +86,33 @@ int main() {
 
 	Image img{ coreInstance };
 	img.load_texture("./assets/texture.jpg");
-	forward_renderer_pass.m_texture_image = &img;
+	forward_renderer_pass.set_texture(img);
 
 	pipeline.create_pipleine(
 		forward_renderer_pass.get_renderPass(),
 		gameobject.get_all_descriptorLayouts()
 	);
-	Model model{coreInstance , pipeline.get_pipeline()};
-	gameobject.add_component(&model);
+	const std::string model_path = "./assets/quad.obj";
+	Model model{coreInstance , pipeline.get_pipeline(), model_path};
+	if (!bench.empty()) {
+		BenchScene bench_scene{ main_window, coreInstance, swapchain, pipeline, forward_renderer_pass, gameobject, model };
+		if (!run_gpu_benchmark(bench, bench_scene)) {
+			printf("[Bench] unknown benchmark %s \n", bench.c_str());
+			print_benchmarks();
+			return 1;
+		}
+		return 0;
+	}
+	std::vector<std::unique_ptr<Model>> hlod_proxies;
+	std::unique_ptr<IndirectDrawList> indirect_list;
+	if (scene == "indirect") {
+		indirect_list = create_indirect_scene(coreInstance, forward_renderer_pass, pipeline.get_pipeline(),
+			model, model_path, transform_obj.view_projection(), hlod_proxies);
+		gameobject.add_component(indirect_list.get());
+	}
+	else {
+		gameobject.add_component(&model);
+	}
 	
 	while (main_window.is_window_alive())
 	{
@@ -38,6 +125,8 @@ int main() {
 			forward_renderer_pass.get_current_cmdbuffer(),
 			pipeline.get_layout()
 		};
+		gameobject.execute_before_frame(update_data);
+		forward_renderer_pass.begin_renderPass();
 		gameobject.execute(update_data);
 
 		//transform_obj.updateUniformBuffer(swapchain.current_frame());